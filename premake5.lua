@@ -5,6 +5,21 @@ workspace "Volcano"
 
 outputdir = "%{cfg.buildcfg}-%{cfg.system}-%{cfg.architecture}"
 
+newoption {
+	trigger = "embed-shaders",
+	description = "Compile shaders before build and embed SPIR-V in executable"
+}
+
+newoption {
+	trigger = "shader-hot-reload",
+	description = "Development: recompile and swap shaders when their GLSL source is saved (needs glslc)"
+}
+
+newoption {
+	trigger = "profile",
+	description = "Build cpu profiler zones in Release too (always in Debug)"
+}
+
 include "Dependencies/glfw"
 
 project	"volcano"
@@ -67,6 +82,82 @@ project	"volcano"
 			("./compile_shaders.sh"),
 			("cp -r ./shaders/ ../bin/" .. outputdir .. "/%{prj.name}")
 		}
+	-- SPIR-V as comma separated words, included into ShaderRegistry.cpp
+	filter "options:embed-shaders"
+		defines {
+			"VOLCANO_EMBED_SHADERS"
+		}
+		includedirs {
+			"volcano/shaders"
+		}
+		prebuildcommands {
+			("glslc -mfmt=num -c shaders/shader.vs.glsl -o shaders/vert.spv.inc"),
+			("glslc -mfmt=num -c shaders/shader.fs.glsl -o shaders/frag.spv.inc")
+		}
+
+	-- Watches sources in repo. SPIR-V is written next to executable where it is loaded from
+	filter "options:shader-hot-reload"
+		defines {
+			"VOLCANO_SHADER_HOT_RELOAD",
+			"VOLCANO_SHADER_SOURCE_DIR=\"" .. path.getabsolute("volcano/shaders") .. "\""
+		}
+
+	-- Cpu profiler zones. Compiled out of Release unless asked for
+	filter "options:profile"
+		defines {
+			"VOLCANO_PROFILE"
+		}
+
+	filter "configurations:Debug"
+		symbols "On"
+		defines { "DEBUG", "VOLCANO_PROFILE" }
+
+	filter "configurations:Release"
+		optimize "On"
+		defines { "RELEASE" }
+
+-- Unit tests of cpu side logic. Run bin/<outputdir>/tests/tests, optionally with part of a test name as filter
+-- Not linked with vulkan. Entry points used by tested code are faked in tests/FakeVulkan.cpp
+project "tests"
+	location "volcano"
+	kind "ConsoleApp"
+	language "C++"
+	cppdialect "C++17"
+	systemversion "latest"
+
+	targetdir ("bin/" .. outputdir .. "/%{prj.name}")
+	objdir ("intermediate/" .. outputdir .. "/%{prj.name}")
+
+	includedirs {
+		"Dependencies/vulkan/Include",
+		"Dependencies/glm",
+		"volcano/src",
+		"volcano/src/vendors"
+	}
+
+	files {
+		"volcano/tests/**.h",
+		"volcano/tests/**.cpp",
+		"volcano/src/MemoryAllocator.cpp",
+		"volcano/src/PerFrameBuffer.cpp",
+		"volcano/src/PipelineDescription.cpp",
+		"volcano/src/PngWriter.cpp",
+		"volcano/src/ShaderReflection.cpp",
+		"volcano/src/StagingRing.cpp",
+		"volcano/src/utils.cpp",
+		"volcano/src/vendors/stb_image/stb_image.cpp"
+	}
+
+	filter "system:windows"
+		defines {
+			"WINDOWS_BUILD"
+		}
+
+	filter "system:linux"
+		defines {
+			"LINUX_BUILD"
+		}
+
 	filter "configurations:Debug"
 		symbols "On"
 		defines { "DEBUG" }
@@ -1,11 +1,26 @@
 #version 450
 #pragma shader_stage(fragment)
 
+// Specialization constants. Set per pipeline variant, so disabled features are compiled out
+layout (constant_id = 0) const bool USE_TEXTURE = false;       // Multiply colour with texture
+layout (constant_id = 1) const bool ALPHA_TEST = false;        // Discard fragments below cutoff
+layout (constant_id = 2) const float ALPHA_CUTOFF = 0.5f;
+
 layout (location = 0) in vec4 v_color;
+layout (location = 1) in vec2 v_texCoord;
+
+layout (binding = 2) uniform sampler2D textureSampler;
 
 layout (location = 0) out vec4 outColour;
 
 void main()
 {
-    outColour = v_color;
+    vec4 colour = v_color;
+    if (USE_TEXTURE)
+        colour *= texture(textureSampler, v_texCoord);
+
+    if (ALPHA_TEST && colour.a < ALPHA_CUTOFF)
+        discard;
+
+    outColour = colour;
 }
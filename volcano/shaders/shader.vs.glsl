@@ -3,29 +3,28 @@
 
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec4 color;
+layout (location = 2) in vec2 texCoord;
 
 //hidden (set = 0) <- descriptor set
 layout (binding = 0) uniform UBOViewProj 
 {
     mat4 proj;
     mat4 view;
+    uint transformBase;     // Slot of current frame in model buffer
 } uboViewProj;
 
-layout(push_constant) uniform PushModel 
+// Model matrix of every mesh instance, one slot per frame in flight. Indexed by slot base + instance index
+layout (std430, binding = 1) readonly buffer ModelBuffer 
 {
-    mat4 model;
-} pushModel;
-
-// Old code for dyanamic descriptor set
-layout (binding = 1) uniform UBOModel 
-{
-    mat4 model;
-} uboModel;
+    mat4 models[];
+} modelBuffer;
 
 layout (location = 0) out vec4 v_color;
+layout (location = 1) out vec2 v_texCoord;
 
 void main()
 {
-    gl_Position = uboViewProj.proj * uboViewProj.view * pushModel.model * vec4(position, 1.0f);
+    gl_Position = uboViewProj.proj * uboViewProj.view * modelBuffer.models[uboViewProj.transformBase + gl_InstanceIndex] * vec4(position, 1.0f);
     v_color = color;
+    v_texCoord = texCoord;
 }
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+// Everything cpu writes or records for one frame in flight
+// Reused once fence of frame signals. Number of frames is chosen at runtime
+struct FrameContext
+{
+    vk::CommandPool commandPool;                            // Reset every frame
+    vk::CommandBuffer commandBuffer;                        // Primary. Only begins render pass and executes secondaries
+
+    // Draw commands recorded in parallel, one pool per recording thread
+    // Not tied to a swapchain image, so they are reused until scene structure changes
+    std::vector<vk::CommandPool> secondaryCommandPools;
+    std::vector<vk::CommandBuffer> secondaryCommandBuffers;
+    uint32_t secondaryCount = 0;                            // Secondaries holding current draw list
+    std::vector<uint32_t> drawPipelines;                    // Pipeline id of every indirect command, grouped
+    bool drawsDirty = true;
+
+    // View projection region and indirect commands of frame are picked with frame index
+    vk::DescriptorSet descriptorSet;
+
+    vk::Semaphore imageAvailable;                           // Singal after image is ready to be rendered
+    vk::Semaphore renderFinished;                           // Signal after rendering is finised
+    vk::Fence fence;                                        // Fences for cpu-gpu sync
+
+    // Instances [first, second) changed since transform slot of frame was last written
+    std::pair<uint32_t, uint32_t> staleTransforms;
+};
@@ -0,0 +1,75 @@
+#include "volcanoPCH.h"
+#include "FrameReadback.h"
+
+void FrameReadback::init(MemoryAllocator& allocator, const vk::Device& device, vk::Extent2D extent, vk::Format format,
+    uint32_t bytesPerPixel, uint32_t frameCount)
+{
+    this->extent = extent;
+    this->format = format;
+    this->rowPitch = extent.width * bytesPerPixel;
+
+    // Rows are tightly packed in buffer
+    buffer.init(allocator, device, static_cast<vk::DeviceSize>(rowPitch) * extent.height, frameCount,
+        vk::BufferUsageFlagBits::eTransferDst, 16, true);
+    pending.assign(frameCount, Pending());
+}
+
+void FrameReadback::destroy()
+{
+    buffer.destroy();
+    pending.clear();
+}
+
+void FrameReadback::record(const vk::CommandBuffer& commandBuffer, uint32_t frameIndex, const vk::Image& image,
+    uint64_t frameNumber, ReadbackCallback callback)
+{
+    vk::BufferImageCopy region = {};
+    region.bufferOffset = buffer.getOffset(frameIndex);
+    region.bufferRowLength = 0;                     // Tightly packed
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = vk::Offset3D(0, 0, 0);
+    region.imageExtent = vk::Extent3D(extent.width, extent.height, 1);
+
+    commandBuffer.copyImageToBuffer(image, vk::ImageLayout::eTransferSrcOptimal, buffer.getBuffer(), region);
+
+    // Copy has to be visible to host reads once fence signals
+    vk::BufferMemoryBarrier barrier = {};
+    barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    barrier.dstAccessMask = vk::AccessFlagBits::eHostRead;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = buffer.getBuffer();
+    barrier.offset = buffer.getOffset(frameIndex);
+    barrier.size = buffer.getRegionSize();
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+        vk::DependencyFlags(), nullptr, barrier, nullptr);
+
+    pending[frameIndex] = { std::move(callback), frameNumber };
+}
+
+void FrameReadback::complete(uint32_t frameIndex)
+{
+    Pending& slot = pending[frameIndex];
+    if (!slot.callback)
+        return;
+
+    buffer.invalidate(frameIndex);
+
+    ReadbackImage image;
+    image.width = extent.width;
+    image.height = extent.height;
+    image.rowPitch = rowPitch;
+    image.format = format;
+    image.frameNumber = slot.frameNumber;
+    image.pixels = buffer.get<uint8_t>(frameIndex);
+
+    // Slot is free again before callback, so callback may request next readback
+    ReadbackCallback callback = std::move(slot.callback);
+    slot.callback = nullptr;
+    callback(image);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include "MemoryAllocator.h"
+#include "PerFrameBuffer.h"
+
+// Pixels of one read back frame. Only valid during callback
+struct ReadbackImage
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t rowPitch = 0;                          // In bytes
+    vk::Format format = vk::Format::eUndefined;
+    uint64_t frameNumber = 0;                       // Frame that was copied
+    const uint8_t* pixels = nullptr;
+};
+
+using ReadbackCallback = std::function<void(const ReadbackImage&)>;
+
+// Copies rendered images into host visible region of their frame in flight (ring of framesInFlight buffers)
+// Copy is recorded behind render pass, so queue never waits on cpu. Callback runs once fence of frame
+// signalled anyway, while later frames already render
+class FrameReadback
+{
+public:
+    void init(MemoryAllocator& allocator, const vk::Device& device, vk::Extent2D extent, vk::Format format,
+        uint32_t bytesPerPixel, uint32_t frameCount);
+    void destroy();
+
+    // Image must be in transfer src layout with render pass writes made visible to transfers
+    void record(const vk::CommandBuffer& commandBuffer, uint32_t frameIndex, const vk::Image& image,
+        uint64_t frameNumber, ReadbackCallback callback);
+    // Fence of frame signalled. Hands its copy (if any) to callback
+    void complete(uint32_t frameIndex);
+
+    inline bool isPending(uint32_t frameIndex) const { return static_cast<bool>(pending[frameIndex].callback); }
+private:
+    struct Pending
+    {
+        ReadbackCallback callback;
+        uint64_t frameNumber = 0;
+    };
+
+    PerFrameBuffer buffer;
+    std::vector<Pending> pending;
+    vk::Extent2D extent;
+    vk::Format format = vk::Format::eUndefined;
+    uint32_t rowPitch = 0;
+};
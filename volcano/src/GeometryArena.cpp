@@ -0,0 +1,43 @@
+#include "volcanoPCH.h"
+#include "GeometryArena.h"
+
+#include "utils.h"
+
+void GeometryArena::init(const vk::Buffer& vertexBuffer, uint32_t vertexCapacity, const vk::Buffer& indexBuffer, uint32_t indexCapacity)
+{
+    this->vertexBuffer = vertexBuffer;
+    this->indexBuffer = indexBuffer;
+
+    freeVertices.clear();
+    freeIndices.clear();
+    freeVertices.emplace(0, vertexCapacity);
+    freeIndices.emplace(0, indexCapacity);
+}
+
+bool GeometryArena::allocate(uint32_t vertexCount, uint32_t indexCount, GeometryRange& range)
+{
+    uint32_t vertexOffset, firstIndex;
+
+    if (!utils::allocateRange(freeVertices, vertexCount, vertexOffset))
+        return false;
+
+    if (!utils::allocateRange(freeIndices, indexCount, firstIndex))
+    {
+        utils::freeRange(freeVertices, vertexOffset, vertexCount);
+        return false;
+    }
+
+    range.vertexOffset = vertexOffset;
+    range.vertexCount = vertexCount;
+    range.firstIndex = firstIndex;
+    range.indexCount = indexCount;
+    return true;
+}
+
+void GeometryArena::free(GeometryRange& range)
+{
+    utils::freeRange(freeVertices, range.vertexOffset, range.vertexCount);
+    utils::freeRange(freeIndices, range.firstIndex, range.indexCount);
+
+    range = GeometryRange();
+}
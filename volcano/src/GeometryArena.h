@@ -0,0 +1,38 @@
+#pragma once
+
+#include <map>
+#include <vulkan/vulkan.hpp>
+
+// Part of shared vertex and index buffers owned by one mesh
+struct GeometryRange
+{
+    uint32_t vertexOffset = 0;          // First vertex in vertex arena
+    uint32_t vertexCount = 0;
+    uint32_t firstIndex = 0;            // First index in index arena
+    uint32_t indexCount = 0;
+};
+
+// Sub-allocates vertices and indices of all meshes from one vertex and one index buffer
+// so whole scene can be drawn without rebinding buffers
+class GeometryArena
+{
+public:
+    static constexpr uint32_t DEFAULT_VERTEX_CAPACITY = 1 << 20;
+    static constexpr uint32_t DEFAULT_INDEX_CAPACITY = 1 << 22;
+
+    void init(const vk::Buffer& vertexBuffer, uint32_t vertexCapacity, const vk::Buffer& indexBuffer, uint32_t indexCapacity);
+
+    // Returns false when arena has no contiguous space left
+    bool allocate(uint32_t vertexCount, uint32_t indexCount, GeometryRange& range);
+    void free(GeometryRange& range);
+
+    inline vk::Buffer getVertexBuffer() const { return vertexBuffer; }
+    inline vk::Buffer getIndexBuffer() const { return indexBuffer; }
+private:
+    vk::Buffer vertexBuffer;
+    vk::Buffer indexBuffer;
+
+    // Free ranges keyed by offset. Neighbours are merged on free
+    std::map<uint32_t, uint32_t> freeVertices;
+    std::map<uint32_t, uint32_t> freeIndices;
+};
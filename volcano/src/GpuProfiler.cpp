@@ -0,0 +1,183 @@
+#include "volcanoPCH.h"
+#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+// Render pass begin and end come first, then begin and end of every draw group
+#define PASS_QUERY_COUNT 2
+
+void GpuProfiler::init(const vk::PhysicalDevice& physicalDevice, const vk::Device& device, uint32_t queueFamily, uint32_t frameCount)
+{
+    this->device = device;
+
+    // Software drivers (e.g. lavapipe) support timestamps too, but some queues may have none at all
+    uint32_t validBits = physicalDevice.getQueueFamilyProperties().at(queueFamily).timestampValidBits;
+    supported = validBits > 0;
+    if (!supported)
+    {
+        std::cerr << "Queue has no timestamp support, gpu profiling is off" << std::endl;
+        return;
+    }
+
+    timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+    timestampPeriod = physicalDevice.getProperties().limits.timestampPeriod;
+
+    vk::QueryPoolCreateInfo poolInfo = {};
+    poolInfo.queryType = vk::QueryType::eTimestamp;
+    poolInfo.queryCount = PASS_QUERY_COUNT + 2 * MAX_GPU_DRAW_GROUPS;
+
+    frames.resize(frameCount);
+    try
+    {
+        for (auto& frame : frames)
+            frame.queryPool = device.createQueryPool(poolInfo);
+    }
+    catch (vk::SystemError& e)
+    {
+        UNUSED(e);
+        throw std::runtime_error("Failed to create timestamp query pool");
+    }
+}
+
+void GpuProfiler::destroy()
+{
+    for (auto& frame : frames)
+        device.destroyQueryPool(frame.queryPool);
+
+    frames.clear();
+    drawGroupTimings.clear();
+    passTiming = RollingTiming();
+    collectedFrames = 0;
+}
+
+void GpuProfiler::setDrawGroups(uint32_t frameIndex, std::vector<PipelineId> pipelines)
+{
+    if (!supported)
+        return;
+
+    pipelines.resize(std::min<size_t>(pipelines.size(), MAX_GPU_DRAW_GROUPS));
+    frames[frameIndex].drawGroups = std::move(pipelines);
+}
+
+void GpuProfiler::beginPass(const vk::CommandBuffer& commandBuffer, uint32_t frameIndex)
+{
+    if (!supported)
+        return;
+
+    // Queries have to be reset before they are written again. Draw groups may be in reused secondaries
+    Frame& frame = frames[frameIndex];
+    uint32_t queryCount = PASS_QUERY_COUNT + 2 * static_cast<uint32_t>(frame.drawGroups.size());
+    commandBuffer.resetQueryPool(frame.queryPool, 0, queryCount);
+    commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, frame.queryPool, 0);
+}
+
+void GpuProfiler::endPass(const vk::CommandBuffer& commandBuffer, uint32_t frameIndex)
+{
+    if (!supported)
+        return;
+
+    Frame& frame = frames[frameIndex];
+    commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, frame.queryPool, 1);
+    frame.pending = true;
+}
+
+void GpuProfiler::beginDrawGroup(const vk::CommandBuffer& commandBuffer, uint32_t frameIndex, uint32_t group)
+{
+    if (!supported || group >= MAX_GPU_DRAW_GROUPS)
+        return;
+
+    commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, frames[frameIndex].queryPool, PASS_QUERY_COUNT + 2 * group);
+}
+
+void GpuProfiler::endDrawGroup(const vk::CommandBuffer& commandBuffer, uint32_t frameIndex, uint32_t group)
+{
+    if (!supported || group >= MAX_GPU_DRAW_GROUPS)
+        return;
+
+    commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, frames[frameIndex].queryPool, PASS_QUERY_COUNT + 2 * group + 1);
+}
+
+void GpuProfiler::collect(uint32_t frameIndex)
+{
+    if (!supported)
+        return;
+
+    Frame& frame = frames[frameIndex];
+    if (!frame.pending)
+        return;
+    frame.pending = false;
+
+    // Fence of frame signalled, so results are there. Never waits; a missing result only drops the sample
+    uint32_t queryCount = PASS_QUERY_COUNT + 2 * static_cast<uint32_t>(frame.drawGroups.size());
+    std::vector<uint64_t> timestamps(queryCount);
+    vk::Result result = device.getQueryPoolResults(frame.queryPool, 0, queryCount, timestamps.size() * sizeof(uint64_t),
+        timestamps.data(), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+    if (result != vk::Result::eSuccess)
+        return;
+
+    passTiming.add(toMilliseconds(timestamps[0], timestamps[1]));
+
+    // Groups split over several secondaries (or drawn twice) count once per pipeline
+    std::map<PipelineId, float> groupTimes;
+    for (size_t group = 0; group < frame.drawGroups.size(); ++group)
+    {
+        size_t query = PASS_QUERY_COUNT + 2 * group;
+        groupTimes[frame.drawGroups[group]] += toMilliseconds(timestamps[query], timestamps[query + 1]);
+    }
+    for (const auto& groupTime : groupTimes)
+        drawGroupTimings[groupTime.first].add(groupTime.second);
+
+    ++collectedFrames;
+    if (logInterval > 0 && collectedFrames % logInterval == 0)
+        log();
+}
+
+std::map<PipelineId, GpuTimingStats> GpuProfiler::getDrawGroupStats() const
+{
+    std::map<PipelineId, GpuTimingStats> stats;
+    for (const auto& timing : drawGroupTimings)
+        stats[timing.first] = timing.second.stats;
+    return stats;
+}
+
+void GpuProfiler::RollingTiming::add(float ms)
+{
+    if (samples.size() < GPU_TIMING_WINDOW)
+        samples.push_back(ms);
+    else
+        samples[next] = ms;
+    next = (next + 1) % GPU_TIMING_WINDOW;
+
+    // Window is small, so statistics are simply taken again
+    float sum = 0.0f;
+    stats.minMs = samples[0];
+    stats.maxMs = samples[0];
+    for (float sample : samples)
+    {
+        sum += sample;
+        stats.minMs = std::min(stats.minMs, sample);
+        stats.maxMs = std::max(stats.maxMs, sample);
+    }
+    stats.lastMs = ms;
+    stats.averageMs = sum / samples.size();
+    stats.sampleCount = static_cast<uint32_t>(samples.size());
+}
+
+float GpuProfiler::toMilliseconds(uint64_t begin, uint64_t end) const
+{
+    // Counter may wrap within valid bits
+    uint64_t ticks = (end - begin) & timestampMask;
+    return static_cast<float>(static_cast<double>(ticks) * timestampPeriod / 1000000.0);
+}
+
+void GpuProfiler::log()
+{
+    const GpuTimingStats& pass = passTiming.stats;
+    std::cout << "GPU render pass: " << pass.averageMs << " ms avg, " << pass.minMs << " min, " << pass.maxMs << " max over "
+        << pass.sampleCount << " frames" << std::endl;
+
+    for (const auto& timing : drawGroupTimings)
+        std::cout << "    pipeline " << timing.first << ": " << timing.second.stats.averageMs << " ms avg" << std::endl;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <map>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include "PipelineRegistry.h"
+
+// Draw groups timed per frame. Groups beyond are drawn untimed
+#define MAX_GPU_DRAW_GROUPS 64
+// Frames rolling statistics are taken over
+#define GPU_TIMING_WINDOW 120
+
+// Gpu time of one zone over last GPU_TIMING_WINDOW frames, in milliseconds
+struct GpuTimingStats
+{
+    float lastMs = 0.0f;
+    float averageMs = 0.0f;
+    float minMs = 0.0f;
+    float maxMs = 0.0f;
+    uint32_t sampleCount = 0;
+};
+
+// Gpu timing of render pass and (optionally) its draw groups with timestamp queries
+// One query pool per frame in flight, read once fence of frame signalled, so gpu and cpu never wait on queries
+// Disabled on queues without timestamp support (timestampValidBits of 0)
+class GpuProfiler
+{
+public:
+    void init(const vk::PhysicalDevice& physicalDevice, const vk::Device& device, uint32_t queueFamily, uint32_t frameCount);
+    void destroy();
+
+    inline bool isSupported() const { return supported; }
+    // Draw group timestamps are recorded into draws, so draws have to be recorded again after change
+    inline void setDrawGroupTiming(bool enabled) { drawGroupTiming = enabled; }
+    inline bool isDrawGroupTiming() const { return supported && drawGroupTiming; }
+    // Collected frames between log lines. 0 turns log off
+    inline void setLogInterval(uint32_t frames) { logInterval = frames; }
+
+    // Pipeline of every draw group recorded into draws of frame, in query order. Called when draws are recorded
+    void setDrawGroups(uint32_t frameIndex, std::vector<PipelineId> pipelines);
+    // Around render pass in primary. Begin also resets queries of frame, so it has to be outside render pass
+    void beginPass(const vk::CommandBuffer& commandBuffer, uint32_t frameIndex);
+    void endPass(const vk::CommandBuffer& commandBuffer, uint32_t frameIndex);
+    // Around draw group in (secondary) command buffer of frame. Untimed beyond MAX_GPU_DRAW_GROUPS
+    void beginDrawGroup(const vk::CommandBuffer& commandBuffer, uint32_t frameIndex, uint32_t group);
+    void endDrawGroup(const vk::CommandBuffer& commandBuffer, uint32_t frameIndex, uint32_t group);
+    // Fence of frame signalled. Reads its timestamps into statistics
+    void collect(uint32_t frameIndex);
+
+    inline const GpuTimingStats& getPassStats() const { return passTiming.stats; }
+    // Summed over groups of same pipeline
+    std::map<PipelineId, GpuTimingStats> getDrawGroupStats() const;
+private:
+    struct RollingTiming
+    {
+        std::vector<float> samples;             // Ring of last GPU_TIMING_WINDOW samples
+        uint32_t next = 0;
+        GpuTimingStats stats;
+
+        void add(float ms);
+    };
+
+    struct Frame
+    {
+        vk::QueryPool queryPool;
+        std::vector<PipelineId> drawGroups;
+        bool pending = false;                   // Pass timestamps were submitted and not read yet
+    };
+
+    vk::Device device;
+    bool supported = false;
+    bool drawGroupTiming = false;
+    uint64_t timestampMask = ~0ull;             // Bits beyond timestampValidBits are undefined
+    float timestampPeriod = 1.0f;               // Nanoseconds per tick
+    uint32_t logInterval = 0;
+    uint64_t collectedFrames = 0;
+
+    std::vector<Frame> frames;
+    RollingTiming passTiming;
+    std::map<PipelineId, RollingTiming> drawGroupTimings;
+private:
+    float toMilliseconds(uint64_t begin, uint64_t end) const;
+    void log();
+};
@@ -0,0 +1,100 @@
+#include "volcanoPCH.h"
+#include "LayoutCache.h"
+
+#include <stdexcept>
+
+void LayoutCache::init(const vk::Device& device)
+{
+    this->device = device;
+}
+
+void LayoutCache::destroy()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (auto& layout : pipelineLayouts)
+        device.destroyPipelineLayout(layout.second);
+    for (auto& layout : descriptorSetLayouts)
+        device.destroyDescriptorSetLayout(layout.second);
+
+    pipelineLayouts.clear();
+    descriptorSetLayouts.clear();
+}
+
+vk::DescriptorSetLayout LayoutCache::getDescriptorSetLayout(const std::vector<vk::DescriptorSetLayoutBinding>& bindings)
+{
+    std::vector<uint32_t> key;
+    for (const auto& binding : bindings)
+    {
+        key.push_back(binding.binding);
+        key.push_back(static_cast<uint32_t>(binding.descriptorType));
+        key.push_back(binding.descriptorCount);
+        key.push_back(static_cast<uint32_t>(binding.stageFlags));
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = descriptorSetLayouts.find(key);
+    if (it != descriptorSetLayouts.end())
+        return it->second;
+
+    // create descriptor set layout with given binding
+    vk::DescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+    layoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutCreateInfo.pBindings = bindings.data();                               // pointer to array of bindings
+
+    vk::DescriptorSetLayout layout;
+    try
+    {
+        layout = device.createDescriptorSetLayout(layoutCreateInfo);
+    }
+    catch(vk::SystemError& err)
+    {
+        UNUSED(err);
+        throw std::runtime_error("Failed to create descriptor set layout");
+    }
+
+    descriptorSetLayouts.emplace(key, layout);
+    return layout;
+}
+
+vk::PipelineLayout LayoutCache::getPipelineLayout(const std::vector<vk::DescriptorSetLayout>& setLayouts, const std::vector<vk::PushConstantRange>& pushConstantRanges)
+{
+    // Set layouts are deduplicated above, so handles identify them
+    std::vector<uint64_t> key;
+    key.push_back(setLayouts.size());
+    for (const auto& setLayout : setLayouts)
+        key.push_back((uint64_t)(VkDescriptorSetLayout)setLayout);
+    for (const auto& range : pushConstantRanges)
+    {
+        key.push_back(static_cast<uint32_t>(range.stageFlags));
+        key.push_back(range.offset);
+        key.push_back(range.size);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = pipelineLayouts.find(key);
+    if (it != pipelineLayouts.end())
+        return it->second;
+
+    vk::PipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+    pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
+
+    vk::PipelineLayout layout;
+    try 
+    {
+        layout = device.createPipelineLayout(pipelineLayoutInfo);
+    }
+    catch(vk::SystemError& e)
+    {
+        UNUSED(e);
+        throw std::runtime_error("Failed to create pipleline layout");
+    }
+
+    pipelineLayouts.emplace(key, layout);
+    return layout;
+}
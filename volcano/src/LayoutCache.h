@@ -0,0 +1,26 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+// Owns descriptor set and pipeline layouts. Equal requests share one layout, so pipelines with
+// compatible shaders also share bound descriptor sets
+class LayoutCache
+{
+public:
+    void init(const vk::Device& device);
+    void destroy();
+
+    // Immutable samplers are not part of key and not supported
+    vk::DescriptorSetLayout getDescriptorSetLayout(const std::vector<vk::DescriptorSetLayoutBinding>& bindings);
+    vk::PipelineLayout getPipelineLayout(const std::vector<vk::DescriptorSetLayout>& setLayouts, const std::vector<vk::PushConstantRange>& pushConstantRanges);
+private:
+    vk::Device device;
+
+    // Keyed by every field of request
+    std::map<std::vector<uint32_t>, vk::DescriptorSetLayout> descriptorSetLayouts;
+    std::map<std::vector<uint64_t>, vk::PipelineLayout> pipelineLayouts;
+    std::mutex mutex;
+};
@@ -0,0 +1,316 @@
+#include "volcanoPCH.h"
+#include "MemoryAllocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+struct MemoryBlock
+{
+    struct FreeRange
+    {
+        vk::DeviceSize offset;
+        vk::DeviceSize size;
+    };
+
+    vk::DeviceMemory memory;
+    vk::DeviceSize size = 0;
+    uint32_t memoryTypeIndex = 0;
+    MemoryAllocator::ResourceKind kind = MemoryAllocator::ResourceKind::Linear;
+    bool dedicated = false;                 // Block holds exactly one large resource
+
+    std::vector<FreeRange> freeRanges;      // Sorted by offset, neighbours are always merged
+    vk::DeviceSize usedSize = 0;
+
+    void* mapped = nullptr;
+    uint32_t mapCount = 0;
+};
+
+static vk::DeviceSize alignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+MemoryAllocator::MemoryAllocator() = default;
+MemoryAllocator::~MemoryAllocator() = default;
+
+void MemoryAllocator::init(const vk::PhysicalDevice& physicalDevice, const vk::Device& device, vk::DeviceSize blockSize)
+{
+    this->device = device;
+    this->memoryProperties = physicalDevice.getMemoryProperties();
+    this->bufferImageGranularity = physicalDevice.getProperties().limits.bufferImageGranularity;
+    this->nonCoherentAtomSize = physicalDevice.getProperties().limits.nonCoherentAtomSize;
+
+    // Don't let a single block eat a noticeable part of small heaps
+    vk::DeviceSize smallestHeap = blockSize * 8;
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i)
+        smallestHeap = std::min(smallestHeap, memoryProperties.memoryHeaps[i].size);
+
+    this->blockSize = std::max<vk::DeviceSize>(smallestHeap / 8, 1024 * 1024);
+    this->blockSize = std::min(this->blockSize, blockSize);
+}
+
+void MemoryAllocator::destroy()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (auto& block : blocks)
+    {
+        if (block->mapped)
+            device.unmapMemory(block->memory);
+        device.freeMemory(block->memory);
+    }
+
+    blocks.clear();
+}
+
+MemoryAllocation MemoryAllocator::allocate(const vk::MemoryRequirements& requirements, vk::MemoryPropertyFlags properties, ResourceKind kind)
+{
+    uint32_t memoryTypeIndex = findMemoryTypeIndex(requirements.memoryTypeBits, properties);
+
+    // Granularity of 1 means linear and optimal resources can be tightly packed together
+    if (bufferImageGranularity <= 1)
+        kind = ResourceKind::Linear;
+
+    MemoryAllocation allocation;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Large resources get a block of their own instead of fragmenting shared blocks
+    if (requirements.size > blockSize / 2)
+    {
+        MemoryBlock* block = createBlock(memoryTypeIndex, kind, requirements.size, true);
+        allocateFromBlock(*block, requirements.size, requirements.alignment, allocation);
+        return allocation;
+    }
+
+    for (auto& block : blocks)
+    {
+        if (block->dedicated || block->memoryTypeIndex != memoryTypeIndex || block->kind != kind)
+            continue;
+
+        if (allocateFromBlock(*block, requirements.size, requirements.alignment, allocation))
+            return allocation;
+    }
+
+    // No space left in existing blocks
+    MemoryBlock* block = createBlock(memoryTypeIndex, kind, blockSize, false);
+    allocateFromBlock(*block, requirements.size, requirements.alignment, allocation);
+
+    return allocation;
+}
+
+void MemoryAllocator::free(MemoryAllocation& allocation)
+{
+    if (!allocation.block) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    MemoryBlock* block = allocation.block;
+    auto& ranges = block->freeRanges;
+
+    // Insert range back to sorted list
+    auto next = std::lower_bound(ranges.begin(), ranges.end(), allocation.offset,
+        [](const MemoryBlock::FreeRange& range, vk::DeviceSize offset) { return range.offset < offset; });
+    auto it = ranges.insert(next, { allocation.offset, allocation.size });
+
+    // Merge with next range
+    auto after = it + 1;
+    if (after != ranges.end() && it->offset + it->size == after->offset)
+    {
+        it->size += after->size;
+        ranges.erase(after);
+    }
+
+    // Merge with previous range
+    if (it != ranges.begin())
+    {
+        auto before = it - 1;
+        if (before->offset + before->size == it->offset)
+        {
+            before->size += it->size;
+            ranges.erase(it);
+        }
+    }
+
+    block->usedSize -= allocation.size;
+    allocation = MemoryAllocation();
+
+    // Release empty blocks. Keep one shared block per memory type around for future allocations
+    if (block->usedSize == 0 && block->mapCount == 0)
+    {
+        bool keep = !block->dedicated;
+        if (keep)
+        {
+            size_t siblings = std::count_if(blocks.begin(), blocks.end(), [block](const std::unique_ptr<MemoryBlock>& other) {
+                return !other->dedicated && other->memoryTypeIndex == block->memoryTypeIndex && other->kind == block->kind;
+            });
+            keep = siblings == 1;
+        }
+
+        if (!keep)
+            destroyBlock(block);
+    }
+}
+
+void* MemoryAllocator::map(const MemoryAllocation& allocation)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    MemoryBlock* block = allocation.block;
+    if (block->mapCount++ == 0)
+        block->mapped = device.mapMemory(block->memory, 0, VK_WHOLE_SIZE);
+
+    return static_cast<char*>(block->mapped) + allocation.offset;
+}
+
+void MemoryAllocator::unmap(const MemoryAllocation& allocation)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    MemoryBlock* block = allocation.block;
+    if (--block->mapCount == 0)
+    {
+        device.unmapMemory(block->memory);
+        block->mapped = nullptr;
+    }
+}
+
+void MemoryAllocator::flush(const MemoryAllocation& allocation, vk::DeviceSize offset, vk::DeviceSize size)
+{
+    if (isCoherent(allocation))
+        return;
+
+    device.flushMappedMemoryRanges(getMappedRange(allocation, offset, size));
+}
+
+void MemoryAllocator::invalidate(const MemoryAllocation& allocation, vk::DeviceSize offset, vk::DeviceSize size)
+{
+    if (isCoherent(allocation))
+        return;
+
+    device.invalidateMappedMemoryRanges(getMappedRange(allocation, offset, size));
+}
+
+vk::MappedMemoryRange MemoryAllocator::getMappedRange(const MemoryAllocation& allocation, vk::DeviceSize offset, vk::DeviceSize size) const
+{
+    if (size == VK_WHOLE_SIZE)
+        size = allocation.size - offset;
+
+    // Range has to start and end at atom boundaries (or end of memory)
+    MemoryBlock* block = allocation.block;
+    vk::DeviceSize begin = allocation.offset + offset;
+    vk::DeviceSize end = begin + size;
+    begin = begin & ~(nonCoherentAtomSize - 1);
+    end = std::min(alignUp(end, nonCoherentAtomSize), block->size);
+
+    vk::MappedMemoryRange range = {};
+    range.memory = block->memory;
+    range.offset = begin;
+    range.size = end == block->size ? VK_WHOLE_SIZE : end - begin;
+    return range;
+}
+
+bool MemoryAllocator::isCoherent(const MemoryAllocation& allocation) const
+{
+    if (!allocation.block)
+        return true;
+
+    return static_cast<bool>(memoryProperties.memoryTypes[allocation.block->memoryTypeIndex].propertyFlags & vk::MemoryPropertyFlagBits::eHostCoherent);
+}
+
+uint32_t MemoryAllocator::findMemoryTypeIndex(uint32_t allowedTypes, vk::MemoryPropertyFlags properties) const
+{
+    uint32_t memoryTypeIndex;
+    if (!tryFindMemoryTypeIndex(allowedTypes, properties, memoryTypeIndex))
+        throw std::runtime_error("Failed to find suitable memory type");
+
+    return memoryTypeIndex;
+}
+
+bool MemoryAllocator::tryFindMemoryTypeIndex(uint32_t allowedTypes, vk::MemoryPropertyFlags properties, uint32_t& memoryTypeIndex) const
+{
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+    {
+        // Memory type must be allowed and have every requested property
+        if ((allowedTypes & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+        {
+            memoryTypeIndex = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+MemoryBlock* MemoryAllocator::createBlock(uint32_t memoryTypeIndex, ResourceKind kind, vk::DeviceSize size, bool dedicated)
+{
+    vk::MemoryAllocateInfo memoryAllocInfo = {};
+    memoryAllocInfo.allocationSize = size;
+    memoryAllocInfo.memoryTypeIndex = memoryTypeIndex;
+
+    auto block = std::make_unique<MemoryBlock>();
+
+    try
+    {
+        block->memory = device.allocateMemory(memoryAllocInfo);
+    }
+    catch (const vk::SystemError& e)
+    {
+        throw std::runtime_error("Failed to allocate memory: " + std::string(e.what()));
+    }
+
+    block->size = size;
+    block->memoryTypeIndex = memoryTypeIndex;
+    block->kind = kind;
+    block->dedicated = dedicated;
+    block->freeRanges.push_back({ 0, size });
+
+    blocks.push_back(std::move(block));
+    return blocks.back().get();
+}
+
+void MemoryAllocator::destroyBlock(MemoryBlock* block)
+{
+    device.freeMemory(block->memory);
+
+    blocks.erase(std::remove_if(blocks.begin(), blocks.end(),
+        [block](const std::unique_ptr<MemoryBlock>& other) { return other.get() == block; }), blocks.end());
+}
+
+bool MemoryAllocator::allocateFromBlock(MemoryBlock& block, vk::DeviceSize size, vk::DeviceSize alignment, MemoryAllocation& allocation)
+{
+    // Best fit -> smallest free range that can hold aligned allocation
+    auto best = block.freeRanges.end();
+    for (auto it = block.freeRanges.begin(); it != block.freeRanges.end(); ++it)
+    {
+        vk::DeviceSize padding = alignUp(it->offset, alignment) - it->offset;
+        if (padding + size > it->size)
+            continue;
+
+        if (best == block.freeRanges.end() || it->size < best->size)
+            best = it;
+    }
+
+    if (best == block.freeRanges.end())
+        return false;
+
+    vk::DeviceSize rangeOffset = best->offset;
+    vk::DeviceSize rangeEnd = best->offset + best->size;
+    vk::DeviceSize offset = alignUp(rangeOffset, alignment);
+
+    // Split range. Padding before allocation stays in free list
+    auto it = block.freeRanges.erase(best);
+    if (offset + size < rangeEnd)
+        it = block.freeRanges.insert(it, { offset + size, rangeEnd - offset - size });
+    if (offset > rangeOffset)
+        block.freeRanges.insert(it, { rangeOffset, offset - rangeOffset });
+
+    block.usedSize += size;
+
+    allocation.memory = block.memory;
+    allocation.offset = offset;
+    allocation.size = size;
+    allocation.block = &block;
+
+    return true;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+struct MemoryBlock;
+
+// Region of device memory handed out by the MemoryAllocator
+// Many allocations share one vk::DeviceMemory and only differ by offset
+struct MemoryAllocation
+{
+    vk::DeviceMemory memory;
+    vk::DeviceSize offset = 0;
+    vk::DeviceSize size = 0;
+    MemoryBlock* block = nullptr;       // Owning block (null for an empty allocation)
+};
+
+// Block based sub-allocator
+// Reserves large vk::DeviceMemory blocks per memory type and carves resources out of them
+// so the number of vkAllocateMemory calls stays far below maxMemoryAllocationCount
+class MemoryAllocator
+{
+public:
+    // Buffers and linear images must not share a bufferImageGranularity page with optimal images.
+    // Each kind gets its own set of blocks so that neighbours are always of the same kind
+    enum class ResourceKind
+    {
+        Linear,
+        Optimal
+    };
+
+    static constexpr vk::DeviceSize DEFAULT_BLOCK_SIZE = 64 * 1024 * 1024;
+
+    // Defined where MemoryBlock is complete, so owners only need this header
+    MemoryAllocator();
+    ~MemoryAllocator();
+
+    void init(const vk::PhysicalDevice& physicalDevice, const vk::Device& device, vk::DeviceSize blockSize = DEFAULT_BLOCK_SIZE);
+    void destroy();
+
+    MemoryAllocation allocate(const vk::MemoryRequirements& requirements, vk::MemoryPropertyFlags properties, ResourceKind kind);
+    void free(MemoryAllocation& allocation);
+
+    // Map memory of allocation. Block is mapped once and shared between all allocations in it
+    void* map(const MemoryAllocation& allocation);
+    void unmap(const MemoryAllocation& allocation);
+    // Make host writes to range of allocation visible to device. No-op for host coherent memory
+    void flush(const MemoryAllocation& allocation, vk::DeviceSize offset = 0, vk::DeviceSize size = VK_WHOLE_SIZE);
+    // Make device writes to range of allocation visible to host. No-op for host coherent memory
+    void invalidate(const MemoryAllocation& allocation, vk::DeviceSize offset = 0, vk::DeviceSize size = VK_WHOLE_SIZE);
+    bool isCoherent(const MemoryAllocation& allocation) const;
+
+    uint32_t findMemoryTypeIndex(uint32_t allowedTypes, vk::MemoryPropertyFlags properties) const;
+    bool tryFindMemoryTypeIndex(uint32_t allowedTypes, vk::MemoryPropertyFlags properties, uint32_t& memoryTypeIndex) const;
+    inline size_t getBlockCount() const { return blocks.size(); }
+    // Flushed and invalidated ranges are widened to multiples of it
+    inline vk::DeviceSize getNonCoherentAtomSize() const { return nonCoherentAtomSize; }
+private:
+    vk::Device device;
+    vk::PhysicalDeviceMemoryProperties memoryProperties;
+    vk::DeviceSize blockSize = DEFAULT_BLOCK_SIZE;
+    vk::DeviceSize bufferImageGranularity = 1;
+    vk::DeviceSize nonCoherentAtomSize = 1;
+
+    std::vector<std::unique_ptr<MemoryBlock>> blocks;
+    std::mutex mutex;
+private:
+    MemoryBlock* createBlock(uint32_t memoryTypeIndex, ResourceKind kind, vk::DeviceSize size, bool dedicated);
+    void destroyBlock(MemoryBlock* block);
+    vk::MappedMemoryRange getMappedRange(const MemoryAllocation& allocation, vk::DeviceSize offset, vk::DeviceSize size) const;
+    static bool allocateFromBlock(MemoryBlock& block, vk::DeviceSize size, vk::DeviceSize alignment, MemoryAllocation& allocation);
+};
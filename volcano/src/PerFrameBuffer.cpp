@@ -0,0 +1,98 @@
+#include "volcanoPCH.h"
+#include "PerFrameBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+void PerFrameBuffer::init(MemoryAllocator& allocator, const vk::Device& device, vk::DeviceSize regionSize, uint32_t regionCount,
+    vk::BufferUsageFlags usage, vk::DeviceSize alignment, bool hostRead)
+{
+    this->allocator = &allocator;
+    this->device = device;
+    this->regionSize = regionSize;
+    this->regionCount = regionCount;
+
+    // Flushes are widened to whole atoms. Regions of other frames (still read by gpu) must not share an atom
+    // Alignment need not be a power of two (e.g. size of indirect command), so both are combined with lcm
+    vk::DeviceSize atomSize = allocator.getNonCoherentAtomSize();
+    alignment = std::lcm(std::max<vk::DeviceSize>(alignment, 1), atomSize);
+    this->regionStride = (regionSize + alignment - 1) / alignment * alignment;
+
+    vk::BufferCreateInfo bufferInfo = {};
+    bufferInfo.size = regionStride * regionCount;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = vk::SharingMode::eExclusive;
+
+    try
+    {
+        buffer = device.createBuffer(bufferInfo);
+    }
+    catch (vk::SystemError& e)
+    {
+        UNUSED(e);
+        throw std::runtime_error("Failed to create per frame buffer");
+    }
+
+    // First region has to start at atom boundary of memory too. Both are powers of two
+    vk::MemoryRequirements memRequirements = device.getBufferMemoryRequirements(buffer);
+    memRequirements.alignment = std::max(memRequirements.alignment, atomSize);
+
+    // Prefer coherent memory. Otherwise every write is followed by explicit flush
+    // Uncached memory is very slow to read from, so readback buffers rather take cached memory and invalidate
+    vk::MemoryPropertyFlags properties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+    uint32_t memoryTypeIndex;
+    if (hostRead && allocator.tryFindMemoryTypeIndex(memRequirements.memoryTypeBits,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCached, memoryTypeIndex))
+        properties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCached;
+    else if (!allocator.tryFindMemoryTypeIndex(memRequirements.memoryTypeBits, properties, memoryTypeIndex))
+        properties = vk::MemoryPropertyFlagBits::eHostVisible;
+
+    memory = allocator.allocate(memRequirements, properties, MemoryAllocator::ResourceKind::Linear);
+    device.bindBufferMemory(buffer, memory.memory, memory.offset);
+
+    mapped = static_cast<char*>(allocator.map(memory));
+    coherent = allocator.isCoherent(memory);
+}
+
+void PerFrameBuffer::destroy()
+{
+    if (!buffer)
+        return;
+
+    allocator->unmap(memory);
+    device.destroyBuffer(buffer);
+    allocator->free(memory);
+
+    buffer = nullptr;
+    mapped = nullptr;
+}
+
+void PerFrameBuffer::write(uint32_t region, const void* data, vk::DeviceSize size, vk::DeviceSize offset)
+{
+    memcpy(static_cast<char*>(getData(region)) + offset, data, static_cast<size_t>(size));
+    flush(region, offset, size);
+}
+
+void PerFrameBuffer::invalidate(uint32_t region, vk::DeviceSize offset, vk::DeviceSize size)
+{
+    if (coherent)
+        return;
+
+    if (size == VK_WHOLE_SIZE)
+        size = regionSize - offset;
+
+    allocator->invalidate(memory, getOffset(region) + offset, size);
+}
+
+void PerFrameBuffer::flush(uint32_t region, vk::DeviceSize offset, vk::DeviceSize size)
+{
+    if (coherent)
+        return;
+
+    if (size == VK_WHOLE_SIZE)
+        size = regionSize - offset;
+
+    allocator->flush(memory, getOffset(region) + offset, size);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include "MemoryAllocator.h"
+
+// Host visible buffer split into one region per frame (or swapchain image)
+// Mapped once at creation. Cpu writes through cached pointer and flushes if memory is not coherent
+class PerFrameBuffer
+{
+public:
+    // Regions start at multiples of alignment (e.g. minUniformBufferOffsetAlignment) and of nonCoherentAtomSize,
+    // so flushing one region never touches bytes of another
+    // hostRead buffers are written by gpu and read by cpu. They prefer cached memory
+    void init(MemoryAllocator& allocator, const vk::Device& device, vk::DeviceSize regionSize, uint32_t regionCount,
+        vk::BufferUsageFlags usage, vk::DeviceSize alignment = 1, bool hostRead = false);
+    void destroy();
+
+    inline void* getData(uint32_t region) const { return mapped + getOffset(region); }
+    template<typename T>
+    inline T* get(uint32_t region) const { return static_cast<T*>(getData(region)); }
+
+    // Copy into region and flush written range
+    void write(uint32_t region, const void* data, vk::DeviceSize size, vk::DeviceSize offset = 0);
+    // Needed after writing through getData. Range is relative to region
+    void flush(uint32_t region, vk::DeviceSize offset = 0, vk::DeviceSize size = VK_WHOLE_SIZE);
+    // Needed before reading what gpu wrote through getData
+    void invalidate(uint32_t region, vk::DeviceSize offset = 0, vk::DeviceSize size = VK_WHOLE_SIZE);
+
+    inline vk::Buffer getBuffer() const { return buffer; }
+    inline vk::DeviceSize getOffset(uint32_t region) const { return regionStride * region; }
+    inline vk::DeviceSize getRegionSize() const { return regionSize; }
+    inline uint32_t getRegionCount() const { return regionCount; }
+private:
+    MemoryAllocator* allocator = nullptr;
+    vk::Device device;
+
+    vk::Buffer buffer;
+    MemoryAllocation memory;
+    char* mapped = nullptr;
+    bool coherent = true;
+
+    vk::DeviceSize regionSize = 0;
+    vk::DeviceSize regionStride = 0;
+    uint32_t regionCount = 0;
+};
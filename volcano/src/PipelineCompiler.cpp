@@ -0,0 +1,204 @@
+#include "volcanoPCH.h"
+#include "PipelineCompiler.h"
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include "ShaderRegistry.h"
+
+void PipelineCompiler::init(const vk::Device& device, const vk::PipelineCache& cache, ThreadPool& threadPool)
+{
+    this->device = device;
+    this->cache = cache;
+    this->threadPool = &threadPool;
+}
+
+std::shared_future<vk::Pipeline> PipelineCompiler::compile(const PipelineDescription& description)
+{
+    // Job owns copy of description, so caller's may go away
+    return threadPool->submit([this, description]() {
+        return build(description);
+    }).share();
+}
+
+vk::UniqueShaderModule PipelineCompiler::createShaderModule(const std::string& filename) const
+{
+    // Embedded code or file
+    auto code = shaders::load(filename.c_str());
+
+    try 
+    {
+        vk::ShaderModuleCreateInfo shaderCreateInfo = vk::ShaderModuleCreateInfo(
+            vk::ShaderModuleCreateFlags(),
+            code.size(),
+            reinterpret_cast<const uint32_t*>(code.data())
+        );
+        return device.createShaderModuleUnique(shaderCreateInfo);
+    }
+    catch(vk::SystemError& err)
+    {
+        UNUSED(err);
+        throw std::runtime_error("Failed to create shader module");
+    }
+}
+
+vk::SpecializationInfo PipelineCompiler::createSpecializationInfo(const std::vector<SpecializationConstant>& constants,
+    std::vector<vk::SpecializationMapEntry>& entries)
+{
+    // Data is constants as they are. Entry of each one points at its value, ids need not be contiguous
+    entries.resize(constants.size());
+    for (uint32_t i = 0; i < entries.size(); ++i)
+    {
+        entries[i].constantID = constants[i].id;
+        entries[i].offset = static_cast<uint32_t>(i * sizeof(SpecializationConstant) + offsetof(SpecializationConstant, value));
+        entries[i].size = sizeof(uint32_t);
+    }
+
+    vk::SpecializationInfo info = {};
+    info.mapEntryCount = static_cast<uint32_t>(entries.size());
+    info.pMapEntries = entries.data();
+    info.dataSize = sizeof(SpecializationConstant) * constants.size();
+    info.pData = constants.data();
+    return info;
+}
+
+vk::Pipeline PipelineCompiler::build(const PipelineDescription& description) const
+{
+    auto start = std::chrono::steady_clock::now();
+
+    // create shader modules for pipeline
+    auto vertShaderModule = createShaderModule(description.vertexShader);
+    auto fragShaderModule = createShaderModule(description.fragmentShader);
+
+    // Constants not given keep default value from shader
+    std::vector<vk::SpecializationMapEntry> vertexEntries, fragmentEntries;
+    vk::SpecializationInfo vertexSpecialization = createSpecializationInfo(description.vertexConstants, vertexEntries);
+    vk::SpecializationInfo fragmentSpecialization = createSpecializationInfo(description.fragmentConstants, fragmentEntries);
+
+    // Pipeline info for 2 types of shaders
+    vk::PipelineShaderStageCreateInfo shaderStages[] = {
+        {
+            vk::PipelineShaderStageCreateFlags(),
+            vk::ShaderStageFlagBits::eVertex,       // Vertex shader
+            *vertShaderModule,                      // reference to module
+            "main",                                 // Start at main function
+            &vertexSpecialization
+        },
+        {
+            vk::PipelineShaderStageCreateFlags(),
+            vk::ShaderStageFlagBits::eFragment,     // Fragment shader
+            *fragShaderModule,
+            "main",
+            &fragmentSpecialization
+        }
+    };
+
+    // Vertex inputs
+    const PipelineState& state = description.state;
+    vk::PipelineVertexInputStateCreateInfo vertexInputCreateInfo = {};
+    vertexInputCreateInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(description.vertexBindings.size());
+    vertexInputCreateInfo.pVertexBindingDescriptions = description.vertexBindings.data();          // list of vertex bindings (data spacing/stride)
+    vertexInputCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(description.vertexAttributes.size());
+    vertexInputCreateInfo.pVertexAttributeDescriptions = description.vertexAttributes.data();      // list of vertex attribute (data format and where/location)
+
+    // Input assembly
+    vk::PipelineInputAssemblyStateCreateInfo assemblyCreateInfo = {};
+    assemblyCreateInfo.topology = state.topology;                          // Primitive type to assembly vertex data to
+    assemblyCreateInfo.primitiveRestartEnable = VK_FALSE;                   // Allow overriding of strip topology
+
+    // Viewport and scissor
+    // Both are dynamic and set when recording, so pipeline does not depend on swapchain extent
+    vk::PipelineViewportStateCreateInfo viewportStateInfo = {};
+    viewportStateInfo.viewportCount = 1;
+    viewportStateInfo.pViewports = nullptr;
+    viewportStateInfo.scissorCount = 1;
+    viewportStateInfo.pScissors = nullptr;
+
+    // Dynamic state
+    std::vector<vk::DynamicState> dynamicStateEnable = { 
+        vk::DynamicState::eViewport,                                        // Dynamic viewport can be resized with command buffer
+        vk::DynamicState::eScissor                                          // Resize with command buffer
+    };
+
+    vk::PipelineDynamicStateCreateInfo dynamicStateCreateInfo = {};         // Set dynamic state data
+    dynamicStateCreateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStateEnable.size());
+    dynamicStateCreateInfo.pDynamicStates = dynamicStateEnable.data();
+
+    // Rasterizer
+    // Convert primitive to fragment
+    vk::PipelineRasterizationStateCreateInfo rasterizerInfo = {};
+    rasterizerInfo.depthClampEnable = VK_FALSE;                                 // Clip things beyond near/far plane
+    rasterizerInfo.rasterizerDiscardEnable = VK_FALSE;                          // Wheather to create data or skip rasterizer
+    rasterizerInfo.polygonMode = state.polygonMode;                             // Fill entire polygon
+    rasterizerInfo.lineWidth = 1.0f;                                            // Line thickness (need gpu extension for line width other than 1)
+    rasterizerInfo.cullMode = state.cullMode;                                   // Do not draw useless back face
+    rasterizerInfo.frontFace = state.frontFace;                                 // Clockwise indices are front. Don't draw useless anti clockwise back face
+    rasterizerInfo.depthBiasEnable = VK_FALSE;                                  // true to overcome shadow acne
+
+    // Multisampling
+    vk::PipelineMultisampleStateCreateInfo multisampleInfo = {};
+    multisampleInfo.sampleShadingEnable = VK_FALSE;                             // Disable multisampling
+    multisampleInfo.rasterizationSamples = state.samples;                       // Single sample (other value for amount of sample)
+
+    // How to handle color blending
+    vk::PipelineColorBlendAttachmentState colorBlendAttachment;
+    colorBlendAttachment.colorWriteMask = state.colorWriteMask;
+    colorBlendAttachment.blendEnable = state.blendEnable;
+    colorBlendAttachment.srcColorBlendFactor = state.srcColorBlendFactor;
+    colorBlendAttachment.dstColorBlendFactor = state.dstColorBlendFactor;
+    colorBlendAttachment.colorBlendOp = state.colorBlendOp;
+    colorBlendAttachment.srcAlphaBlendFactor = state.srcAlphaBlendFactor;
+    colorBlendAttachment.dstAlphaBlendFactor = state.dstAlphaBlendFactor;
+    colorBlendAttachment.alphaBlendOp = state.alphaBlendOp;
+    
+    // Blending
+    vk::PipelineColorBlendStateCreateInfo colorBlendCreateInfo = {};
+    colorBlendCreateInfo.logicOpEnable = VK_FALSE;                              // Mathamatical > logical
+    colorBlendCreateInfo.attachmentCount = 1;
+    colorBlendCreateInfo.pAttachments = &colorBlendAttachment;
+    
+    // Depth stencil testing
+    vk::PipelineDepthStencilStateCreateInfo depthStencilCreateInfo = {};
+    depthStencilCreateInfo.depthTestEnable = state.depthTestEnable;    // enable depth checking for fragment write
+    depthStencilCreateInfo.depthWriteEnable = state.depthWriteEnable;  // enable depth writing
+    depthStencilCreateInfo.depthCompareOp = state.depthCompareOp;      // If new value is less then override value
+    depthStencilCreateInfo.depthBoundsTestEnable = VK_FALSE;            // Depth bound test -> does depth exist between given min and max bounds
+    depthStencilCreateInfo.stencilTestEnable = VK_FALSE;
+
+    // Graphics pipeline creation
+    vk::GraphicsPipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.stageCount = 2;                        // 2 stage vertex and fragment shader
+    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.pVertexInputState = &vertexInputCreateInfo;
+    pipelineInfo.pInputAssemblyState = &assemblyCreateInfo;
+    pipelineInfo.pViewportState = &viewportStateInfo;
+    pipelineInfo.pDynamicState = &dynamicStateCreateInfo;
+    pipelineInfo.pRasterizationState = &rasterizerInfo;
+    pipelineInfo.pMultisampleState = &multisampleInfo;
+    pipelineInfo.pColorBlendState = &colorBlendCreateInfo;
+    pipelineInfo.pDepthStencilState = &depthStencilCreateInfo;
+    pipelineInfo.layout = description.layout;
+    pipelineInfo.renderPass = description.renderPass;
+    pipelineInfo.subpass = description.subpass;
+
+    // pipeline derivaties
+    pipelineInfo.basePipelineHandle = nullptr;          // Existing pipeline to derive from
+    pipelineInfo.basePipelineIndex = -1;                // index of existing pipeline
+
+    vk::Pipeline pipeline;
+    try
+    {
+        pipeline = device.createGraphicsPipeline(cache, pipelineInfo).value;
+    }
+    catch (const std::exception&)
+    {
+        throw std::runtime_error("Failed to create graphics pipeline");
+    }
+
+    // Compile time shows whether pipeline cache was warm
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Pipeline compiled (" << description.vertexShader << ", " << description.fragmentShader << "): " << elapsed.count() << " ms" << std::endl;
+
+    // Unique shader modules automatically destroys after pipeline creation
+    return pipeline;
+}
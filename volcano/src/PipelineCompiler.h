@@ -0,0 +1,35 @@
+#pragma once
+
+#include <chrono>
+#include <future>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include "PipelineDescription.h"
+#include "ThreadPool.h"
+
+// Compiles graphics pipelines on worker threads against one shared pipeline cache
+// Renderer polls returned futures and skips draws until their pipeline is ready
+class PipelineCompiler
+{
+public:
+    void init(const vk::Device& device, const vk::PipelineCache& cache, ThreadPool& threadPool);
+
+    // Never blocks. Caller owns resulting pipeline (see PipelineRegistry)
+    std::shared_future<vk::Pipeline> compile(const PipelineDescription& description);
+
+    static bool isReady(const std::shared_future<vk::Pipeline>& pipeline)
+    {
+        return pipeline.valid() && pipeline.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+private:
+    vk::Device device;
+    vk::PipelineCache cache;                // Internally synchronized, so workers share it
+    ThreadPool* threadPool = nullptr;
+private:
+    // Runs on worker thread
+    vk::Pipeline build(const PipelineDescription& description) const;
+    vk::UniqueShaderModule createShaderModule(const std::string& filename) const;
+    // Entries have to outlive returned info
+    static vk::SpecializationInfo createSpecializationInfo(const std::vector<SpecializationConstant>& constants,
+        std::vector<vk::SpecializationMapEntry>& entries);
+};
@@ -0,0 +1,52 @@
+#include "volcanoPCH.h"
+#include "PipelineDescription.h"
+
+#include <cstring>
+
+#define XXH_PRIVATE_API
+#include <vulkan/xxhash.h>
+
+namespace
+{
+    // Chained, previous hash is seed of next part
+    uint64_t hashBytes(const void* data, size_t size, uint64_t seed)
+    {
+        return XXH64(data, size, seed);
+    }
+
+    template<typename T>
+    uint64_t hashVector(const std::vector<T>& values, uint64_t seed)
+    {
+        // Count first, so moving an element between neighbouring lists changes hash
+        uint64_t count = values.size();
+        seed = hashBytes(&count, sizeof(count), seed);
+        return hashBytes(values.data(), sizeof(T) * values.size(), seed);
+    }
+}
+
+uint64_t PipelineDescription::hash() const
+{
+    uint64_t seed = 0;
+    seed = hashBytes(vertexShader.data(), vertexShader.size() + 1, seed);           // Including terminator
+    seed = hashBytes(fragmentShader.data(), fragmentShader.size() + 1, seed);
+    seed = hashVector(vertexConstants, seed);
+    seed = hashVector(fragmentConstants, seed);
+    seed = hashVector(vertexBindings, seed);
+    seed = hashVector(vertexAttributes, seed);
+    seed = hashBytes(&state, sizeof(state), seed);
+
+    VkPipelineLayout pipelineLayout = layout;
+    VkRenderPass pass = renderPass;
+    seed = hashBytes(&pipelineLayout, sizeof(pipelineLayout), seed);
+    seed = hashBytes(&pass, sizeof(pass), seed);
+    return hashBytes(&subpass, sizeof(subpass), seed);
+}
+
+bool PipelineDescription::operator==(const PipelineDescription& other) const
+{
+    return vertexShader == other.vertexShader && fragmentShader == other.fragmentShader &&
+        vertexConstants == other.vertexConstants && fragmentConstants == other.fragmentConstants &&
+        vertexBindings == other.vertexBindings && vertexAttributes == other.vertexAttributes &&
+        memcmp(&state, &other.state, sizeof(state)) == 0 &&
+        layout == other.layout && renderPass == other.renderPass && subpass == other.subpass;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+// Fixed function state of pipeline. Only 32 bit members so it can be hashed and compared as bytes
+// Defaults give alpha blended, back face culled, depth tested triangles
+struct PipelineState
+{
+    // Input assembly
+    vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList;
+
+    // Rasterizer
+    vk::PolygonMode polygonMode = vk::PolygonMode::eFill;
+    vk::CullModeFlags cullMode = vk::CullModeFlagBits::eBack;
+    vk::FrontFace frontFace = vk::FrontFace::eCounterClockwise;
+    vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1;
+
+    // Blending. (srcColorBlendFactor * newColour) colorBlendOp (dstColorBlendFactor * oldColour)
+    vk::Bool32 blendEnable = VK_TRUE;
+    vk::BlendFactor srcColorBlendFactor = vk::BlendFactor::eSrcAlpha;
+    vk::BlendFactor dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha;
+    vk::BlendOp colorBlendOp = vk::BlendOp::eAdd;
+    vk::BlendFactor srcAlphaBlendFactor = vk::BlendFactor::eOne;
+    vk::BlendFactor dstAlphaBlendFactor = vk::BlendFactor::eZero;
+    vk::BlendOp alphaBlendOp = vk::BlendOp::eAdd;
+    vk::ColorComponentFlags colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+        vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+
+    // Depth
+    vk::Bool32 depthTestEnable = VK_TRUE;
+    vk::Bool32 depthWriteEnable = VK_TRUE;
+    vk::CompareOp depthCompareOp = vk::CompareOp::eLess;
+};
+
+// Specialization constant ids of shader.fs.glsl
+enum class FragmentConstant : uint32_t
+{
+    UseTexture = 0,
+    AlphaTest = 1,
+    AlphaCutoff = 2
+};
+
+// Value of one specialization constant. Constants not given keep default of shader
+struct SpecializationConstant
+{
+    uint32_t id;                            // constant_id in shader
+    uint32_t value;                         // All 32 bit
+
+    bool operator==(const SpecializationConstant& other) const { return id == other.id && value == other.value; }
+};
+
+// Everything a graphics pipeline is built from. Equal descriptions give same pipeline
+struct PipelineDescription
+{
+    std::string vertexShader;               // Path of compiled SPIR-V
+    std::string fragmentShader;
+
+    // Specialization constants set for each stage, sorted by id, so same settings compare and hash equal
+    // Variants of one SPIR-V module, with code of disabled features removed by driver
+    std::vector<SpecializationConstant> vertexConstants;
+    std::vector<SpecializationConstant> fragmentConstants;
+
+    // Vertex layout
+    std::vector<vk::VertexInputBindingDescription> vertexBindings;
+    std::vector<vk::VertexInputAttributeDescription> vertexAttributes;
+
+    PipelineState state;
+
+    vk::PipelineLayout layout;
+    vk::RenderPass renderPass;              // Pipeline works with any compatible render pass
+    uint32_t subpass = 0;
+
+    void setFragmentConstant(FragmentConstant id, uint32_t value)
+    {
+        // Only constants set here are specialized. Others keep their default instead of becoming 0
+        uint32_t constantId = static_cast<uint32_t>(id);
+        auto it = std::lower_bound(fragmentConstants.begin(), fragmentConstants.end(), constantId,
+            [](const SpecializationConstant& constant, uint32_t id) { return constant.id < id; });
+        if (it != fragmentConstants.end() && it->id == constantId)
+            it->value = value;
+        else
+            fragmentConstants.insert(it, { constantId, value });
+    }
+    void setFragmentConstant(FragmentConstant id, bool value)
+    {
+        setFragmentConstant(id, static_cast<uint32_t>(value ? VK_TRUE : VK_FALSE));
+    }
+    void setFragmentConstant(FragmentConstant id, float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        setFragmentConstant(id, bits);
+    }
+
+    // xxhash of every member
+    uint64_t hash() const;
+    bool operator==(const PipelineDescription& other) const;
+    bool operator!=(const PipelineDescription& other) const { return !(*this == other); }
+};
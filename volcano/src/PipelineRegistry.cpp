@@ -0,0 +1,221 @@
+#include "volcanoPCH.h"
+#include "PipelineRegistry.h"
+
+#include <algorithm>
+#include <iostream>
+
+void PipelineRegistry::init(const vk::Device& device, PipelineCompiler& compiler)
+{
+    this->device = device;
+    this->compiler = &compiler;
+}
+
+void PipelineRegistry::destroy()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& entry : entries)
+    {
+        destroyPipeline(entry.pipeline);
+        destroyPipeline(entry.reloaded);
+    }
+
+    entries.clear();
+    lookup.clear();
+}
+
+PipelineId PipelineRegistry::request(const PipelineDescription& description)
+{
+    uint64_t hash = description.hash();
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Same hash is compared in full, so a collision never hands out wrong pipeline
+    auto& candidates = lookup[hash];
+    for (PipelineId id : candidates)
+    {
+        if (entries[id].description == description)
+            return id;
+    }
+
+    PipelineId id = static_cast<PipelineId>(entries.size());
+    entries.push_back({ description, compiler->compile(description) });
+    candidates.push_back(id);
+    return id;
+}
+
+bool PipelineRegistry::isReady(PipelineId id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return checkReady(entries.at(id));
+}
+
+bool PipelineRegistry::hasFailed(PipelineId id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry& entry = entries.at(id);
+    checkReady(entry);
+    return entry.failed;
+}
+
+vk::Pipeline PipelineRegistry::get(PipelineId id)
+{
+    std::shared_future<vk::Pipeline> pipeline;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pipeline = entries.at(id).pipeline;
+    }
+
+    return pipeline.get();
+}
+
+PipelineDescription PipelineRegistry::getDescription(PipelineId id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.at(id).description;
+}
+
+void PipelineRegistry::rebuild(const vk::RenderPass& oldRenderPass, const vk::RenderPass& newRenderPass)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Pipelines of other render contexts are left alone
+    for (PipelineId id = 0; id < entries.size(); ++id)
+    {
+        Entry& entry = entries[id];
+        if (entry.description.renderPass != oldRenderPass || !entry.pipeline.valid())
+            continue;
+
+        removeLookup(id);
+        destroyPipeline(entry.pipeline);
+        // Pending reload is for old render pass. New compile reads current shader anyway
+        destroyPipeline(entry.reloaded);
+        entry.reloaded = {};
+
+        entry.description.renderPass = newRenderPass;
+        entry.failed = false;
+        entry.pipeline = compiler->compile(entry.description);
+        lookup[entry.description.hash()].push_back(id);
+    }
+}
+
+void PipelineRegistry::retire(const vk::RenderPass& renderPass)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (PipelineId id = 0; id < entries.size(); ++id)
+    {
+        Entry& entry = entries[id];
+        if (entry.description.renderPass != renderPass || !entry.pipeline.valid())
+            continue;
+
+        // Waits for compile still running. Entry stays so ids of other pipelines don't move
+        removeLookup(id);
+        destroyPipeline(entry.pipeline);
+        destroyPipeline(entry.reloaded);
+        entry.pipeline = {};
+        entry.reloaded = {};
+    }
+}
+
+void PipelineRegistry::removeLookup(PipelineId id)
+{
+    auto it = lookup.find(entries[id].description.hash());
+    if (it == lookup.end())
+        return;
+
+    auto& candidates = it->second;
+    candidates.erase(std::remove(candidates.begin(), candidates.end(), id), candidates.end());
+    if (candidates.empty())
+        lookup.erase(it);
+}
+
+bool PipelineRegistry::checkReady(Entry& entry)
+{
+    // Retired entries have no pipeline
+    if (entry.failed || !entry.pipeline.valid() || !PipelineCompiler::isReady(entry.pipeline))
+        return false;
+
+    // Finished, so get never blocks. Bad description or shader only takes its own draws out
+    try
+    {
+        entry.pipeline.get();
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Pipeline compile failed, its draws are skipped: " << e.what() << std::endl;
+        entry.failed = true;
+        return false;
+    }
+    return true;
+}
+
+void PipelineRegistry::reload(const std::string& shader)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (auto& entry : entries)
+    {
+        if (!entry.pipeline.valid())
+            continue;
+        if (entry.description.vertexShader != shader && entry.description.fragmentShader != shader)
+            continue;
+
+        // Saved again quickly. Older replacement is already outdated
+        destroyPipeline(entry.reloaded);
+        entry.reloaded = compiler->compile(entry.description);
+    }
+}
+
+bool PipelineRegistry::hasReloadsReady()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (auto& entry : entries)
+    {
+        if (entry.reloaded.valid() && PipelineCompiler::isReady(entry.reloaded))
+            return true;
+    }
+    return false;
+}
+
+void PipelineRegistry::applyReloads()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (auto& entry : entries)
+    {
+        if (!entry.reloaded.valid() || !PipelineCompiler::isReady(entry.reloaded))
+            continue;
+
+        try
+        {
+            entry.reloaded.get();
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Pipeline reload failed, keeping old pipeline: " << e.what() << std::endl;
+            entry.reloaded = {};
+            continue;
+        }
+
+        destroyPipeline(entry.pipeline);
+        entry.pipeline = std::move(entry.reloaded);
+        entry.reloaded = {};
+        entry.failed = false;
+    }
+}
+
+void PipelineRegistry::destroyPipeline(std::shared_future<vk::Pipeline>& pipeline)
+{
+    if (!pipeline.valid())
+        return;
+
+    // Failed compiles have nothing to destroy
+    try
+    {
+        device.destroyPipeline(pipeline.get());
+    }
+    catch (const std::exception&)
+    {
+    }
+}
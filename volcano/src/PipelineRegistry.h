@@ -0,0 +1,73 @@
+#pragma once
+
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include "PipelineCompiler.h"
+#include "PipelineDescription.h"
+
+// Index of pipeline in registry. Stays valid until registry is destroyed
+using PipelineId = uint32_t;
+
+// Hands out one pipeline per distinct description. Repeat requests return id of existing pipeline,
+// so meshes sharing a material share its pipeline and it is compiled once
+class PipelineRegistry
+{
+public:
+    void init(const vk::Device& device, PipelineCompiler& compiler);
+    // Waits for pending compiles and destroys every pipeline
+    void destroy();
+
+    // Starts compile of new descriptions. Never blocks
+    PipelineId request(const PipelineDescription& description);
+
+    // False while compiling and for failed compiles. A failure is logged once, when it is first seen
+    bool isReady(PipelineId id);
+    // Compile threw. Stays failed until a shader reload or rebuild of pipeline succeeds
+    bool hasFailed(PipelineId id);
+    // Only valid once ready
+    vk::Pipeline get(PipelineId id);
+    PipelineDescription getDescription(PipelineId id);
+
+    // Recompile every pipeline of old render pass for new one (e.g. swapchain format changed). Ids are kept
+    // New render pass has to be a new object, so moved descriptions never equal ones already there
+    // Gpu must not be using old pipelines anymore
+    void rebuild(const vk::RenderPass& oldRenderPass, const vk::RenderPass& newRenderPass);
+    // Destroy every pipeline of render pass, e.g. of a render context going away. Their ids are never ready again
+    // Gpu must not be using them anymore
+    void retire(const vk::RenderPass& renderPass);
+
+    // Start recompile of every pipeline using shader file. Old pipelines stay in use until applyReloads
+    // Interface of shader (bindings, vertex inputs) must not change
+    void reload(const std::string& shader);
+    bool hasReloadsReady();
+    // Swap in finished reloads. Failed ones keep old pipeline
+    // Gpu must not be using old pipelines anymore
+    void applyReloads();
+
+private:
+    struct Entry
+    {
+        PipelineDescription description;
+        std::shared_future<vk::Pipeline> pipeline;
+        std::shared_future<vk::Pipeline> reloaded;          // Replacement still compiling
+        bool failed = false;                                // Compile of pipeline threw, nothing to draw with
+    };
+
+    vk::Device device;
+    PipelineCompiler* compiler = nullptr;
+
+    std::vector<Entry> entries;
+    // Ids by description hash. More than one only on hash collision
+    std::unordered_map<uint64_t, std::vector<PipelineId>> lookup;
+    std::mutex mutex;                       // Requests may come from any thread
+private:
+    void destroyPipeline(std::shared_future<vk::Pipeline>& pipeline);
+    // Caller holds mutex
+    void removeLookup(PipelineId id);
+    // Ready and not failed. Logs failure once. Caller holds mutex
+    bool checkReady(Entry& entry);
+};
@@ -0,0 +1,114 @@
+#include "volcanoPCH.h"
+#include "PngWriter.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+    const std::array<uint32_t, 256> crcTable = []() {
+        std::array<uint32_t, 256> table = {};
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+        return table;
+    }();
+
+    uint32_t crc32(uint32_t crc, const uint8_t* data, size_t size)
+    {
+        for (size_t i = 0; i < size; ++i)
+            crc = crcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        return crc;
+    }
+
+    void putBigEndian(std::vector<uint8_t>& out, uint32_t value)
+    {
+        out.push_back(static_cast<uint8_t>(value >> 24));
+        out.push_back(static_cast<uint8_t>(value >> 16));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    // Length, type, data and crc of type and data
+    void putChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data)
+    {
+        putBigEndian(out, static_cast<uint32_t>(data.size()));
+
+        size_t typeStart = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data.begin(), data.end());
+
+        uint32_t crc = crc32(0xFFFFFFFFu, out.data() + typeStart, out.size() - typeStart);
+        putBigEndian(out, crc ^ 0xFFFFFFFFu);
+    }
+}
+
+namespace png
+{
+    bool write(const char* filename, uint32_t width, uint32_t height, const uint8_t* pixels, uint32_t rowPitch)
+    {
+        // Every row starts with filter type (0 = none)
+        size_t rowSize = static_cast<size_t>(width) * 4;
+        std::vector<uint8_t> raw;
+        raw.reserve((rowSize + 1) * height);
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            const uint8_t* row = pixels + static_cast<size_t>(y) * rowPitch;
+            raw.push_back(0);
+            raw.insert(raw.end(), row, row + rowSize);
+        }
+
+        // Zlib stream of stored deflate blocks (at most 65535 bytes each) and adler32 of raw data
+        std::vector<uint8_t> zlib = { 0x78, 0x01 };
+        zlib.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+        size_t offset = 0;
+        do
+        {
+            uint16_t length = static_cast<uint16_t>(std::min<size_t>(raw.size() - offset, 65535));
+            bool last = offset + length == raw.size();
+
+            zlib.push_back(last ? 1 : 0);
+            zlib.push_back(static_cast<uint8_t>(length));
+            zlib.push_back(static_cast<uint8_t>(length >> 8));
+            zlib.push_back(static_cast<uint8_t>(~length));
+            zlib.push_back(static_cast<uint8_t>(~length >> 8));
+            zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + length);
+            offset += length;
+        } while (offset < raw.size());
+
+        uint32_t a = 1, b = 0;
+        for (uint8_t byte : raw)
+        {
+            a = (a + byte) % 65521;
+            b = (b + a) % 65521;
+        }
+        putBigEndian(zlib, (b << 16) | a);
+
+        std::vector<uint8_t> header;
+        putBigEndian(header, width);
+        putBigEndian(header, height);
+        header.push_back(8);                        // Bits per channel
+        header.push_back(6);                        // Rgba
+        header.push_back(0);                        // Deflate
+        header.push_back(0);                        // Adaptive filtering
+        header.push_back(0);                        // Not interlaced
+
+        std::vector<uint8_t> file = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        putChunk(file, "IHDR", header);
+        putChunk(file, "IDAT", zlib);
+        putChunk(file, "IEND", {});
+
+        std::ofstream stream(filename, std::ios::binary);
+        if (!stream)
+            return false;
+
+        stream.write(reinterpret_cast<const char*>(file.data()), file.size());
+        return static_cast<bool>(stream);
+    }
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+
+// Minimal PNG encoder for read back frames. Deflate blocks are stored, not compressed,
+// so files are big but writing costs little more than a copy
+namespace png
+{
+    // 8 bit rgba rows, rowPitch bytes apart. Returns false if file can't be written
+    bool write(const char* filename, uint32_t width, uint32_t height, const uint8_t* pixels, uint32_t rowPitch);
+}
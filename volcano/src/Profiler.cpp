@@ -0,0 +1,198 @@
+#include "volcanoPCH.h"
+#include "Profiler.h"
+
+#ifdef VOLCANO_PROFILE
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Zones kept per thread. Older ones are overwritten
+#define PROFILE_RING_SIZE 16384
+
+namespace
+{
+    struct Zone
+    {
+        const char* name;
+        uint64_t start;                                 // Nanoseconds since profiler start
+        uint64_t duration;
+    };
+
+    // Zone in ring. Sequence tells dump which zone slot holds and whether it changed while being copied
+    struct Slot
+    {
+        std::atomic<uint64_t> sequence{ 0 };            // Index of zone plus one. 0 while zone is written
+        std::atomic<const char*> name;
+        std::atomic<uint64_t> start;
+        std::atomic<uint64_t> duration;
+    };
+
+    // Written by owning thread only. Dump reads it while thread keeps writing
+    struct ThreadRing
+    {
+        uint32_t threadId = 0;
+        std::array<Slot, PROFILE_RING_SIZE> slots;
+        std::atomic<uint64_t> written{ 0 };             // Zones ever written. Next one goes to written % size
+    };
+
+    struct Registry
+    {
+        std::mutex mutex;                               // Only taken on first zone of thread and in dump
+        // Rings outlive their threads, so zones of finished workers are still dumped
+        std::vector<std::shared_ptr<ThreadRing>> rings;
+        std::string exitFilename;
+    };
+
+    Registry& getRegistry()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+    uint64_t now()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+    }
+
+    ThreadRing& getThreadRing()
+    {
+        thread_local std::shared_ptr<ThreadRing> ring;
+        if (!ring)
+        {
+            ring = std::make_shared<ThreadRing>();
+
+            Registry& registry = getRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            ring->threadId = static_cast<uint32_t>(registry.rings.size());
+            registry.rings.push_back(ring);
+        }
+        return *ring;
+    }
+
+    // Names are literals in code, but may still hold quotes or backslashes
+    void writeJsonString(std::ostream& stream, const char* text)
+    {
+        stream << '"';
+        for (const char* c = text; *c; ++c)
+        {
+            if (*c == '"' || *c == '\\')
+                stream << '\\' << *c;
+            else if (static_cast<unsigned char>(*c) < 0x20)
+                stream << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(*c) << std::dec << std::setfill(' ');
+            else
+                stream << *c;
+        }
+        stream << '"';
+    }
+
+    void dumpAtExit()
+    {
+        profiler::dump(getRegistry().exitFilename.c_str());
+    }
+}
+
+namespace profiler
+{
+    Scope::Scope(const char* name)
+        : name(name), start(now())
+    {
+    }
+
+    Scope::~Scope()
+    {
+        ThreadRing& ring = getThreadRing();
+
+        // Only this thread writes, so plain load is enough
+        uint64_t index = ring.written.load(std::memory_order_relaxed);
+        uint64_t duration = now() - start;
+
+        // Slot is marked as being written first, so dump never takes half of old and half of new zone
+        Slot& slot = ring.slots[index % PROFILE_RING_SIZE];
+        slot.sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.start.store(start, std::memory_order_relaxed);
+        slot.duration.store(duration, std::memory_order_relaxed);
+        slot.sequence.store(index + 1, std::memory_order_release);
+        ring.written.store(index + 1, std::memory_order_release);
+    }
+
+    bool dump(const char* filename)
+    {
+        std::vector<std::shared_ptr<ThreadRing>> rings;
+        {
+            Registry& registry = getRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            rings = registry.rings;
+        }
+
+        std::ofstream stream(filename);
+        if (!stream)
+            return false;
+
+        // Complete events ("X"). Times are in microseconds
+        stream << std::fixed << std::setprecision(3);
+        stream << "{\"traceEvents\":[\n";
+        bool first = true;
+        for (const auto& ring : rings)
+        {
+            uint64_t end = ring->written.load(std::memory_order_acquire);
+            uint64_t begin = end > PROFILE_RING_SIZE ? end - PROFILE_RING_SIZE : 0;
+
+            std::vector<Zone> zones;
+            zones.reserve(static_cast<size_t>(end - begin));
+            for (uint64_t i = begin; i < end; ++i)
+            {
+                // Zones thread overwrote (or is overwriting) while they were copied are dropped
+                const Slot& slot = ring->slots[i % PROFILE_RING_SIZE];
+                if (slot.sequence.load(std::memory_order_acquire) != i + 1)
+                    continue;
+                Zone zone = { slot.name.load(std::memory_order_relaxed), slot.start.load(std::memory_order_relaxed),
+                    slot.duration.load(std::memory_order_relaxed) };
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.sequence.load(std::memory_order_relaxed) != i + 1)
+                    continue;
+                zones.push_back(zone);
+            }
+
+            for (const Zone& zone : zones)
+            {
+                stream << (first ? "" : ",\n") << "{\"name\":";
+                writeJsonString(stream, zone.name);
+                stream << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->threadId
+                    << ",\"ts\":" << zone.start / 1000.0 << ",\"dur\":" << zone.duration / 1000.0 << "}";
+                first = false;
+            }
+        }
+        stream << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+        return static_cast<bool>(stream);
+    }
+
+    void dumpOnExit(const char* filename)
+    {
+        // Registry has to exist before handler is registered, so it is destroyed only after handler ran
+        Registry& registry = getRegistry();
+        {
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            bool registered = !registry.exitFilename.empty();
+            registry.exitFilename = filename;
+            if (registered)
+                return;
+        }
+
+        std::atexit(dumpAtExit);
+    }
+}
+
+#endif
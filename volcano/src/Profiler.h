@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+
+// Scoped cpu zones, e.g. VOLCANO_PROFILE_SCOPE("draw") at top of a function
+// Only built with VOLCANO_PROFILE (premake --profile, on in Debug). Otherwise zones and dumps compile to nothing
+#ifdef VOLCANO_PROFILE
+
+#define VOLCANO_PROFILE_CONCAT_INNER(a, b) a##b
+#define VOLCANO_PROFILE_CONCAT(a, b) VOLCANO_PROFILE_CONCAT_INNER(a, b)
+// Name must be a string literal. Only the pointer is kept, and it is read again at dump (possibly at exit)
+#define VOLCANO_PROFILE_SCOPE(name) profiler::Scope VOLCANO_PROFILE_CONCAT(profileScope, __LINE__)(name)
+
+namespace profiler
+{
+    // Zones go into ring buffer of calling thread. No locks, no allocation after first zone of thread
+    // Oldest zones are overwritten once ring is full
+    class Scope
+    {
+    public:
+        explicit Scope(const char* name);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        const char* name;
+        uint64_t start;
+    };
+
+    // Write zones of every thread as Chrome trace JSON (about:tracing, Perfetto). Threads keep recording meanwhile;
+    // zones overwritten while dump copies them are left out, every zone written is complete
+    bool dump(const char* filename);
+    // Dump once process exits
+    void dumpOnExit(const char* filename);
+}
+
+#else
+
+#define VOLCANO_PROFILE_SCOPE(name)
+
+namespace profiler
+{
+    inline bool dump(const char*) { return false; }
+    inline void dumpOnExit(const char*) {}
+}
+
+#endif
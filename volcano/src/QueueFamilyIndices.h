@@ -7,6 +7,8 @@ struct QueueFamilyIndicies
 {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
+    // Transfer only family if device has one, otherwise same as graphics family
+    std::optional<uint32_t> transferFamily;
 
     bool isComplete();
 };
@@ -0,0 +1,772 @@
+#include "volcanoPCH.h"
+#include "RenderDevice.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <GLFW/glfw3.h>
+#include <iostream>
+#include <limits>
+#include <set>
+#include "utils.h"
+#include "vertex.h"
+
+namespace
+{
+    // Header every pipeline cache starts with (header version one). Spelled out since bundled headers predate VkPipelineCacheHeaderVersionOne
+    struct PipelineCacheHeader
+    {
+        uint32_t headerSize;
+        uint32_t headerVersion;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    };
+}
+
+#ifdef VOLCANO_SHADER_HOT_RELOAD
+namespace
+{
+    // Watched sources and SPIR-V they compile to. Same pairs as compile_shaders.sh
+    const std::pair<const char*, const char*> hotReloadShaders[] = {
+        { "shader.vs.glsl", VERTEX_SHADER_FILE },
+        { "shader.fs.glsl", FRAGMENT_SHADER_FILE }
+    };
+}
+#endif
+
+void RenderDevice::init(bool presentation)
+{
+    this->presentation = presentation;
+    initStart = std::chrono::steady_clock::now();
+    startupReported = false;
+
+    createInstance();
+    pickPhysicalDevice();
+    createLogicalDevice();
+    allocator.init(physicalDevice, device.get());
+    layoutCache.init(device.get());
+    createPipelineCache();
+    threadPool.init();
+    recordThreadPool.init();
+    pipelineCompiler.init(device.get(), pipelineCache, threadPool);
+    pipelineRegistry.init(device.get(), pipelineCompiler);
+#ifdef VOLCANO_SHADER_HOT_RELOAD
+    // Sources in repo, not copies next to executable, are the ones being edited
+    if (shaderWatcher.init(VOLCANO_SHADER_SOURCE_DIR))
+        std::cout << "Watching " << VOLCANO_SHADER_SOURCE_DIR << " for shader changes" << std::endl;
+    else
+        std::cerr << "Failed to watch " << VOLCANO_SHADER_SOURCE_DIR << ", shader hot reload is off" << std::endl;
+#endif
+    uploadContext.init(device.get(), queueFamilies.transferFamily.value(), transferQueue,
+        queueFamilies.graphicsFamily.value(), graphicsQueue);
+    createStagingBuffer();
+    createGeometryArena();
+}
+
+void RenderDevice::reportStartup()
+{
+    if (startupReported)
+        return;
+    startupReported = true;
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - initStart);
+    std::cout << "Startup: default pipeline ready " << elapsed.count() << " ms after init (pipeline cache "
+        << (pipelineCacheWarm ? "warm" : "cold") << ")" << std::endl;
+}
+
+void RenderDevice::destroy()
+{
+    device->waitIdle();
+
+#ifdef VOLCANO_SHADER_HOT_RELOAD
+    shaderWatcher.destroy();
+    // glslc runs finish on their own. Nothing to reload anymore
+    for (auto& compile : shaderCompiles)
+        compile.wait();
+    shaderCompiles.clear();
+#endif
+    // Waits for jobs still compiling, so they end up in saved cache
+    pipelineRegistry.destroy();
+    // Descriptor set and pipeline layouts
+    layoutCache.destroy();
+    savePipelineCache();
+    threadPool.destroy();
+    recordThreadPool.destroy();
+    uploadContext.destroy();
+
+    allocator.unmap(stagingBufferMemory);
+    destroyBuffer(stagingBuffer, stagingBufferMemory);
+
+    // Meshes of contexts released their ranges already
+    destroyBuffer(vertexArenaBuffer, vertexArenaMemory);
+    destroyBuffer(indexArenaBuffer, indexArenaMemory);
+    allocator.destroy();
+
+#ifdef DEBUG
+    destroyDebugUtilMessengerEXT(instance, callback, nullptr);
+#endif
+    device.reset();
+    instance.reset();
+}
+
+void RenderDevice::update()
+{
+    // Reuse staging data of every upload batch that has finished
+    stagingRing.release(uploadContext.getCompletedTicket());
+
+#ifdef VOLCANO_SHADER_HOT_RELOAD
+    reloadChangedShaders();
+#endif
+}
+
+void RenderDevice::createInstance()
+{
+    // Init vulkan instance
+    {
+#ifdef DEBUG
+        if(!checkValidationLayerSupport())
+            throw std::runtime_error("Vaildation layer not found");
+#endif
+        vk::ApplicationInfo appInfo;
+        appInfo.pApplicationName = "volcano";
+        appInfo.pEngineName = "Volcano";
+        appInfo.apiVersion = VK_API_VERSION_1_2;
+        
+        vk::InstanceCreateInfo instanceInfo;
+        instanceInfo.pApplicationInfo = &appInfo;
+    
+        auto extensions = getRequiredExtensions();
+
+        instanceInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+        instanceInfo.ppEnabledExtensionNames = extensions.data();
+
+#ifdef DEBUG
+        instanceInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
+        instanceInfo.ppEnabledLayerNames = validationLayers.data();
+#else
+        instanceInfo.enabledLayerCount = 0;
+#endif
+
+        try
+        {
+            instance = vk::createInstanceUnique(instanceInfo, nullptr);
+        } 
+        catch(vk::SystemError& e)
+        {
+            UNUSED(e);
+            throw std::runtime_error("Failed to create instance");
+        }
+    }
+
+#ifdef DEBUG
+    {   
+        // Setup debug messenger
+        auto createInfo = vk::DebugUtilsMessengerCreateInfoEXT(
+                vk::DebugUtilsMessengerCreateFlagsEXT(),
+                vk::DebugUtilsMessageSeverityFlagBitsEXT::eVerbose | vk::DebugUtilsMessageSeverityFlagBitsEXT::eWarning | vk::DebugUtilsMessageSeverityFlagBitsEXT::eError,
+                vk::DebugUtilsMessageTypeFlagBitsEXT::eGeneral | vk::DebugUtilsMessageTypeFlagBitsEXT::eValidation | vk::DebugUtilsMessageTypeFlagBitsEXT::ePerformance,
+                &RenderDevice::debugCallback, 
+                nullptr
+        );
+        
+        if (createDebugUtilsMessengerEXT(instance, reinterpret_cast<const VkDebugUtilsMessengerCreateInfoEXT*>(&createInfo), nullptr, &callback) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create debug callback");
+    }
+#endif
+}
+
+void RenderDevice::pickPhysicalDevice()
+{
+    auto devices = instance->enumeratePhysicalDevices();
+    if(devices.size() == 0)
+        throw std::runtime_error("Failed to find suitable GPU");
+
+    for(const auto& device : devices)
+    {
+        if(isDeviceSuitable(device))
+        {
+            physicalDevice = device;
+            break;
+        }
+    }
+
+    //vk::PhysicalDeviceProperties deviceProperties = physicalDevice.getProperties();
+    //minBufferOffset = deviceProperties.limits.minUniformBufferOffsetAlignment;
+
+    if(!physicalDevice)
+        throw std::runtime_error("Failed to find suitable GPU");
+}
+
+bool RenderDevice::isDeviceSuitable(const vk::PhysicalDevice& physicalDevice)
+{
+    vk::PhysicalDeviceFeatures deviceFeatures = physicalDevice.getFeatures();
+
+    auto indices = findQueueFamily(physicalDevice);
+
+    bool extensionSupport = checkDeviceExtensionsSupport(physicalDevice);
+
+    // Surfaces are made later by contexts. Formats and present modes are checked against them there
+    return indices.isComplete() && extensionSupport && deviceFeatures.samplerAnisotropy;
+}
+
+QueueFamilyIndicies RenderDevice::findQueueFamily(const vk::PhysicalDevice& physicalDevice)
+{
+    QueueFamilyIndicies indices;
+
+    auto queueFamilies = physicalDevice.getQueueFamilyProperties();
+
+    // Score of transfer family found so far. Lower is more dedicated to transfers
+    int transferScore = std::numeric_limits<int>::max();
+
+    uint32_t i = 0;
+    for(const auto& queueFamily: queueFamilies)
+    {
+        if (queueFamily.queueCount == 0)
+        {
+            ++i;
+            continue;
+        }
+
+        if (!indices.graphicsFamily.has_value() && queueFamily.queueFlags & vk::QueueFlagBits::eGraphics)
+            indices.graphicsFamily = i;
+
+        // No surface exists yet. Glfw knows whether family can present to its windows
+        if (!indices.presentFamily.has_value() && presentation && glfwGetPhysicalDevicePresentationSupport(instance.get(), physicalDevice, i))
+            indices.presentFamily = i;
+
+        // Transfer only family (usually backed by dma engine) runs copies alongside rendering
+        if (!(queueFamily.queueFlags & vk::QueueFlagBits::eGraphics) && 
+            (queueFamily.queueFlags & (vk::QueueFlagBits::eTransfer | vk::QueueFlagBits::eCompute)))
+        {
+            int score = (queueFamily.queueFlags & vk::QueueFlagBits::eCompute) ? 1 : 0;
+            if (score < transferScore)
+            {
+                indices.transferFamily = i;
+                transferScore = score;
+            }
+        }
+
+        ++i;
+    }
+
+    // Fall back to graphics queue for uploads
+    if (!indices.transferFamily.has_value())
+        indices.transferFamily = indices.graphicsFamily;
+
+    // Nothing is presented without presentation. Present queue is just graphics queue
+    if (!presentation)
+        indices.presentFamily = indices.graphicsFamily;
+
+    return indices;
+}
+
+std::vector<const char*> RenderDevice::getRequiredExtensions()
+{
+    // Surface extensions only. Glfw is not even initialized without presentation
+    std::vector<const char*> extensions;
+    if (presentation)
+    {
+        uint32_t glfwExtensionCount = 0;
+        const char** glfwExtensions;
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
+
+#ifdef DEBUG
+    extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+#endif
+
+    return extensions;
+}
+
+void RenderDevice::createLogicalDevice()
+{
+    auto indices = findQueueFamily(physicalDevice);
+    queueFamilies = indices;
+
+    std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos;
+    std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value(), indices.transferFamily.value() };
+    
+    float queuePriority = 1.0f;
+
+    for(uint32_t queueFamily : uniqueQueueFamilies)
+    {
+        auto queueCreateInfo = vk::DeviceQueueCreateInfo(
+            vk::DeviceQueueCreateFlags(),
+            queueFamily,
+            1,
+            &queuePriority
+        );
+
+        queueCreateInfos.push_back(queueCreateInfo);
+    }
+
+    auto supportedFeatures = physicalDevice.getFeatures();
+
+    auto deviceFeature = vk::PhysicalDeviceFeatures();
+    deviceFeature.samplerAnisotropy = VK_TRUE;                      // enable anisotropy feature
+
+    // Whole scene in one indirect draw needs multiple draws per call and per draw first instance (selects model matrix)
+    multiDrawIndirect = supportedFeatures.multiDrawIndirect && supportedFeatures.drawIndirectFirstInstance;
+    deviceFeature.multiDrawIndirect = multiDrawIndirect;
+    deviceFeature.drawIndirectFirstInstance = multiDrawIndirect;
+    maxDrawIndirectCount = multiDrawIndirect ? physicalDevice.getProperties().limits.maxDrawIndirectCount : 1;
+
+    auto createInfo = vk::DeviceCreateInfo(
+        vk::DeviceCreateFlags(),
+        static_cast<uint32_t>(queueCreateInfos.size()),
+        queueCreateInfos.data()
+    );
+    createInfo.pEnabledFeatures = &deviceFeature;
+    const auto& extensions = getDeviceExtensions();
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
+
+#ifdef DEBUG
+    createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
+    createInfo.ppEnabledLayerNames = validationLayers.data();
+#endif
+
+    try
+    {
+        device = physicalDevice.createDeviceUnique(createInfo);
+    }
+    catch(vk::SystemError& e)
+    {
+        UNUSED(e);
+        throw std::runtime_error("Failed to create logical device");
+    }
+
+    graphicsQueue = device->getQueue(indices.graphicsFamily.value(), 0);
+    presentQueue = device->getQueue(indices.presentFamily.value(), 0);
+    transferQueue = device->getQueue(indices.transferFamily.value(), 0);
+}
+
+const std::vector<const char*>& RenderDevice::getDeviceExtensions()
+{
+    return presentation ? deviceExtensions : headlessDeviceExtensions;
+}
+
+bool RenderDevice::checkDeviceExtensionsSupport(const vk::PhysicalDevice& physicalDevice)
+{
+    const auto& extensions = getDeviceExtensions();
+    std::set<std::string> requiredExtensions(extensions.begin(), extensions.end());
+
+    for (const auto& extension : physicalDevice.enumerateDeviceExtensionProperties())
+        requiredExtensions.erase(extension.extensionName);
+
+    return requiredExtensions.empty();
+}
+
+vk::ImageView RenderDevice::createImageView(const vk::Image& image, const vk::Format& format, const vk::ImageAspectFlags aspectFlag)
+{
+    vk::ImageViewCreateInfo viewCreateInfo = {};
+    viewCreateInfo.image = image;                                   // Image to create view for
+    viewCreateInfo.viewType = vk::ImageViewType::e2D;               // Type of image
+    viewCreateInfo.format = format;                                 // Format of image data
+    viewCreateInfo.components.r = vk::ComponentSwizzle::eIdentity;  // Allows remaping of rgba components  
+    viewCreateInfo.components.g = vk::ComponentSwizzle::eIdentity;    
+    viewCreateInfo.components.b = vk::ComponentSwizzle::eIdentity;    
+    viewCreateInfo.components.a = vk::ComponentSwizzle::eIdentity;    
+    
+    // Subresources allow the view to view only part of image
+    viewCreateInfo.subresourceRange.aspectMask = aspectFlag;
+    viewCreateInfo.subresourceRange.baseMipLevel = 0;               // Start mipmap level
+    viewCreateInfo.subresourceRange.levelCount = 1;                 // No of mipmap layers
+    viewCreateInfo.subresourceRange.baseArrayLayer = 0;             // Start array level to view from
+    viewCreateInfo.subresourceRange.layerCount = 1;                 // No of array layers
+
+    try 
+    {
+        return device->createImageView(viewCreateInfo);
+    }
+    catch(vk::SystemError& e)
+    {
+        UNUSED(e);
+        throw std::runtime_error("Failed to create image view");
+    }
+}
+
+vk::Image RenderDevice::createImage(uint32_t width, uint32_t height, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags useFlags, vk::MemoryPropertyFlags propFlags, MemoryAllocation& imageMemory)
+{
+    // Create image
+    vk::ImageCreateInfo imageCreateInfo = {};
+    imageCreateInfo.imageType = vk::ImageType::e2D;
+    imageCreateInfo.extent.width = width;
+    imageCreateInfo.extent.height = height;
+    imageCreateInfo.extent.depth = 1;
+    imageCreateInfo.mipLevels = 1;
+    imageCreateInfo.arrayLayers = 1;                    // No of levels in image array
+    imageCreateInfo.format = format;
+    imageCreateInfo.tiling = tiling;
+    imageCreateInfo.initialLayout = vk::ImageLayout::eUndefined;
+    imageCreateInfo.usage = useFlags;
+    imageCreateInfo.samples = vk::SampleCountFlagBits::e1;
+    imageCreateInfo.sharingMode = vk::SharingMode::eExclusive;      // whetter image can be shared between queues
+    
+    vk::Image image;
+
+    try 
+    {
+        image = device->createImage(imageCreateInfo);
+    }
+    catch (vk::SystemError& e)
+    {
+        throw std::runtime_error(e.what());
+    }
+
+    // Sub-allocate memory for image from shared block
+    vk::MemoryRequirements memRequirments = device->getImageMemoryRequirements(image);
+
+    auto kind = tiling == vk::ImageTiling::eOptimal ? MemoryAllocator::ResourceKind::Optimal : MemoryAllocator::ResourceKind::Linear;
+    imageMemory = allocator.allocate(memRequirments, propFlags, kind);
+
+    device->bindImageMemory(image, imageMemory.memory, imageMemory.offset);
+
+    return image;
+}
+
+vk::Format RenderDevice::chooseSupportedFormat(const std::vector<vk::Format>& formats, const vk::ImageTiling& tiling, const vk::FormatFeatureFlags& featureFlags)
+{
+    for (const vk::Format& format: formats) 
+    {
+        vk::FormatProperties properties = physicalDevice.getFormatProperties(format);
+
+        if (tiling == vk::ImageTiling::eLinear && (properties.linearTilingFeatures & featureFlags) == featureFlags)
+        {
+            return format;
+        }
+        else if (tiling == vk::ImageTiling::eOptimal && (properties.optimalTilingFeatures & featureFlags) == featureFlags)
+        {
+            return format;
+        }
+    }
+
+    throw std::runtime_error("Failed to find matching format");
+}
+
+#ifdef VOLCANO_SHADER_HOT_RELOAD
+void RenderDevice::reloadChangedShaders()
+{
+    // 1. Recompile edited sources off main thread into temporary file. Pipelines are built from the SPIR-V on workers,
+    // so it is only replaced (renamed over, atomic) once glslc finished and never read half written
+    for (const std::string& name : shaderWatcher.poll())
+    {
+        for (const auto& [source, output] : hotReloadShaders)
+        {
+            if (name != source)
+                continue;
+
+            std::string spirv = output;
+            // Own temporary file per compile, as source may be saved again before previous glslc finished
+            std::string temporary = spirv + "." + std::to_string(++shaderCompileCount) + ".tmp";
+            std::string command = std::string("glslc -c \"") + VOLCANO_SHADER_SOURCE_DIR + "/" + source + "\" -o " + temporary;
+            shaderCompiles.push_back(threadPool.submit([command, spirv, temporary]() {
+                // Compile errors are printed by glslc itself
+                std::error_code error;
+                if (std::system(command.c_str()) != 0)
+                {
+                    std::filesystem::remove(temporary, error);
+                    return std::string();
+                }
+                // Replaces existing file on every platform, unlike std::rename on Windows
+                std::filesystem::rename(temporary, spirv, error);
+                if (error)
+                {
+                    std::cerr << "Failed to replace " << spirv << ": " << error.message() << std::endl;
+                    std::filesystem::remove(temporary, error);
+                    return std::string();
+                }
+                return spirv;
+            }));
+        }
+    }
+
+    // 2. Rebuild pipelines using shaders that compiled. Old ones keep drawing meanwhile
+    for (auto it = shaderCompiles.begin(); it != shaderCompiles.end(); )
+    {
+        if (it->wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            ++it;
+            continue;
+        }
+
+        std::string spirv = it->get();
+        if (spirv.empty())
+            std::cerr << "Shader compile failed, keeping old pipelines" << std::endl;
+        else
+        {
+            std::cout << "Reloading pipelines using " << spirv << std::endl;
+            pipelineRegistry.reload(spirv);
+        }
+        it = shaderCompiles.erase(it);
+    }
+
+    // 3. Swap finished pipelines. Meshes, textures and descriptors stay as they are
+    if (pipelineRegistry.hasReloadsReady())
+    {
+        // Development only, so simply let frames in flight finish before old pipelines go
+        device->waitIdle();
+        pipelineRegistry.applyReloads();
+        // Recorded draws of every context hold old pipeline handles
+        ++pipelineGeneration;
+    }
+}
+#endif
+
+void RenderDevice::createPipelineCache()
+{
+    std::vector<char> cacheData;
+    try
+    {
+        cacheData = utils::readFile(PIPELINE_CACHE_FILE);
+    }
+    catch(const std::exception&)
+    {
+        // No cache saved yet
+    }
+
+    // Cache from other driver or gpu is useless (and may be rejected), so header has to match this device
+    vk::PhysicalDeviceProperties properties = physicalDevice.getProperties();
+    pipelineCacheWarm = false;
+    if (cacheData.size() >= sizeof(PipelineCacheHeader))
+    {
+        PipelineCacheHeader header;
+        memcpy(&header, cacheData.data(), sizeof(header));
+
+        pipelineCacheWarm = header.headerSize >= sizeof(header) &&
+            header.headerVersion == static_cast<uint32_t>(VK_PIPELINE_CACHE_HEADER_VERSION_ONE) &&
+            header.vendorID == properties.vendorID &&
+            header.deviceID == properties.deviceID &&
+            memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID.data(), VK_UUID_SIZE) == 0;
+    }
+
+    // Compile times logged by pipeline compiler depend on this
+    std::cout << "Pipeline cache: " << (pipelineCacheWarm ? "warm" : "cold") << std::endl;
+
+    vk::PipelineCacheCreateInfo cacheInfo = {};
+    if (pipelineCacheWarm)
+    {
+        cacheInfo.initialDataSize = cacheData.size();
+        cacheInfo.pInitialData = cacheData.data();
+    }
+
+    try
+    {
+        pipelineCache = device->createPipelineCache(cacheInfo);
+    }
+    catch(vk::SystemError& e)
+    {
+        UNUSED(e);
+        throw std::runtime_error("Failed to create pipeline cache");
+    }
+}
+
+void RenderDevice::savePipelineCache()
+{
+    // Written back every run so it also holds pipelines created after init (e.g. on resize)
+    try
+    {
+        std::vector<uint8_t> cacheData = device->getPipelineCacheData(pipelineCache);
+        utils::writeFile(PIPELINE_CACHE_FILE, cacheData.data(), cacheData.size());
+    }
+    catch(const std::exception& e)
+    {
+        // Losing cache only costs startup time next run
+        std::cerr << "Failed to save pipeline cache: " << e.what() << std::endl;
+    }
+
+    device->destroyPipelineCache(pipelineCache);
+}
+
+void RenderDevice::createStagingBuffer()
+{
+    createBuffer(StagingRing::DEFAULT_SIZE, vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+        stagingBuffer, stagingBufferMemory);
+
+    // Mapped once for whole lifetime of device
+    void* mapped = allocator.map(stagingBufferMemory);
+    stagingRing.init(stagingBuffer, mapped, StagingRing::DEFAULT_SIZE);
+
+    // Image copies need offsets aligned to texel size and work best at optimal alignment
+    vk::DeviceSize copyAlignment = physicalDevice.getProperties().limits.optimalBufferCopyOffsetAlignment;
+    stagingAlignment = std::max<vk::DeviceSize>(stagingAlignment, copyAlignment);
+}
+
+StagingAllocation RenderDevice::stageData(const void* data, vk::DeviceSize size)
+{
+    StagingAllocation allocation;
+
+    if (!stagingRing.allocate(size, stagingAlignment, allocation))
+    {
+        if (size > stagingRing.getCapacity())
+            throw std::runtime_error("Upload does not fit in staging buffer");
+
+        // Ring is full. Submit what is recorded and wait till gpu is done reading from ring
+        // Ring may be held by batches submitted earlier even when nothing is recorded, so wait for all of them
+        flushUploads();
+        uint64_t ticket = uploadContext.getCurrentTicket() - 1;
+        uploadContext.wait(ticket);
+        stagingRing.release(ticket);
+
+        if (!stagingRing.allocate(size, stagingAlignment, allocation))
+            throw std::runtime_error("Failed to allocate staging memory");
+    }
+
+    memcpy(allocation.data, data, static_cast<size_t>(size));
+    return allocation;
+}
+
+uint64_t RenderDevice::flushUploads()
+{
+    uint64_t ticket = uploadContext.flush();
+
+    // Staging data of submitted batch can be reused when its ticket completes
+    stagingRing.retire(ticket);
+
+    return ticket;
+}
+
+void RenderDevice::createGeometryArena()
+{
+    // Every mesh upload writes a range of arenas from transfer queue while graphics queue keeps reading them
+    createBuffer(sizeof(Vertex) * GeometryArena::DEFAULT_VERTEX_CAPACITY,
+        vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer,
+        vk::MemoryPropertyFlagBits::eDeviceLocal, vertexArenaBuffer, vertexArenaMemory, true);
+
+    createBuffer(sizeof(uint32_t) * GeometryArena::DEFAULT_INDEX_CAPACITY,
+        vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer,
+        vk::MemoryPropertyFlagBits::eDeviceLocal, indexArenaBuffer, indexArenaMemory, true);
+
+    geometryArena.init(vertexArenaBuffer, GeometryArena::DEFAULT_VERTEX_CAPACITY,
+        indexArenaBuffer, GeometryArena::DEFAULT_INDEX_CAPACITY);
+}
+
+void RenderDevice::createBuffer(vk::DeviceSize bufferSize, vk::BufferUsageFlags bufferUsageFlags, 
+                vk::MemoryPropertyFlags bufferProperties, vk::Buffer& buffer, MemoryAllocation& bufferMemory, bool sharedWithTransfer)
+{
+    vk::BufferCreateInfo bufferInfo = {};
+    bufferInfo.size = bufferSize;
+    bufferInfo.usage = bufferUsageFlags;
+
+    // Concurrent buffers need no ownership transfer, so ranges can be written after graphics queue used the buffer
+    uint32_t queueFamilyIndicies[] = { queueFamilies.graphicsFamily.value(), queueFamilies.transferFamily.value() };
+    if (sharedWithTransfer && queueFamilies.graphicsFamily != queueFamilies.transferFamily)
+    {
+        bufferInfo.sharingMode = vk::SharingMode::eConcurrent;
+        bufferInfo.queueFamilyIndexCount = 2;
+        bufferInfo.pQueueFamilyIndices = queueFamilyIndicies;
+    }
+    else
+    {
+        bufferInfo.sharingMode = vk::SharingMode::eExclusive;
+    }
+
+    try 
+    {
+        buffer = device->createBuffer(bufferInfo);
+    }
+    catch(vk::SystemError& e)
+    {
+        UNUSED(e);
+        throw std::runtime_error("Failed to create vertex buffer");
+    }
+
+    vk::MemoryRequirements memRequirements = {};
+    memRequirements = device->getBufferMemoryRequirements(buffer);
+
+    // Host visible bit -> cpu can interact
+    // Conherant bit -> allows placement of data straight into buffer after mapping 
+    // Memory is sub-allocated from a shared block of matching memory type
+    bufferMemory = allocator.allocate(memRequirements, bufferProperties, MemoryAllocator::ResourceKind::Linear);
+
+    // Allocate mem to vertex buffer
+    device->bindBufferMemory(buffer, bufferMemory.memory, bufferMemory.offset);
+}
+
+void RenderDevice::destroyBuffer(vk::Buffer& buffer, MemoryAllocation& bufferMemory)
+{
+    device->destroyBuffer(buffer);
+    allocator.free(bufferMemory);
+    buffer = nullptr;
+}
+
+void RenderDevice::copyBuffer(vk::Buffer& src, vk::Buffer& dst, vk::DeviceSize bufferSize, vk::DeviceSize srcOffset, vk::DeviceSize dstOffset)
+{
+    // Copy is recorded into current upload batch and submitted with it
+    vk::CommandBuffer transferCommandBuffer = uploadContext.getCommandBuffer();
+
+    {
+        // Region of data to copy from into
+        vk::BufferCopy bufferCopyRegion = {};
+        bufferCopyRegion.srcOffset = srcOffset;
+        bufferCopyRegion.dstOffset = dstOffset;
+        bufferCopyRegion.size = bufferSize;
+
+        transferCommandBuffer.copyBuffer(src, dst, bufferCopyRegion);
+    }
+
+    // Written range can be read as any kind of buffer on graphics queue after batch finished
+    // Only arenas are copied into, and they are shared with transfer family, so no ownership changes hands
+    uploadContext.makeBufferVisible(dst,
+        vk::PipelineStageFlagBits::eVertexInput | vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader,
+        vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead | vk::AccessFlagBits::eUniformRead | vk::AccessFlagBits::eShaderRead,
+        dstOffset, bufferSize);
+}
+
+#ifdef DEBUG
+bool RenderDevice::checkValidationLayerSupport()
+{
+    auto availableLayers = vk::enumerateInstanceLayerProperties();
+    
+    for(const char* layerName: validationLayers)
+    {
+        bool layerFound = false;
+        for(const auto& layerProperties : availableLayers)
+        {
+            if(strcmp(layerName, layerProperties.layerName) == 0)
+            {
+                layerFound = true;
+                break;
+            }
+        }
+
+        if (!layerFound)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+VkBool32 RenderDevice::debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType,
+        const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData)
+{
+    std::cerr << "Validation layer: " << pCallbackData->pMessage << std::endl;
+    return VK_FALSE;
+}
+
+VkResult RenderDevice::createDebugUtilsMessengerEXT(vk::UniqueInstance& instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo,
+                const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pCallback)
+{
+    auto func = (PFN_vkCreateDebugUtilsMessengerEXT) vkGetInstanceProcAddr(instance.get(), "vkCreateDebugUtilsMessengerEXT");
+
+    if(func != nullptr)
+        return func(instance.get(), pCreateInfo, pAllocator, pCallback);
+    else
+        return VK_ERROR_EXTENSION_NOT_PRESENT;
+}
+
+void RenderDevice::destroyDebugUtilMessengerEXT(vk::UniqueInstance& instance, VkDebugUtilsMessengerEXT debugMessenger, const VkAllocationCallbacks* pAllocator)
+{
+    auto func = (PFN_vkDestroyDebugUtilsMessengerEXT) vkGetInstanceProcAddr(instance.get(), "vkDestroyDebugUtilsMessengerEXT");
+    if (func != nullptr)
+        func(instance.get(), debugMessenger, pAllocator);
+}
+#endif
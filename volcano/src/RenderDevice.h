@@ -0,0 +1,179 @@
+#pragma once
+
+#include <chrono>
+#include <future>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include "GeometryArena.h"
+#include "LayoutCache.h"
+#include "MemoryAllocator.h"
+#include "PipelineCompiler.h"
+#include "PipelineRegistry.h"
+#include "QueueFamilyIndices.h"
+#include "ShaderWatcher.h"
+#include "StagingRing.h"
+#include "ThreadPool.h"
+#include "UploadContext.h"
+
+// Pipeline cache is loaded from and saved to this file in working directory
+#define PIPELINE_CACHE_FILE "pipeline_cache.bin"
+// Shaders of default pipeline. Descriptor layout and vertex input are reflected from them
+// Also names in embedded shader registry (ShaderRegistry.cpp)
+#define VERTEX_SHADER_FILE "shaders/vert.spv"
+#define FRAGMENT_SHADER_FILE "shaders/frag.spv"
+
+// Instance, device and everything render contexts (Volcano) share: queues, memory, uploads, geometry arena,
+// pipelines and worker threads. Created once per process. Contexts using it come and go without re-init
+// Contexts sharing a device have to be used from one thread
+class RenderDevice
+{
+public:
+    // With presentation device has to be able to present to glfw windows (glfw has to be initialized)
+    // Without it no window system is needed at all, e.g. for headless contexts on CI
+    void init(bool presentation = true);
+    // Every context using device has to be destroyed already
+    void destroy();
+
+    // Once per frame of any context. Frees staging space of finished uploads and swaps reloaded shaders
+    void update();
+    // Default pipeline of a context can draw. First call logs time since init next to pipeline cache state,
+    // so cold and warm startups can be compared
+    void reportStartup();
+
+    inline bool supportsPresentation() const { return presentation; }
+    inline vk::Instance getInstance() const { return instance.get(); }
+    inline vk::PhysicalDevice getPhysicalDevice() const { return physicalDevice; }
+    inline vk::Device getDevice() const { return device.get(); }
+    inline const QueueFamilyIndicies& getQueueFamilies() const { return queueFamilies; }
+    inline vk::Queue getGraphicsQueue() const { return graphicsQueue; }
+    inline vk::Queue getPresentQueue() const { return presentQueue; }
+
+    inline bool supportsMultiDrawIndirect() const { return multiDrawIndirect; }
+    inline uint32_t getMaxDrawIndirectCount() const { return maxDrawIndirectCount; }
+
+    inline MemoryAllocator& getAllocator() { return allocator; }
+    inline ThreadPool& getThreadPool() { return threadPool; }
+    inline ThreadPool& getRecordThreadPool() { return recordThreadPool; }
+    inline LayoutCache& getLayoutCache() { return layoutCache; }
+    inline PipelineRegistry& getPipelineRegistry() { return pipelineRegistry; }
+    inline GeometryArena& getGeometryArena() { return geometryArena; }
+    inline UploadContext& getUploadContext() { return uploadContext; }
+    // Changes whenever pipelines were replaced under their ids. Recorded draws using them are stale then
+    inline uint64_t getPipelineGeneration() const { return pipelineGeneration; }
+
+    // Buffers that get uploads over and over (partial ranges) are shared with transfer family instead of changing owner every batch
+    void createBuffer(vk::DeviceSize bufferSize, vk::BufferUsageFlags bufferUsageFlags, vk::MemoryPropertyFlags bufferProperties,
+        vk::Buffer& buffer, MemoryAllocation& bufferMemory, bool sharedWithTransfer = false);
+    void destroyBuffer(vk::Buffer& buffer, MemoryAllocation& bufferMemory);
+    void copyBuffer(vk::Buffer& src, vk::Buffer& dst, vk::DeviceSize bufferSize, vk::DeviceSize srcOffset = 0, vk::DeviceSize dstOffset = 0);
+    vk::Image createImage(uint32_t width, uint32_t height, vk::Format format, vk::ImageTiling tiling,
+        vk::ImageUsageFlags useFlags, vk::MemoryPropertyFlags propFlags, MemoryAllocation& imageMemory);
+    vk::ImageView createImageView(const vk::Image& image, const vk::Format& format, const vk::ImageAspectFlags aspectFlag);
+    vk::Format chooseSupportedFormat(const std::vector<vk::Format>& formats, const vk::ImageTiling& tiling, const vk::FormatFeatureFlags& featureFlags);
+
+    // Copy data to staging ring. Valid until upload batch recording the copy is finished
+    StagingAllocation stageData(const void* data, vk::DeviceSize size);
+    // Submit pending uploads. Returned ticket can be polled or waited on
+    uint64_t flushUploads();
+    inline uint64_t getUploadTicket() const { return uploadContext.getCurrentTicket(); }
+    inline bool isUploadComplete(uint64_t ticket) { return uploadContext.isComplete(ticket); }
+    inline void waitForUpload(uint64_t ticket) { uploadContext.wait(ticket); }
+private:
+    bool presentation = true;
+
+    // UniqueInstance destruction is done automatically
+    vk::UniqueInstance instance;
+    // GPU device
+    vk::PhysicalDevice physicalDevice;
+    // Logical device
+    vk::UniqueDevice device;
+    QueueFamilyIndicies queueFamilies;
+    // Sub-allocates buffer and image memory from shared blocks
+    MemoryAllocator allocator;
+
+    vk::Queue graphicsQueue;
+    vk::Queue presentQueue;
+    vk::Queue transferQueue;
+
+    // List of device extensions
+    inline static const std::vector<const char*> deviceExtensions = {
+        VK_KHR_SWAPCHAIN_EXTENSION_NAME         // Swap chain extensions (macro)
+    };
+    // Nothing is presented without presentation
+    inline static const std::vector<const char*> headlessDeviceExtensions = {};
+
+    bool multiDrawIndirect = false;
+    uint32_t maxDrawIndirectCount = 1;
+
+    // Shared by every pipeline creation. Persisted across runs
+    vk::PipelineCache pipelineCache;
+    bool pipelineCacheWarm = false;
+    std::chrono::steady_clock::time_point initStart;
+    bool startupReported = false;
+    // Worker threads for background work: pipeline compiles, glslc runs, png encoding
+    ThreadPool threadPool;
+    // Worker threads for parallel command recording only. Frame waits for them, so they never queue behind background work
+    ThreadPool recordThreadPool;
+    // Builds pipelines on thread pool against pipeline cache
+    PipelineCompiler pipelineCompiler;
+    // Every pipeline meshes are drawn with, deduplicated by description
+    PipelineRegistry pipelineRegistry;
+    uint64_t pipelineGeneration = 0;
+    // Owns every descriptor set and pipeline layout
+    LayoutCache layoutCache;
+
+    // Persistently mapped buffer every upload is staged through
+    StagingRing stagingRing;
+    vk::Buffer stagingBuffer;
+    MemoryAllocation stagingBufferMemory;
+    vk::DeviceSize stagingAlignment = 16;
+    // Batches copies and layout transitions into as few submissions as possible
+    UploadContext uploadContext;
+
+    // Shared vertex and index buffers of all meshes
+    GeometryArena geometryArena;
+    vk::Buffer vertexArenaBuffer;
+    MemoryAllocation vertexArenaMemory;
+    vk::Buffer indexArenaBuffer;
+    MemoryAllocation indexArenaMemory;
+
+#ifdef VOLCANO_SHADER_HOT_RELOAD
+    ShaderWatcher shaderWatcher;
+    // glslc runs in flight. Each returns SPIR-V file it wrote, empty on failure
+    std::vector<std::future<std::string>> shaderCompiles;
+    uint32_t shaderCompileCount = 0;                // Makes temporary SPIR-V file of each compile unique
+#endif
+
+// Validation layer only exist for debug build
+#ifdef DEBUG
+    inline static std::vector<const char*> validationLayers = {
+        "VK_LAYER_KHRONOS_validation"
+    };
+    VkDebugUtilsMessengerEXT callback;
+#endif
+private:
+    void createInstance();
+    void pickPhysicalDevice();
+    bool isDeviceSuitable(const vk::PhysicalDevice& device);
+    QueueFamilyIndicies findQueueFamily(const vk::PhysicalDevice& device);
+    std::vector<const char*> getRequiredExtensions();
+    const std::vector<const char*>& getDeviceExtensions();
+    bool checkDeviceExtensionsSupport(const vk::PhysicalDevice& physicalDevice);
+    void createLogicalDevice();
+    void createPipelineCache();
+    void savePipelineCache();
+    void createStagingBuffer();
+    void createGeometryArena();
+#ifdef VOLCANO_SHADER_HOT_RELOAD
+    void reloadChangedShaders();
+#endif
+#ifdef DEBUG
+    bool checkValidationLayerSupport();
+    static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType,
+            const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData);
+    static VkResult createDebugUtilsMessengerEXT(vk::UniqueInstance& instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo,
+            const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pCallback);
+    static void destroyDebugUtilMessengerEXT(vk::UniqueInstance& instance, VkDebugUtilsMessengerEXT debugMessenger, const VkAllocationCallbacks* pAllocator);
+#endif
+};
@@ -0,0 +1,436 @@
+#include "volcanoPCH.h"
+#include "ShaderReflection.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace
+{
+    // Parts of SPIR-V spec needed here
+    constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+    constexpr uint32_t SPIRV_HEADER_WORDS = 5;
+
+    enum Op : uint32_t
+    {
+        OpEntryPoint = 15,
+        OpTypeInt = 21,
+        OpTypeFloat = 22,
+        OpTypeVector = 23,
+        OpTypeMatrix = 24,
+        OpTypeImage = 25,
+        OpTypeSampler = 26,
+        OpTypeSampledImage = 27,
+        OpTypeArray = 28,
+        OpTypeRuntimeArray = 29,
+        OpTypeStruct = 30,
+        OpTypePointer = 32,
+        OpConstant = 43,
+        OpFunction = 54,
+        OpFunctionEnd = 56,
+        OpVariable = 59,
+        OpDecorate = 71,
+        OpMemberDecorate = 72
+    };
+
+    enum Decoration : uint32_t
+    {
+        DecorationBlock = 2,
+        DecorationBufferBlock = 3,
+        DecorationArrayStride = 6,
+        DecorationMatrixStride = 7,
+        DecorationBuiltIn = 11,
+        DecorationLocation = 30,
+        DecorationBinding = 33,
+        DecorationDescriptorSet = 34,
+        DecorationOffset = 35
+    };
+
+    enum StorageClass : uint32_t
+    {
+        StorageUniformConstant = 0,
+        StorageInput = 1,
+        StorageUniform = 2,
+        StoragePushConstant = 9,
+        StorageStorageBuffer = 12
+    };
+
+    constexpr uint32_t DIM_BUFFER = 5;
+    constexpr uint32_t DIM_SUBPASS_DATA = 6;
+
+    // Type, constant or variable with its decorations
+    struct Object
+    {
+        uint32_t op = 0;
+        std::vector<uint32_t> operands;                                     // Words after result id (variables: type, storage class)
+        std::map<uint32_t, uint32_t> decorations;                           // Decoration -> first literal
+        std::map<uint32_t, std::map<uint32_t, uint32_t>> memberDecorations; // Member -> decoration -> first literal
+    };
+
+    using Objects = std::unordered_map<uint32_t, Object>;
+
+    const Object& getObject(const Objects& objects, uint32_t id)
+    {
+        auto it = objects.find(id);
+        if (it == objects.end())
+            throw std::runtime_error("SPIR-V references unknown id");
+        return it->second;
+    }
+
+    bool hasDecoration(const Object& object, uint32_t decoration)
+    {
+        return object.decorations.count(decoration) > 0;
+    }
+
+    // Size in bytes as laid out in buffer (explicit offsets and strides are part of SPIR-V)
+    uint32_t getTypeSize(const Objects& objects, uint32_t typeId, uint32_t matrixStride = 0)
+    {
+        const Object& type = getObject(objects, typeId);
+        switch (type.op)
+        {
+        case OpTypeInt:
+        case OpTypeFloat:
+            return type.operands[0] / 8;
+        case OpTypeVector:
+            return type.operands[1] * getTypeSize(objects, type.operands[0]);
+        case OpTypeMatrix:
+            return type.operands[1] * (matrixStride > 0 ? matrixStride : getTypeSize(objects, type.operands[0]));
+        case OpTypeArray:
+        {
+            uint32_t length = getObject(objects, type.operands[1]).operands[1];
+            auto stride = type.decorations.find(DecorationArrayStride);
+            return length * (stride != type.decorations.end() ? stride->second : getTypeSize(objects, type.operands[0]));
+        }
+        case OpTypeStruct:
+        {
+            uint32_t size = 0;
+            for (uint32_t member = 0; member < type.operands.size(); ++member)
+            {
+                auto decorations = type.memberDecorations.find(member);
+                uint32_t offset = 0, memberMatrixStride = 0;
+                if (decorations != type.memberDecorations.end())
+                {
+                    auto it = decorations->second.find(DecorationOffset);
+                    if (it != decorations->second.end())
+                        offset = it->second;
+                    it = decorations->second.find(DecorationMatrixStride);
+                    if (it != decorations->second.end())
+                        memberMatrixStride = it->second;
+                }
+                size = std::max(size, offset + getTypeSize(objects, type.operands[member], memberMatrixStride));
+            }
+            return size;
+        }
+        default:
+            // Runtime arrays have no static size
+            return 0;
+        }
+    }
+
+    vk::DescriptorType getDescriptorType(const Object& type, uint32_t storageClass)
+    {
+        if (storageClass == StorageStorageBuffer)
+            return vk::DescriptorType::eStorageBuffer;
+
+        if (storageClass == StorageUniform)
+            return hasDecoration(type, DecorationBufferBlock) ? vk::DescriptorType::eStorageBuffer : vk::DescriptorType::eUniformBuffer;
+
+        switch (type.op)
+        {
+        case OpTypeSampler:
+            return vk::DescriptorType::eSampler;
+        case OpTypeSampledImage:
+            return vk::DescriptorType::eCombinedImageSampler;
+        case OpTypeImage:
+        {
+            uint32_t dim = type.operands[1];
+            uint32_t sampled = type.operands[5];                            // 1 sampled, 2 storage
+            if (dim == DIM_SUBPASS_DATA)
+                return vk::DescriptorType::eInputAttachment;
+            if (dim == DIM_BUFFER)
+                return sampled == 2 ? vk::DescriptorType::eStorageTexelBuffer : vk::DescriptorType::eUniformTexelBuffer;
+            return sampled == 2 ? vk::DescriptorType::eStorageImage : vk::DescriptorType::eSampledImage;
+        }
+        default:
+            throw std::runtime_error("Unsupported shader resource type");
+        }
+    }
+
+    vk::Format getVertexFormat(const Objects& objects, uint32_t typeId, uint32_t& size)
+    {
+        const Object& type = getObject(objects, typeId);
+        uint32_t componentCount = 1;
+        const Object* component = &type;
+        if (type.op == OpTypeVector)
+        {
+            component = &getObject(objects, type.operands[0]);
+            componentCount = type.operands[1];
+        }
+
+        if ((component->op != OpTypeFloat && component->op != OpTypeInt) || component->operands[0] != 32)
+            throw std::runtime_error("Unsupported vertex shader input type");
+
+        size = componentCount * 4;
+
+        static const vk::Format floatFormats[] = { vk::Format::eR32Sfloat, vk::Format::eR32G32Sfloat, vk::Format::eR32G32B32Sfloat, vk::Format::eR32G32B32A32Sfloat };
+        static const vk::Format intFormats[] = { vk::Format::eR32Sint, vk::Format::eR32G32Sint, vk::Format::eR32G32B32Sint, vk::Format::eR32G32B32A32Sint };
+        static const vk::Format uintFormats[] = { vk::Format::eR32Uint, vk::Format::eR32G32Uint, vk::Format::eR32G32B32Uint, vk::Format::eR32G32B32A32Uint };
+
+        if (component->op == OpTypeFloat)
+            return floatFormats[componentCount - 1];
+        return component->operands[1] ? intFormats[componentCount - 1] : uintFormats[componentCount - 1];
+    }
+
+    vk::ShaderStageFlags getStage(uint32_t executionModel)
+    {
+        static const vk::ShaderStageFlagBits stages[] = {
+            vk::ShaderStageFlagBits::eVertex,
+            vk::ShaderStageFlagBits::eTessellationControl,
+            vk::ShaderStageFlagBits::eTessellationEvaluation,
+            vk::ShaderStageFlagBits::eGeometry,
+            vk::ShaderStageFlagBits::eFragment,
+            vk::ShaderStageFlagBits::eCompute
+        };
+
+        if (executionModel >= sizeof(stages) / sizeof(stages[0]))
+            throw std::runtime_error("Unsupported shader stage");
+        return stages[executionModel];
+    }
+}
+
+ShaderReflection ShaderReflection::fromSpirv(const std::vector<char>& code)
+{
+    if (code.size() % 4 != 0 || code.size() < SPIRV_HEADER_WORDS * 4)
+        throw std::runtime_error("Shader code is not SPIR-V");
+
+    std::vector<uint32_t> words(code.size() / 4);
+    memcpy(words.data(), code.data(), code.size());
+    if (words[0] != SPIRV_MAGIC)
+        throw std::runtime_error("Shader code is not SPIR-V");
+
+    Objects objects;
+    std::vector<uint32_t> variables;
+    std::set<uint32_t> usedIds;                 // Anything referenced from function bodies
+    bool inFunction = false;
+    bool hasEntryPoint = false;
+    ShaderReflection reflection;
+
+    for (size_t i = SPIRV_HEADER_WORDS; i < words.size(); )
+    {
+        uint32_t op = words[i] & 0xffff;
+        uint32_t wordCount = words[i] >> 16;
+        if (wordCount == 0 || i + wordCount > words.size())
+            throw std::runtime_error("Malformed SPIR-V");
+
+        const uint32_t* operands = &words[i + 1];
+        uint32_t operandCount = wordCount - 1;
+
+        switch (op)
+        {
+        case OpEntryPoint:
+            // First entry point only. Volcano's shaders have one
+            if (!hasEntryPoint)
+                reflection.stages = getStage(operands[0]);
+            hasEntryPoint = true;
+            break;
+        case OpTypeInt:
+        case OpTypeFloat:
+        case OpTypeVector:
+        case OpTypeMatrix:
+        case OpTypeImage:
+        case OpTypeSampler:
+        case OpTypeSampledImage:
+        case OpTypeArray:
+        case OpTypeRuntimeArray:
+        case OpTypeStruct:
+        case OpTypePointer:
+        {
+            Object& object = objects[operands[0]];
+            object.op = op;
+            object.operands.assign(operands + 1, operands + operandCount);
+            break;
+        }
+        case OpConstant:
+        case OpVariable:
+        {
+            // Result type comes before result id
+            Object& object = objects[operands[1]];
+            object.op = op;
+            object.operands.assign(operands + 2, operands + operandCount);
+            object.operands.insert(object.operands.begin(), operands[0]);
+            if (op == OpVariable)
+                variables.push_back(operands[1]);
+            break;
+        }
+        case OpDecorate:
+            objects[operands[0]].decorations[operands[1]] = operandCount > 2 ? operands[2] : 0;
+            break;
+        case OpMemberDecorate:
+            objects[operands[0]].memberDecorations[operands[1]][operands[2]] = operandCount > 3 ? operands[3] : 0;
+            break;
+        case OpFunction:
+            inFunction = true;
+            break;
+        case OpFunctionEnd:
+            inFunction = false;
+            break;
+        default:
+            // Literals are counted too. Worst case an unused resource is kept
+            if (inFunction)
+                usedIds.insert(operands, operands + operandCount);
+            break;
+        }
+
+        i += wordCount;
+    }
+
+    if (!hasEntryPoint)
+        throw std::runtime_error("SPIR-V has no entry point");
+
+    struct Input { uint32_t location; vk::Format format; uint32_t size; };
+    std::vector<Input> inputs;
+
+    for (uint32_t id : variables)
+    {
+        const Object& variable = objects[id];
+        uint32_t storageClass = variable.operands[1];
+        bool used = usedIds.count(id) > 0;
+
+        const Object& pointer = getObject(objects, variable.operands[0]);
+        uint32_t typeId = pointer.operands[1];
+        const Object* type = &getObject(objects, typeId);
+
+        switch (storageClass)
+        {
+        case StorageUniformConstant:
+        case StorageUniform:
+        case StorageStorageBuffer:
+        {
+            // Declared but never accessed. No descriptor needed
+            if (!used)
+                break;
+
+            ReflectedBinding binding;
+            binding.set = hasDecoration(variable, DecorationDescriptorSet) ? variable.decorations.at(DecorationDescriptorSet) : 0;
+            binding.binding.binding = hasDecoration(variable, DecorationBinding) ? variable.decorations.at(DecorationBinding) : 0;
+            binding.binding.descriptorCount = 1;
+            binding.binding.stageFlags = reflection.stages;
+
+            // Arrays of descriptors
+            if (type->op == OpTypeArray)
+            {
+                binding.binding.descriptorCount = getObject(objects, type->operands[1]).operands[1];
+                type = &getObject(objects, type->operands[0]);
+            }
+            else if (type->op == OpTypeRuntimeArray)
+            {
+                throw std::runtime_error("Runtime descriptor arrays are not supported");
+            }
+
+            binding.binding.descriptorType = getDescriptorType(*type, storageClass);
+            reflection.bindings.push_back(binding);
+            break;
+        }
+        case StoragePushConstant:
+        {
+            if (!used)
+                break;
+
+            // Range starts at first member so stages can share one block at different offsets
+            uint32_t offset = std::numeric_limits<uint32_t>::max();
+            for (const auto& member : type->memberDecorations)
+            {
+                auto it = member.second.find(DecorationOffset);
+                if (it != member.second.end())
+                    offset = std::min(offset, it->second);
+            }
+            if (offset == std::numeric_limits<uint32_t>::max())
+                offset = 0;
+
+            reflection.pushConstantRanges.push_back(vk::PushConstantRange(reflection.stages, offset, getTypeSize(objects, typeId) - offset));
+            break;
+        }
+        case StorageInput:
+        {
+            // Only vertex shader inputs come from vertex buffers. Builtins (e.g. gl_InstanceIndex) don't
+            // Unused inputs are kept, as they still take space in vertex
+            if (reflection.stages != vk::ShaderStageFlags(vk::ShaderStageFlagBits::eVertex) || hasDecoration(variable, DecorationBuiltIn))
+                break;
+
+            Input input;
+            input.location = variable.decorations.at(DecorationLocation);
+            input.format = getVertexFormat(objects, typeId, input.size);
+            inputs.push_back(input);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    // Vertex layout is packed in location order
+    std::sort(inputs.begin(), inputs.end(), [](const Input& a, const Input& b) { return a.location < b.location; });
+    for (const Input& input : inputs)
+    {
+        reflection.vertexAttributes.push_back(vk::VertexInputAttributeDescription(input.location, 0, input.format, reflection.vertexStride));
+        reflection.vertexStride += input.size;
+    }
+
+    return reflection;
+}
+
+void ShaderReflection::merge(const ShaderReflection& other)
+{
+    stages |= other.stages;
+
+    for (const ReflectedBinding& otherBinding : other.bindings)
+    {
+        auto it = std::find_if(bindings.begin(), bindings.end(), [&otherBinding](const ReflectedBinding& binding) {
+            return binding.set == otherBinding.set && binding.binding.binding == otherBinding.binding.binding;
+        });
+
+        if (it == bindings.end())
+        {
+            bindings.push_back(otherBinding);
+            continue;
+        }
+
+        if (it->binding.descriptorType != otherBinding.binding.descriptorType || it->binding.descriptorCount != otherBinding.binding.descriptorCount)
+            throw std::runtime_error("Shader stages disagree on descriptor binding");
+        it->binding.stageFlags |= otherBinding.binding.stageFlags;
+    }
+
+    pushConstantRanges.insert(pushConstantRanges.end(), other.pushConstantRanges.begin(), other.pushConstantRanges.end());
+
+    if (!other.vertexAttributes.empty())
+    {
+        vertexAttributes = other.vertexAttributes;
+        vertexStride = other.vertexStride;
+    }
+}
+
+std::vector<vk::DescriptorSetLayoutBinding> ShaderReflection::getSetBindings(uint32_t set) const
+{
+    std::vector<vk::DescriptorSetLayoutBinding> setBindings;
+    for (const ReflectedBinding& binding : bindings)
+    {
+        if (binding.set == set)
+            setBindings.push_back(binding.binding);
+    }
+
+    std::sort(setBindings.begin(), setBindings.end(), [](const vk::DescriptorSetLayoutBinding& a, const vk::DescriptorSetLayoutBinding& b) {
+        return a.binding < b.binding;
+    });
+    return setBindings;
+}
+
+bool ShaderReflection::hasBinding(uint32_t set, uint32_t binding) const
+{
+    return std::any_of(bindings.begin(), bindings.end(), [set, binding](const ReflectedBinding& reflected) {
+        return reflected.set == set && reflected.binding.binding == binding;
+    });
+}
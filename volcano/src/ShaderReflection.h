@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+// Resource binding of shader
+struct ReflectedBinding
+{
+    uint32_t set = 0;
+    vk::DescriptorSetLayoutBinding binding;
+};
+
+// Interface of SPIR-V module(s) read from the module itself, so layouts built from it can't drift from shaders
+// Only resources the entry point actually uses get a binding
+class ShaderReflection
+{
+public:
+    // Throws if code is not valid SPIR-V
+    static ShaderReflection fromSpirv(const std::vector<char>& code);
+
+    // Combine stages of one pipeline. Bindings used by several stages get all their stage flags
+    void merge(const ShaderReflection& other);
+
+    // Sorted by binding number
+    std::vector<vk::DescriptorSetLayoutBinding> getSetBindings(uint32_t set) const;
+    bool hasBinding(uint32_t set, uint32_t binding) const;
+    inline const std::vector<vk::PushConstantRange>& getPushConstantRanges() const { return pushConstantRanges; }
+
+    // Vertex shader inputs at binding 0, tightly packed in location order
+    inline const std::vector<vk::VertexInputAttributeDescription>& getVertexAttributes() const { return vertexAttributes; }
+    inline uint32_t getVertexStride() const { return vertexStride; }
+
+    inline vk::ShaderStageFlags getStages() const { return stages; }
+private:
+    vk::ShaderStageFlags stages;
+    std::vector<ReflectedBinding> bindings;
+    std::vector<vk::PushConstantRange> pushConstantRanges;
+    std::vector<vk::VertexInputAttributeDescription> vertexAttributes;
+    uint32_t vertexStride = 0;
+};
@@ -0,0 +1,77 @@
+#include "volcanoPCH.h"
+#include "ShaderRegistry.h"
+
+#include <cstring>
+#include "utils.h"
+
+namespace
+{
+#ifdef VOLCANO_EMBED_SHADERS
+    constexpr bool namesEqual(const char* a, const char* b)
+    {
+        while (*a != '\0' && *a == *b)
+        {
+            ++a;
+            ++b;
+        }
+        return *a == *b;
+    }
+
+    // Generated before build with glslc -mfmt=num (comma separated words)
+    constexpr uint32_t vertCode[] = {
+        #include "vert.spv.inc"
+    };
+
+    constexpr uint32_t fragCode[] = {
+        #include "frag.spv.inc"
+    };
+
+    constexpr shaders::EmbeddedShader embeddedShaders[] = {
+        { "shaders/vert.spv", vertCode, sizeof(vertCode) },
+        { "shaders/frag.spv", fragCode, sizeof(fragCode) }
+    };
+
+    constexpr const shaders::EmbeddedShader* findShader(const char* name)
+    {
+        for (const auto& shader : embeddedShaders)
+        {
+            if (namesEqual(shader.name, name))
+                return &shader;
+        }
+        return nullptr;
+    }
+
+    // Broken glslc output fails the build instead of startup
+    static_assert(vertCode[0] == 0x07230203 && fragCode[0] == 0x07230203, "Embedded shader is not SPIR-V");
+#else
+    const shaders::EmbeddedShader* findShader(const char* name)
+    {
+        UNUSED(name);
+        return nullptr;
+    }
+#endif
+}
+
+namespace shaders
+{
+    const EmbeddedShader* findEmbedded(const char* name)
+    {
+        return findShader(name);
+    }
+
+    std::vector<char> load(const char* name)
+    {
+#ifdef VOLCANO_SHADER_HOT_RELOAD
+        // Recompiled files have to win over code embedded at build time
+        return utils::readFile(name);
+#else
+        const EmbeddedShader* shader = findShader(name);
+        if (!shader)
+            return utils::readFile(name);
+
+        std::vector<char> code(shader->size);
+        memcpy(code.data(), shader->code, shader->size);
+        return code;
+#endif
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compiled SPIR-V looked up by file name (e.g. "shaders/vert.spv")
+// Built with --embed-shaders the code is compiled into executable and loading reads no file
+namespace shaders
+{
+    struct EmbeddedShader
+    {
+        const char* name;
+        const uint32_t* code;
+        size_t size;                        // In bytes
+    };
+
+    // nullptr if shader is not embedded (always without --embed-shaders)
+    const EmbeddedShader* findEmbedded(const char* name);
+    // Embedded code if there is any, file otherwise. Always file with --shader-hot-reload
+    std::vector<char> load(const char* name);
+}
@@ -0,0 +1,84 @@
+#include "volcanoPCH.h"
+#include "ShaderWatcher.h"
+
+#include <algorithm>
+
+#ifdef LINUX_BUILD
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#ifdef LINUX_BUILD
+bool ShaderWatcher::init(const char* directory)
+{
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    // Editors either write file in place or write temporary file and rename it over
+    watch = inotify_add_watch(fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (watch < 0)
+    {
+        destroy();
+        return false;
+    }
+
+    return true;
+}
+
+void ShaderWatcher::destroy()
+{
+    if (fd < 0)
+        return;
+
+    // Closing descriptor removes watch too
+    close(fd);
+    fd = -1;
+    watch = -1;
+}
+
+std::vector<std::string> ShaderWatcher::poll()
+{
+    std::vector<std::string> changed;
+    if (fd < 0)
+        return changed;
+
+    // Events are variable size. Buffer aligned for inotify_event
+    alignas(inotify_event) char buffer[4096];
+    for (;;)
+    {
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        if (length <= 0)
+            break;
+
+        for (char* ptr = buffer; ptr < buffer + length; )
+        {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(ptr);
+            if (event->len > 0)
+            {
+                std::string name = event->name;
+                if (std::find(changed.begin(), changed.end(), name) == changed.end())
+                    changed.push_back(name);
+            }
+            ptr += sizeof(inotify_event) + event->len;
+        }
+    }
+
+    return changed;
+}
+#else
+bool ShaderWatcher::init(const char* directory)
+{
+    UNUSED(directory);
+    return false;
+}
+
+void ShaderWatcher::destroy()
+{
+}
+
+std::vector<std::string> ShaderWatcher::poll()
+{
+    return {};
+}
+#endif
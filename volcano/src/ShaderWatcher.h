@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Reports files written in a directory (inotify). Development only, see --shader-hot-reload
+// Never reports anything on platforms without inotify
+class ShaderWatcher
+{
+public:
+    // Returns false if directory can't be watched
+    bool init(const char* directory);
+    void destroy();
+
+    // Names of files changed since last poll, each once. Never blocks
+    std::vector<std::string> poll();
+private:
+    int fd = -1;
+    int watch = -1;
+};
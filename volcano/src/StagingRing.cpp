@@ -0,0 +1,87 @@
+#include "volcanoPCH.h"
+#include "StagingRing.h"
+
+void StagingRing::init(const vk::Buffer& buffer, void* mapped, vk::DeviceSize size)
+{
+    this->buffer = buffer;
+    this->mapped = static_cast<char*>(mapped);
+    this->capacity = size;
+
+    reset();
+}
+
+bool StagingRing::allocate(vk::DeviceSize size, vk::DeviceSize alignment, StagingAllocation& allocation)
+{
+    if (size > capacity)
+        return false;
+
+    // Empty ring can start over from beginning
+    if (used == 0)
+        head = tail = 0;
+    // head caught up with tail -> ring is full
+    else if (head == tail)
+        return false;
+
+    vk::DeviceSize offset = (head + alignment - 1) & ~(alignment - 1);
+    vk::DeviceSize consumed;
+
+    if (head >= tail)
+    {
+        // Free space is [head, capacity) and [0, tail)
+        if (offset + size <= capacity)
+        {
+            consumed = offset + size - head;
+        }
+        else
+        {
+            // Wrap around and waste the end of buffer
+            if (size > tail)
+                return false;
+
+            consumed = capacity - head + size;
+            offset = 0;
+        }
+    }
+    else
+    {
+        // Free space is [head, tail)
+        if (offset + size > tail)
+            return false;
+
+        consumed = offset + size - head;
+    }
+
+    head = offset + size;
+    used += consumed;
+    pending += consumed;
+
+    allocation.buffer = buffer;
+    allocation.offset = offset;
+    allocation.data = mapped + offset;
+
+    return true;
+}
+
+void StagingRing::retire(uint64_t retireValue)
+{
+    if (pending == 0) return;
+
+    regions.push_back({ retireValue, head, pending });
+    pending = 0;
+}
+
+void StagingRing::release(uint64_t completedValue)
+{
+    while (!regions.empty() && regions.front().retireValue <= completedValue)
+    {
+        tail = regions.front().end;
+        used -= regions.front().size;
+        regions.pop_front();
+    }
+}
+
+void StagingRing::reset()
+{
+    regions.clear();
+    head = tail = used = pending = 0;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <deque>
+#include <vulkan/vulkan.hpp>
+
+// Part of staging ring that upload data was written to
+struct StagingAllocation
+{
+    vk::Buffer buffer;
+    vk::DeviceSize offset = 0;
+    void* data = nullptr;               // Mapped pointer to start of allocation
+};
+
+// Ring allocator over one persistently mapped host visible buffer
+// Allocations are grouped with retire() and reused after release() is called with a completed value
+class StagingRing
+{
+public:
+    static constexpr vk::DeviceSize DEFAULT_SIZE = 64 * 1024 * 1024;
+
+    void init(const vk::Buffer& buffer, void* mapped, vk::DeviceSize size);
+
+    // Returns false when ring has no space left until older regions are released
+    bool allocate(vk::DeviceSize size, vk::DeviceSize alignment, StagingAllocation& allocation);
+
+    // Tag all allocations made since last retire with retireValue
+    void retire(uint64_t retireValue);
+    // Reclaim regions whose retire value is less or equal to completedValue
+    void release(uint64_t completedValue);
+    // Reclaim everything. Only valid when gpu is not reading from ring
+    void reset();
+
+    inline vk::DeviceSize getCapacity() const { return capacity; }
+private:
+    struct Region
+    {
+        uint64_t retireValue;
+        vk::DeviceSize end;             // Head position when region was retired
+        vk::DeviceSize size;            // Bytes (including padding) held by region
+    };
+
+    vk::Buffer buffer;
+    char* mapped = nullptr;
+    vk::DeviceSize capacity = 0;
+
+    vk::DeviceSize head = 0;            // Next free byte
+    vk::DeviceSize tail = 0;            // Oldest byte still in use
+    vk::DeviceSize used = 0;            // Bytes between tail and head
+    vk::DeviceSize pending = 0;         // Bytes allocated since last retire
+
+    std::deque<Region> regions;
+};
@@ -1,9 +1,27 @@
 #pragma once
 
+#include <vector>
 #include <vulkan/vulkan.hpp>
+#include "MemoryAllocator.h"
 
 struct SwapChainImage
 {
     vk::Image image;
     vk::ImageView imageView;
+    MemoryAllocation memory;                    // Only offscreen targets own their image. Swapchain images are owned by swapchain
+};
+
+// Size dependent objects replaced on resize (swapchain is null headless). Frames in flight may still render to them,
+// so they are kept till every frame submitted before retireFrame has finished
+struct RetiredSwapChain
+{
+    vk::SwapchainKHR swapChain;
+    std::vector<SwapChainImage> images;
+    std::vector<vk::Framebuffer> framebuffers;
+
+    vk::Image depthImage;
+    MemoryAllocation depthMemory;
+    vk::ImageView depthImageView;
+
+    uint64_t retireFrame = 0;                   // First frame not using these objects
 };
@@ -0,0 +1,50 @@
+#include "volcanoPCH.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+void ThreadPool::init(uint32_t threadCount)
+{
+    if (threadCount == 0)
+        threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+    stopping = false;
+    for (uint32_t i = 0; i < threadCount; ++i)
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+void ThreadPool::destroy()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+
+    // Workers finish every queued task before exiting
+    for (auto& worker : workers)
+        worker.join();
+
+    workers.clear();
+}
+
+void ThreadPool::workerLoop()
+{
+    while (true)
+    {
+        std::function<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+            if (tasks.empty())
+                return;
+
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+
+        task();
+    }
+}
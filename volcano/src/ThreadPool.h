@@ -0,0 +1,46 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads executing queued tasks
+class ThreadPool
+{
+public:
+    // Thread count of 0 uses one thread per hardware thread except calling one
+    void init(uint32_t threadCount = 0);
+    void destroy();
+
+    template<typename F>
+    auto submit(F&& task) -> std::future<decltype(task())>
+    {
+        using Result = decltype(task());
+
+        auto packagedTask = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        std::future<Result> future = packagedTask->get_future();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.emplace([packagedTask]() { (*packagedTask)(); });
+        }
+        condition.notify_one();
+
+        return future;
+    }
+
+    inline uint32_t getThreadCount() const { return static_cast<uint32_t>(workers.size()); }
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping = false;
+private:
+    void workerLoop();
+};
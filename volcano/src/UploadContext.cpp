@@ -0,0 +1,298 @@
+#include "volcanoPCH.h"
+#include "UploadContext.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+void UploadContext::init(const vk::Device& device, uint32_t transferFamily, const vk::Queue& transferQueue,
+    uint32_t graphicsFamily, const vk::Queue& graphicsQueue)
+{
+    this->device = device;
+    this->transferFamily = transferFamily;
+    this->graphicsFamily = graphicsFamily;
+    this->transferQueue = transferQueue;
+    this->graphicsQueue = graphicsQueue;
+
+    vk::CommandPoolCreateInfo poolInfo = {};
+    poolInfo.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer | vk::CommandPoolCreateFlagBits::eTransient;
+
+    vk::CommandBufferAllocateInfo allocInfo = {};
+    allocInfo.level = vk::CommandBufferLevel::ePrimary;
+    allocInfo.commandBufferCount = BATCH_COUNT;
+
+    try
+    {
+        poolInfo.queueFamilyIndex = transferFamily;
+        transferCommandPool = device.createCommandPool(poolInfo);
+
+        allocInfo.commandPool = transferCommandPool;
+        auto commandBuffers = device.allocateCommandBuffers(allocInfo);
+
+        for (uint32_t i = 0; i < BATCH_COUNT; ++i)
+        {
+            batches[i].commandBuffer = commandBuffers[i];
+            batches[i].fence = device.createFence(vk::FenceCreateInfo());
+        }
+
+        // Ownership has to be acquired by a command buffer of the graphics family
+        if (usesDedicatedQueue())
+        {
+            poolInfo.queueFamilyIndex = graphicsFamily;
+            graphicsCommandPool = device.createCommandPool(poolInfo);
+
+            allocInfo.commandPool = graphicsCommandPool;
+            auto acquireCommandBuffers = device.allocateCommandBuffers(allocInfo);
+
+            for (uint32_t i = 0; i < BATCH_COUNT; ++i)
+            {
+                batches[i].acquireCommandBuffer = acquireCommandBuffers[i];
+                batches[i].transferFinished = device.createSemaphore(vk::SemaphoreCreateInfo());
+            }
+        }
+    }
+    catch (vk::SystemError& e)
+    {
+        UNUSED(e);
+        throw std::runtime_error("Failed to create upload context");
+    }
+}
+
+void UploadContext::destroy()
+{
+    for (auto& batch : batches)
+    {
+        device.destroyFence(batch.fence);
+        device.destroySemaphore(batch.transferFinished);
+    }
+
+    // Command buffers are freed with pool
+    device.destroyCommandPool(transferCommandPool);
+    device.destroyCommandPool(graphicsCommandPool);
+}
+
+vk::CommandBuffer UploadContext::getCommandBuffer()
+{
+    Batch& batch = batches[currentBatch];
+
+    if (!recording)
+    {
+        // Batch is reused only after gpu is done with its previous submission
+        if (batch.submitted)
+        {
+            wait(batch.ticket);
+            device.resetFences(batch.fence);
+            batch.submitted = false;
+        }
+
+        vk::CommandBufferBeginInfo beginInfo = {};
+        beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+
+        batch.commandBuffer.reset(vk::CommandBufferResetFlags());
+        batch.commandBuffer.begin(beginInfo);
+        batch.ticket = nextTicket;
+        recording = true;
+    }
+
+    return batch.commandBuffer;
+}
+
+void UploadContext::makeBufferVisible(const vk::Buffer& buffer, vk::PipelineStageFlags dstStage, vk::AccessFlags dstAccess,
+    vk::DeviceSize offset, vk::DeviceSize size)
+{
+    // Graphics queue waits on semaphore of batch before anything submitted later, which already makes transfer writes visible
+    if (usesDedicatedQueue())
+        return;
+
+    vk::BufferMemoryBarrier bufferBarrier = {};
+    bufferBarrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    bufferBarrier.dstAccessMask = dstAccess;
+    bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.buffer = buffer;
+    bufferBarrier.offset = offset;
+    bufferBarrier.size = size;
+
+    bufferBarriers.push_back(bufferBarrier);
+    dstStages |= dstStage;
+}
+
+void UploadContext::releaseImage(const vk::Image& image, vk::ImageLayout newLayout, vk::PipelineStageFlags dstStage, vk::AccessFlags dstAccess)
+{
+    vk::ImageMemoryBarrier imageBarrier = {};
+    imageBarrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    imageBarrier.dstAccessMask = dstAccess;
+    imageBarrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+    imageBarrier.newLayout = newLayout;
+    imageBarrier.srcQueueFamilyIndex = usesDedicatedQueue() ? transferFamily : VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.dstQueueFamilyIndex = usesDedicatedQueue() ? graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.image = image;
+    imageBarrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+    imageBarrier.subresourceRange.baseMipLevel = 0;
+    imageBarrier.subresourceRange.levelCount = 1;
+    imageBarrier.subresourceRange.baseArrayLayer = 0;
+    imageBarrier.subresourceRange.layerCount = 1;
+
+    imageBarriers.push_back(imageBarrier);
+    dstStages |= dstStage;
+}
+
+uint64_t UploadContext::flush()
+{
+    // Nothing new to submit. Earlier batches may still run, but they are not what caller would wait for
+    if (!recording)
+        return getCompletedTicket();
+
+    Batch& batch = batches[currentBatch];
+    bool hasBarriers = !bufferBarriers.empty() || !imageBarriers.empty();
+
+    try
+    {
+        if (!usesDedicatedQueue())
+        {
+            // Same queue family -> plain barrier makes uploads visible to everything submitted later
+            if (hasBarriers)
+            {
+                batch.commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, dstStages, (vk::DependencyFlags)0,
+                    nullptr, bufferBarriers, imageBarriers);
+            }
+            batch.commandBuffer.end();
+
+            vk::SubmitInfo submitInfo = {};
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &batch.commandBuffer;
+
+            transferQueue.submit(submitInfo, batch.fence);
+        }
+        else
+        {
+            // Only images change owner. Buffers are concurrent, so barriers of this batch are all image barriers
+            if (hasBarriers)
+            {
+                // Release half of ownership transfer. Destination access is ignored on releasing queue
+                auto releaseImageBarriers = imageBarriers;
+                for (auto& barrier : releaseImageBarriers)
+                    barrier.dstAccessMask = vk::AccessFlags();
+
+                batch.commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe,
+                    (vk::DependencyFlags)0, nullptr, nullptr, releaseImageBarriers);
+            }
+            batch.commandBuffer.end();
+
+            // Acquire half. Source access is ignored on acquiring queue
+            vk::CommandBufferBeginInfo beginInfo = {};
+            beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+
+            batch.acquireCommandBuffer.reset(vk::CommandBufferResetFlags());
+            batch.acquireCommandBuffer.begin(beginInfo);
+            if (hasBarriers)
+            {
+                for (auto& barrier : imageBarriers)
+                    barrier.srcAccessMask = vk::AccessFlags();
+
+                batch.acquireCommandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, dstStages, (vk::DependencyFlags)0,
+                    nullptr, nullptr, imageBarriers);
+            }
+            batch.acquireCommandBuffer.end();
+
+            vk::SubmitInfo transferSubmitInfo = {};
+            transferSubmitInfo.commandBufferCount = 1;
+            transferSubmitInfo.pCommandBuffers = &batch.commandBuffer;
+            transferSubmitInfo.signalSemaphoreCount = 1;
+            transferSubmitInfo.pSignalSemaphores = &batch.transferFinished;
+
+            transferQueue.submit(transferSubmitInfo, nullptr);
+
+            // Graphics queue waits only for transfer batch, not for the whole transfer queue
+            vk::PipelineStageFlags waitStage = vk::PipelineStageFlagBits::eAllCommands;
+
+            vk::SubmitInfo acquireSubmitInfo = {};
+            acquireSubmitInfo.waitSemaphoreCount = 1;
+            acquireSubmitInfo.pWaitSemaphores = &batch.transferFinished;
+            acquireSubmitInfo.pWaitDstStageMask = &waitStage;
+            acquireSubmitInfo.commandBufferCount = 1;
+            acquireSubmitInfo.pCommandBuffers = &batch.acquireCommandBuffer;
+
+            graphicsQueue.submit(acquireSubmitInfo, batch.fence);
+        }
+    }
+    catch (vk::SystemError& e)
+    {
+        UNUSED(e);
+        throw std::runtime_error("Failed to submit upload batch");
+    }
+
+    bufferBarriers.clear();
+    imageBarriers.clear();
+    dstStages = vk::PipelineStageFlags();
+
+    batch.submitted = true;
+    recording = false;
+    currentBatch = (currentBatch + 1) % BATCH_COUNT;
+
+    return nextTicket++;
+}
+
+bool UploadContext::isComplete(uint64_t ticket)
+{
+    if (ticket <= completedTicket)
+        return true;
+
+    // Not submitted yet
+    if (ticket >= nextTicket)
+        return false;
+
+    // Batch has been reused, so it was waited on before
+    Batch* batch = findBatch(ticket);
+    if (!batch)
+        return true;
+
+    return device.getFenceStatus(batch->fence) == vk::Result::eSuccess;
+}
+
+void UploadContext::wait(uint64_t ticket)
+{
+    if (recording && ticket >= batches[currentBatch].ticket)
+        flush();
+
+    // Nothing past last submitted batch to wait for
+    ticket = std::min(ticket, nextTicket - 1);
+    if (ticket <= completedTicket)
+        return;
+
+    // Wait for batch of ticket and every batch submitted before it
+    std::vector<vk::Fence> fences;
+    for (auto& batch : batches)
+    {
+        if (batch.submitted && batch.ticket > completedTicket && batch.ticket <= ticket)
+            fences.push_back(batch.fence);
+    }
+
+    if (!fences.empty())
+    {
+        vk::Result result = device.waitForFences(fences, VK_TRUE, std::numeric_limits<uint64_t>::max());
+        if (result != vk::Result::eSuccess)
+            throw std::runtime_error("Failed to wait for upload batch");
+    }
+
+    completedTicket = std::max(completedTicket, ticket);
+}
+
+uint64_t UploadContext::getCompletedTicket()
+{
+    while (completedTicket + 1 < nextTicket && isComplete(completedTicket + 1))
+        ++completedTicket;
+
+    return completedTicket;
+}
+
+UploadContext::Batch* UploadContext::findBatch(uint64_t ticket)
+{
+    for (auto& batch : batches)
+    {
+        if (batch.submitted && batch.ticket == ticket)
+            return &batch;
+    }
+
+    return nullptr;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+// Collects copies and layout transitions into one command buffer and submits them together
+// Every submitted batch is identified by a ticket that can be polled or waited on
+// Commands run on transfer queue. When it belongs to another family than graphics queue,
+// ownership of written images is released on transfer queue and acquired on graphics queue.
+// Buffers are shared concurrently by both families instead, since they are written range by range many times
+class UploadContext
+{
+public:
+    // Number of batches that can be in flight before recording has to wait
+    static constexpr uint32_t BATCH_COUNT = 4;
+
+    void init(const vk::Device& device, uint32_t transferFamily, const vk::Queue& transferQueue,
+        uint32_t graphicsFamily, const vk::Queue& graphicsQueue);
+    void destroy();
+
+    // Command buffer of batch being recorded. Starts new batch if needed
+    vk::CommandBuffer getCommandBuffer();
+    // Ticket that commands recorded right now will be completed with
+    inline uint64_t getCurrentTicket() const { return nextTicket; }
+
+    // Make written buffer range visible to dstStage/dstAccess on graphics queue
+    // Buffer has to be exclusive to graphics family or concurrent over transfer and graphics families
+    void makeBufferVisible(const vk::Buffer& buffer, vk::PipelineStageFlags dstStage, vk::AccessFlags dstAccess,
+        vk::DeviceSize offset = 0, vk::DeviceSize size = VK_WHOLE_SIZE);
+    // Hand written image over to graphics queue and make it visible to dstStage/dstAccess
+    // Image is transitioned from transfer dst layout to newLayout
+    void releaseImage(const vk::Image& image, vk::ImageLayout newLayout, vk::PipelineStageFlags dstStage, vk::AccessFlags dstAccess);
+
+    // Submit recorded commands without waiting. Returns ticket of submitted batch
+    // With nothing recorded, returns getCompletedTicket() instead, which is complete already (0 before first batch)
+    uint64_t flush();
+
+    bool isComplete(uint64_t ticket);
+    // Wait till batch of ticket and all batches before it are finished
+    void wait(uint64_t ticket);
+    // Highest ticket for which all batches up to it have finished
+    uint64_t getCompletedTicket();
+
+    inline bool usesDedicatedQueue() const { return transferFamily != graphicsFamily; }
+private:
+    struct Batch
+    {
+        vk::CommandBuffer commandBuffer;            // Recorded on transfer queue
+        vk::CommandBuffer acquireCommandBuffer;     // Acquires ownership on graphics queue
+        vk::Semaphore transferFinished;
+        vk::Fence fence;
+        uint64_t ticket = 0;
+        bool submitted = false;
+    };
+
+    vk::Device device;
+    uint32_t transferFamily = 0;
+    uint32_t graphicsFamily = 0;
+    vk::Queue transferQueue;
+    vk::Queue graphicsQueue;
+    vk::CommandPool transferCommandPool;
+    vk::CommandPool graphicsCommandPool;
+
+    std::array<Batch, BATCH_COUNT> batches;
+    uint32_t currentBatch = 0;
+    bool recording = false;
+
+    // Barriers recorded at end of batch (or in acquire command buffer)
+    std::vector<vk::BufferMemoryBarrier> bufferBarriers;
+    std::vector<vk::ImageMemoryBarrier> imageBarriers;
+    vk::PipelineStageFlags dstStages;
+
+    uint64_t nextTicket = 1;
+    uint64_t completedTicket = 0;
+private:
+    Batch* findBatch(uint64_t ticket);
+};
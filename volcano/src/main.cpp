@@ -1,47 +1,197 @@
 #include "volcanoPCH.h"
 #include "volcano.h"
 #include "window.h"
+#include "Profiler.h"
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <string>
 
 #include <glm/gtc/matrix_transform.hpp>
 
-int main()
+// Same quad twice. Uploaded once, drawn with two instances (models 0 and 1)
+static void addDemoScene(Volcano& renderer)
 {
-    Window window;
-    Volcano::init(&window);
+    std::vector<Vertex> meshVertex = {
+        {{  1.0f, -1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f, 1.0f }, { 1.0f, 1.0f }},   // 0
+        {{  1.0f,  1.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 1.0f }, { 1.0f, 0.0f }},   // 1
+        {{ -1.0f,  1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f, 1.0f }, { 0.0f, 0.0f }},   // 2
+        {{ -1.0f, -1.0f, 0.0f }, { 1.0f, 1.0f, 0.0f, 1.0f }, { 0.0f, 1.0f }}    // 3
+    };
+    
+    std::vector<uint32_t> meshIndices = {
+        0, 1, 2, 
+        2, 3, 0
+    };
+
+    renderer.addMesh(meshVertex, meshIndices, 2);
+}
+
+static void updateDemoScene(Volcano& renderer, float angle)
+{
+    glm::mat4 model1(1.0f);
+    glm::mat4 model2(1.0f);
+
+    model1 = glm::translate(model1, glm::vec3(0.0f, 0.0f, 0.0f));
+    //model1 = glm::scale();
+    model1 = glm::rotate(model1, glm::radians(angle), glm::vec3(0.0f, 0.0f, 1.0f));
+
+    model2 = glm::translate(model2, glm::vec3(0.0f, 0.0f, -1.0f));
+    model2 = glm::scale(model2, glm::vec3(3.0f, 3.0f, 3.0f));
+    model2 = glm::rotate(model2, glm::radians(-angle * 10), glm::vec3(0.0f, 0.0f, 1.0f));
+    
+    renderer.updateModel(0, model1);
+    renderer.updateModel(1, model2);
+}
+
+// Render jobs back to back on headless contexts sharing one device. Nothing is created per job
+// Every job is a camera orbiting the demo scene. With save prefix each job is written as <prefix>_<job>.png
+static void runBatch(RenderDevice& renderDevice, uint32_t jobCount, const char* savePrefix)
+{
+    // Two contexts, so one records while the other one's frames are still in flight
+    std::array<Volcano, 2> contexts;
+    for (auto& context : contexts)
+    {
+        context.initHeadless(renderDevice, 800, 800);
+        addDemoScene(context);
+    }
+
+    glm::mat4 proj = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 100.0f);
+    proj[1][1] *= -1;
+
+    auto startTime = std::chrono::steady_clock::now();
+    for (uint32_t job = 0; job < jobCount; ++job)
+    {
+        Volcano& context = contexts[job % contexts.size()];
+
+        float orbit = glm::radians(360.0f * job / jobCount);
+        glm::vec3 eye(50.0f * std::sin(orbit), 0.0f, 50.0f * std::cos(orbit));
+        context.setCamera(glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)), proj);
+        updateDemoScene(context, 360.0f * job / jobCount);
+
+        if (savePrefix)
+            context.saveFrame(std::string(savePrefix) + "_" + std::to_string(job) + ".png");
+        context.draw();
+    }
+
+    // Hands out last readbacks
+    for (auto& context : contexts)
+        context.destroy();
+
+    if (jobCount > 0)
+    {
+        float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - startTime).count();
+        std::cout << jobCount << " jobs, " << seconds * 1000.0f / jobCount << " ms per job" << std::endl;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    // --headless renders offscreen with no window or display (e.g. CI). Runs --frames frames and exits
+    // --save writes last frame of headless run as png
+    // --batch renders N camera jobs headless and exits. With --save, every job is written as <save>_<job>.png
+    // --gpu-profile logs gpu time of render pass and its draw groups every 120 frames
+    // --profile writes cpu zones as Chrome trace JSON on exit (builds with VOLCANO_PROFILE only)
+    bool headless = false;
+    bool gpuProfile = false;
+    uint32_t frameLimit = 600;
+    uint32_t batchJobs = 0;
+    const char* savePath = nullptr;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--headless") == 0)
+            headless = true;
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frameLimit = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        else if (strcmp(argv[i], "--save") == 0 && i + 1 < argc)
+            savePath = argv[++i];
+        else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+            batchJobs = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        else if (strcmp(argv[i], "--gpu-profile") == 0)
+            gpuProfile = true;
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+            profiler::dumpOnExit(argv[++i]);
+    }
+
+    RenderDevice renderDevice;
+    if (batchJobs > 0)
+    {
+        renderDevice.init(false);
+        runBatch(renderDevice, batchJobs, savePath);
+        renderDevice.destroy();
+        return 0;
+    }
+
+    // Window first. Device with presentation needs glfw initialized
+    std::unique_ptr<Window> window;
+    Volcano renderer;
+    if (headless)
+    {
+        renderDevice.init(false);
+        renderer.initHeadless(renderDevice, 800, 800);
+    }
+    else
+    {
+        window = std::make_unique<Window>();
+        renderDevice.init(true);
+        renderer.init(renderDevice, window.get());
+    }
+    addDemoScene(renderer);
+    if (gpuProfile)
+    {
+        renderer.setGpuDrawGroupTiming(true);
+        renderer.getGpuProfiler().setLogInterval(120);
+    }
 
     float angle = 0.0f;
     float deltaTime = 0.0f;
-    float lastTime = 0.0f;
+    auto startTime = std::chrono::steady_clock::now();
+    auto lastTime = startTime;
+    uint32_t frameCount = 0;
 
-    while(!window.shouldClose())
+    while(headless ? frameCount < frameLimit : !window->shouldClose())
     {
-        window.pollEvents();
+        if(!headless)
+        {
+            // Nothing is drawn while minimized. Block instead of spinning
+            if(window->isMinimized())
+            {
+                window->waitEvents();
+                continue;
+            }
+            window->pollEvents();
+        }
 
-        float now = static_cast<float>(glfwGetTime());
-        deltaTime = now - lastTime;
+        auto now = std::chrono::steady_clock::now();
+        deltaTime = std::chrono::duration<float>(now - lastTime).count();
         lastTime = now;
 
         angle += 10.0f * deltaTime;
         if(angle > 360) angle -= 360;
 
-        glm::mat4 model1(1.0f);
-        glm::mat4 model2(1.0f);
+        updateDemoScene(renderer, angle);
 
-        model1 = glm::translate(model1, glm::vec3(0.0f, 0.0f, 0.0f));
-        //model1 = glm::scale();
-        model1 = glm::rotate(model1, glm::radians(angle), glm::vec3(0.0f, 0.0f, 1.0f));
+        //Volcano::updateModel(glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0.0f, 0.0f, 1.0f)));
+        if (headless && savePath && frameCount + 1 == frameLimit)
+            renderer.saveFrame(savePath);
 
-        model2 = glm::translate(model2, glm::vec3(0.0f, 0.0f, -1.0f));
-        model2 = glm::scale(model2, glm::vec3(3.0f, 3.0f, 3.0f));
-        model2 = glm::rotate(model2, glm::radians(-angle * 10), glm::vec3(0.0f, 0.0f, 1.0f));
-        
-        Volcano::updateModel(0, model1);
-        Volcano::updateModel(1, model2);
+        renderer.draw();
+        ++frameCount;
+    }
 
-        //Volcano::updateModel(glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0.0f, 0.0f, 1.0f)));
-        Volcano::draw();
+    if(headless && frameCount > 0)
+    {
+        // Cpu side frame time, no compositor or vsync in the way
+        float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - startTime).count();
+        std::cout << frameCount << " frames, " << seconds * 1000.0f / frameCount << " ms per frame" << std::endl;
+        if (renderer.getGpuProfiler().isSupported())
+            std::cout << "GPU render pass " << renderer.getGpuProfiler().getPassStats().averageMs << " ms avg" << std::endl;
     }
 
-    Volcano::destroy();
+    renderer.destroy();
+    renderDevice.destroy();
 }
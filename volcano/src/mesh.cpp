@@ -4,79 +4,63 @@
 #include "iostream"
 #include "volcano.h"
 
-Mesh::Mesh(vk::Device& device, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
-    : device(device), vertexCount(vertices.size()), indexCount(indices.size())
+Mesh::Mesh(Volcano& renderer, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t instanceCount, PipelineId pipeline)
+    : renderer(renderer), renderDevice(renderer.getRenderDevice()), instanceCount(instanceCount), pipeline(pipeline)
 {
-    createVertexBuffer(vertices);
-    createIndexBuffer(indices);
-
-    model.model = glm::mat4(1.0f);
+    if (!renderDevice.getGeometryArena().allocate(static_cast<uint32_t>(vertices.size()), static_cast<uint32_t>(indices.size()), geometry))
+        throw std::runtime_error("Geometry arena is full");
+
+    // Destructor does not run when constructor throws, so whatever was taken so far is given back here
+    bool instancesAllocated = false;
+    try
+    {
+        firstInstance = renderer.allocateInstances(instanceCount);
+        instancesAllocated = true;
+
+        createVertexBuffer(vertices);
+        createIndexBuffer(indices);
+    }
+    catch (...)
+    {
+        if (instancesAllocated)
+            renderer.freeInstances(firstInstance, instanceCount);
+        renderDevice.getGeometryArena().free(geometry);
+        throw;
+    }
+
+    // Copies are in render device's current upload batch
+    uploadTicket = renderDevice.getUploadTicket();
 }
 
 Mesh::~Mesh()
 {
-    device.destroyBuffer(vertexBuffer);
-    device.freeMemory(vertexBufferMemory);
-    device.destroyBuffer(indexBuffer);
-    device.freeMemory(indexBufferMemory);
-}
-
-void Mesh::setModel(const glm::mat4 &model) 
-{
-    this->model.model = model;
+    renderer.freeInstances(firstInstance, instanceCount);
+    renderDevice.getGeometryArena().free(geometry);
 }
 
 void Mesh::createVertexBuffer(std::vector<Vertex>& vertices)
 {
     // get size of buffer
     vk::DeviceSize bufferSize = sizeof(Vertex) * vertices.size();
+    if (bufferSize == 0)
+        return;
  
-    // Temporary buffer to "stage" vertex data before transerfering to gpu
-    vk::Buffer stagingBuffer;
-    vk::DeviceMemory stagingBufferMemory;
-
-    // Create stating buffer and allocate memory
-    Volcano::createBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferSrc, 
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
-        stagingBuffer, stagingBufferMemory);
-
-    // Map memory to buffer
-    void* data;                                                         // pointer in normal memory
-    data = device.mapMemory(stagingBufferMemory, 0, bufferSize);        // Connnect vertex buffer memory and pointer
-    memcpy(data, vertices.data(), bufferSize);                          // copy form vertices array to pointer
-    device.unmapMemory(stagingBufferMemory);                            // Unmap buffer memory
+    // "Stage" vertex data in render device's staging ring before transerfering to gpu
+    StagingAllocation staging = renderDevice.stageData(vertices.data(), bufferSize);
 
-    // Create buffer with transfer dst to mark as reciptant for of transfer data
-    Volcano::createBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer,
-        vk::MemoryPropertyFlagBits::eDeviceLocal, vertexBuffer, vertexBufferMemory);        // local bit means memory is on gpu and only accescible by it
-
-    Volcano::copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
-
-    // Clean up staging buffer
-    device.destroyBuffer(stagingBuffer);
-    device.freeMemory(stagingBufferMemory);
+    // Copy into range of shared vertex buffer owned by this mesh
+    vk::Buffer vertexBuffer = renderDevice.getGeometryArena().getVertexBuffer();
+    renderDevice.copyBuffer(staging.buffer, vertexBuffer, bufferSize, staging.offset, sizeof(Vertex) * geometry.vertexOffset);
 }
 
 void Mesh::createIndexBuffer(std::vector<uint32_t>& indices)
 {
     vk::DeviceSize bufferSize = sizeof(uint32_t) * indices.size();
+    if (bufferSize == 0)
+        return;
 
-    vk::Buffer stagingBuffer;
-    vk::DeviceMemory stagingBufferMemory;
-
-    Volcano::createBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferSrc, 
-            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
-            stagingBuffer, stagingBufferMemory);
-
-    void* data = device.mapMemory(stagingBufferMemory, 0, bufferSize);
-    memcpy(data, indices.data(), bufferSize);
-    device.unmapMemory(stagingBufferMemory);
-
-    Volcano::createBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer,
-        vk::MemoryPropertyFlagBits::eDeviceLocal, indexBuffer, indexBufferMemory);
-
-    Volcano::copyBuffer(stagingBuffer, indexBuffer, bufferSize);
+    StagingAllocation staging = renderDevice.stageData(indices.data(), bufferSize);
 
-    device.destroyBuffer(stagingBuffer);
-    device.freeMemory(stagingBufferMemory);
+    vk::Buffer indexBuffer = renderDevice.getGeometryArena().getIndexBuffer();
+    renderDevice.copyBuffer(staging.buffer, indexBuffer, bufferSize, staging.offset, sizeof(uint32_t) * geometry.firstIndex);
 }
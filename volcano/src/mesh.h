@@ -2,8 +2,13 @@
 
 #include <vector>
 #include <vulkan/vulkan.hpp>
+#include "GeometryArena.h"
+#include "PipelineRegistry.h"
 #include "vertex.h"
 
+class RenderDevice;
+class Volcano;
+
 struct Model 
 {
     glm::mat4 model;    
@@ -12,29 +17,39 @@ struct Model
 class Mesh
 {
 public:
-    Mesh(vk::Device& device, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+    // Geometry is uploaded once and drawn instanceCount times in one draw
+    // Drawn with pipeline from render device's pipeline registry. Instances are slots of renderer
+    // Geometry and slots go back to render device and renderer on destruction, so mesh must not outlive renderer
+    Mesh(Volcano& renderer, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t instanceCount = 1, PipelineId pipeline = 0);
     ~Mesh();
 
-    void setModel(const glm::mat4& model);
-    inline Model getModel() const { return model; }
+    // Instances own contiguous model slots starting at first instance (Volcano::updateModel index)
+    inline uint32_t getFirstInstance() const { return firstInstance; };
+    inline uint32_t getInstanceCount() const { return instanceCount; };
 
-    inline size_t getVertexCount() const { return vertexCount; };
-    inline vk::Buffer getVertexBuffer() const { return vertexBuffer; };
+    inline size_t getVertexCount() const { return geometry.vertexCount; };
+    // Offset of first vertex in render device's vertex arena
+    inline uint32_t getVertexOffset() const { return geometry.vertexOffset; };
     
-    inline size_t getIndexCount() const { return indexCount; };
-    inline vk::Buffer getIndexBuffer() const { return indexBuffer; };
-private:
-    Model model;
+    inline size_t getIndexCount() const { return geometry.indexCount; };
+    // Offset of first index in render device's index arena
+    inline uint32_t getFirstIndex() const { return geometry.firstIndex; };
 
-    size_t vertexCount;
-    vk::Buffer vertexBuffer;
-    vk::DeviceMemory vertexBufferMemory;
+    inline PipelineId getPipeline() const { return pipeline; };
+
+    // Upload ticket to poll with RenderDevice::isUploadComplete
+    inline uint64_t getUploadTicket() const { return uploadTicket; };
+private:
+    uint32_t firstInstance = 0;
+    uint32_t instanceCount = 1;
+    PipelineId pipeline = 0;
+    uint64_t uploadTicket = 0;
 
-    size_t indexCount;
-    vk::Buffer indexBuffer;
-    vk::DeviceMemory indexBufferMemory;
+    // Vertices and indices live in render device's geometry arena
+    GeometryRange geometry;
 
-    vk::Device& device;
+    Volcano& renderer;
+    RenderDevice& renderDevice;
 private:
     void createVertexBuffer(std::vector<Vertex>& vertices);
     void createIndexBuffer(std::vector<uint32_t>& indices);
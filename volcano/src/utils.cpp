@@ -2,6 +2,7 @@
 #include "utils.h"
 
 #include <fstream>
+#include <iterator>
 #include <stdexcept>
 
 namespace utils
@@ -22,4 +23,69 @@ namespace utils
 
         return buffer;
     }
+
+    void writeFile(const char* filename, const void* data, size_t size)
+    {
+        std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+        if(!file.is_open())
+            throw std::runtime_error("Failed to open file");
+
+        file.write(static_cast<const char*>(data), size);
+        if(!file)
+            throw std::runtime_error("Failed to write file");
+    }
+
+    // Keeps low offsets packed so arena rarely fragments for static scenes
+    bool allocateRange(std::map<uint32_t, uint32_t>& freeRanges, uint32_t count, uint32_t& offset)
+    {
+        if (count == 0)
+        {
+            offset = 0;
+            return true;
+        }
+
+        for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it)
+        {
+            if (it->second < count)
+                continue;
+
+            offset = it->first;
+            uint32_t remaining = it->second - count;
+            freeRanges.erase(it);
+            if (remaining > 0)
+                freeRanges.emplace(offset + count, remaining);
+
+            return true;
+        }
+
+        return false;
+    }
+
+    void freeRange(std::map<uint32_t, uint32_t>& freeRanges, uint32_t offset, uint32_t count)
+    {
+        if (count == 0)
+            return;
+
+        auto next = freeRanges.lower_bound(offset);
+
+        // Merge with following range
+        if (next != freeRanges.end() && offset + count == next->first)
+        {
+            count += next->second;
+            next = freeRanges.erase(next);
+        }
+
+        // Merge with preceding range
+        if (next != freeRanges.begin())
+        {
+            auto prev = std::prev(next);
+            if (prev->first + prev->second == offset)
+            {
+                prev->second += count;
+                return;
+            }
+        }
+
+        freeRanges.emplace(offset, count);
+    }
 }
@@ -1,8 +1,17 @@
 #pragma once
 
+#include <cstdint>
+#include <map>
 #include <vector>
 
 namespace utils
 {
     std::vector<char> readFile(const char* filename);
+    void writeFile(const char* filename, const void* data, size_t size);
+
+    // Free ranges keyed by offset, e.g. of geometry arena or instance slots
+    // First fit. Returns false when no free range is large enough
+    bool allocateRange(std::map<uint32_t, uint32_t>& freeRanges, uint32_t count, uint32_t& offset);
+    // Neighbours are merged
+    void freeRange(std::map<uint32_t, uint32_t>& freeRanges, uint32_t offset, uint32_t count);
 }
@@ -6,5 +6,6 @@ struct Vertex
 {
     glm::vec3 pos;
     glm::vec4 col;
+    glm::vec2 tex;      // Texture coordinate
 };
 
@@ -1,86 +1,68 @@
 #include "volcanoPCH.h"
 #include "volcano.h"
 
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <cstdlib>
 #include <GLFW/glfw3.h>
 #include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
 #include <limits>
+#include <future>
 #include <map>
+#include <numeric>
 #include <set>
 #include "SwapChainImage.h"
 #include "SwapChainSupportDetails.h"
 #include "QueueFamilyIndices.h"
+#include "PngWriter.h"
+#include "Profiler.h"
+#include "ShaderRegistry.h"
 #include "utils.h"
 #include "vertex.h"
 #include "window.h"
 
-void Volcano::init(Window* window)
+void Volcano::initHeadless(RenderDevice& renderDevice, uint32_t width, uint32_t height, uint32_t framesInFlight)
 {
-    Volcano::window = window;
-
-    {   // Init vulkan instance
-#ifdef DEBUG
-        if(!checkValidationLayerSupport())
-            throw std::runtime_error("Vaildation layer not found");
-#endif
-        vk::ApplicationInfo appInfo;
-        appInfo.pApplicationName = "volcano";
-        appInfo.pEngineName = "Volcano";
-        appInfo.apiVersion = VK_API_VERSION_1_2;
-        
-        vk::InstanceCreateInfo instanceInfo;
-        instanceInfo.pApplicationInfo = &appInfo;
-    
-        auto extensions = getRequiredExtensions();
+    // Offscreen targets get this size instead of one chosen from surface
+    Volcano::swapChainExtent = vk::Extent2D(width, height);
+    Volcano::init(renderDevice, nullptr, framesInFlight);
+}
 
-        instanceInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
-        instanceInfo.ppEnabledExtensionNames = extensions.data();
+void Volcano::init(RenderDevice& renderDevice, Window* window, uint32_t framesInFlight)
+{
+    if (window && !renderDevice.supportsPresentation())
+        throw std::runtime_error("Render device was created without presentation");
 
-#ifdef DEBUG
-        instanceInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
-        instanceInfo.ppEnabledLayerNames = validationLayers.data();
-#else
-        instanceInfo.enabledLayerCount = 0;
-#endif
+    Volcano::renderDevice = &renderDevice;
+    Volcano::physicalDevice = renderDevice.getPhysicalDevice();
+    Volcano::device = renderDevice.getDevice();
+    Volcano::pipelineGeneration = renderDevice.getPipelineGeneration();
+    Volcano::window = window;
+    Volcano::headless = window == nullptr;
+    Volcano::framesInFlight = std::max(framesInFlight, 1u);
+    Volcano::frames.resize(Volcano::framesInFlight);
 
-        try
-        {
-            instance = vk::createInstanceUnique(instanceInfo, nullptr);
-        } 
-        catch(vk::SystemError& e)
-        {
-            UNUSED(e);
-            throw std::runtime_error("Failed to create instance");
-        }
+    if (Volcano::headless)
+    {
+        Volcano::createOffscreenTargets();
     }
-
-#ifdef DEBUG
-    {   
-        // Setup debug messenger
-        auto createInfo = vk::DebugUtilsMessengerCreateInfoEXT(
-                vk::DebugUtilsMessengerCreateFlagsEXT(),
-                vk::DebugUtilsMessageSeverityFlagBitsEXT::eVerbose | vk::DebugUtilsMessageSeverityFlagBitsEXT::eWarning | vk::DebugUtilsMessageSeverityFlagBitsEXT::eError,
-                vk::DebugUtilsMessageTypeFlagBitsEXT::eGeneral | vk::DebugUtilsMessageTypeFlagBitsEXT::eValidation | vk::DebugUtilsMessageTypeFlagBitsEXT::ePerformance,
-                &Volcano::debugCallback, 
-                nullptr
-        );
-        
-        if (createDebugUtilsMessengerEXT(instance, reinterpret_cast<const VkDebugUtilsMessengerCreateInfoEXT*>(&createInfo), nullptr, &callback) != VK_SUCCESS)
-            throw std::runtime_error("Failed to create debug callback");
+    else
+    {
+        Volcano::createSurface();
+        Volcano::createSwapChain();
     }
-#endif
-
-    Volcano::createSurface();
-    Volcano::pickPhysicalDevice();
-    Volcano::createLogicalDevice();
-    Volcano::createSwapChain();
     Volcano::createDepthBufferImage();
     Volcano::createRenderPass();
     Volcano::createDescriptorSetLayout();
+    Volcano::createPipelineLayout();
+    // Compiles while rest of init runs
     Volcano::createGraphicsPipeline();
     Volcano::createFramebuffers();
     Volcano::createCommandPool();
+    Volcano::gpuProfiler.init(Volcano::physicalDevice, Volcano::device, Volcano::renderDevice->getQueueFamilies().graphicsFamily.value(),
+        Volcano::framesInFlight);
  
     int tex = Volcano::createTexture("brick.png");
 
@@ -88,126 +70,212 @@ void Volcano::init(Window* window)
     mvp.view = glm::lookAt(glm::vec3(0.0f, 0.0f, 50.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
     mvp.proj[1][1] *= -1;
 
-    std::vector<Vertex> meshVertex = {
-        {{  1.0f, -1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f, 1.0f }},   // 0
-        {{  1.0f,  1.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 1.0f }},   // 1
-        {{ -1.0f,  1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f, 1.0f }},   // 2
-        {{ -1.0f, -1.0f, 0.0f }, { 1.0f, 1.0f, 0.0f, 1.0f }}    // 3
-    };
-    
-    std::vector<uint32_t> meshIndices = {
-        0, 1, 2, 
-        2, 3, 0
-    };
-
-    meshList.emplace_back(std::make_shared<Mesh>(Volcano::device.get(), meshVertex, meshIndices));
-    meshList.emplace_back(std::make_shared<Mesh>(Volcano::device.get(), meshVertex, meshIndices));
-   
-   /* glm::mat4 meshModel = meshList[0]->getModel().model;
-    meshModel = glm::rotate(meshModel, glm::radians(45.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    meshList[0]->setModel(meshModel);*/
-
     Volcano::createCommandBuffer();
     Volcano::createTextureSampler();
-    //Volcano::allocateDynamicBufferTransferSpace();
     Volcano::createUniformBuffer();
+    Volcano::createIndirectBuffer();
+    if (Volcano::headless)
+        Volcano::createReadback();
     Volcano::createDescriptorPool();
     Volcano::createDescriptorSets();
     Volcano::createSynchronization();
+
+    // Send texture upload right away. Rendering is ordered after it on the same queue
+    Volcano::renderDevice->flushUploads();
 }
 
 void Volcano::destroy()
 {
-    Volcano::device->waitIdle();
-
-    //_aligned_free(modelTransferSpace);
+    // Other contexts may keep rendering. Only frames of this one have to finish
+    Volcano::waitForFrames();
 
-    Volcano::device->destroySampler(textureSampler);
+    Volcano::device.destroySampler(textureSampler);
 
-    for(int i = 0; i < MAX_FRAME_DRAWS; ++i)
+    for(auto& frame: Volcano::frames)
     {
-        Volcano::device->destroySemaphore(Volcano::renderFinished[i]);
-        Volcano::device->destroySemaphore(Volcano::imageAvailable[i]);
-        Volcano::device->destroyFence(Volcano::drawFences[i]);
+        Volcano::device.destroySemaphore(frame.renderFinished);
+        Volcano::device.destroySemaphore(frame.imageAvailable);
+        Volcano::device.destroyFence(frame.fence);
+
+        // Command buffers are freed with their pools
+        Volcano::device.destroyCommandPool(frame.commandPool);
+        for(auto& pool: frame.secondaryCommandPools)
+            Volcano::device.destroyCommandPool(pool);
     }
+    Volcano::frames.clear();
+    Volcano::gpuProfiler.destroy();
     
     for (size_t i = 0; i < Volcano::textureImages.size(); ++i)
     {
-        Volcano::device->destroyImageView(Volcano::textureImageView[i]);
-        Volcano::device->destroyImage(Volcano::textureImages[i]);
-        Volcano::device->free(Volcano::textureImageMemory[i]);
-    }
+        Volcano::device.destroyImageView(Volcano::textureImageView[i]);
+        Volcano::device.destroyImage(Volcano::textureImages[i]);
+        Volcano::renderDevice->getAllocator().free(Volcano::textureImageMemory[i]);
+    }
+    Volcano::textureImages.clear();
+    Volcano::textureImageMemory.clear();
+    Volcano::textureImageView.clear();
+
+    //Volcano::device.freeDescriptorSets(Volcano::descriptorPool, Volcano::descriptorSets);
+    Volcano::device.destroyDescriptorPool(Volcano::descriptorPool);
+    Volcano::vpUniformBuffer.destroy();
+    Volcano::indirectBuffer.destroy();
+    Volcano::transformBuffer.destroy();
+    if (Volcano::headless)
+    {
+        // Frames are done, so copies of last frames are too. Hand them out instead of dropping them
+        for (uint32_t i = 0; i < Volcano::framesInFlight; ++i)
+            Volcano::frameReadback.complete(i);
+        Volcano::frameReadback.destroy();
+    }
+    Volcano::retireSwapChain();
+    Volcano::releaseRetiredSwapChains(std::numeric_limits<uint64_t>::max());
+    Volcano::swapChain = nullptr;
+
+    // Pipelines made for render pass go with it. Descriptor set and pipeline layouts are shared and stay in cache
+    Volcano::renderDevice->getPipelineRegistry().retire(Volcano::renderPass);
+    Volcano::device.destroyRenderPass(Volcano::renderPass);
+    if (Volcano::surface)
+        Volcano::renderDevice->getInstance().destroySurfaceKHR(Volcano::surface);
+    Volcano::surface = nullptr;
+
+    // Geometry goes back to arena of device
+    Volcano::meshList.clear();
+    Volcano::instanceModels.clear();
+    Volcano::freeInstanceRanges.clear();
+    Volcano::renderDevice = nullptr;
+}
 
-    Volcano::device->destroyImageView(depthBufferImageView);
-    Volcano::device->destroyImage(depthBufferImage);
-    Volcano::device->freeMemory(depthBufferMemory);
+void Volcano::waitForFrames()
+{
+    std::vector<vk::Fence> fences;
+    for (auto& frame : Volcano::frames)
+        fences.push_back(frame.fence);
 
-    //Volcano::device->freeDescriptorSets(Volcano::descriptorPool, Volcano::descriptorSets);
-    Volcano::device->destroyDescriptorPool(Volcano::descriptorPool);
-    Volcano::device->destroyDescriptorSetLayout(Volcano::descriptorSetLayout);
-    for(size_t i = 0; i < swapChainImages.size(); ++i)
-    {
-        Volcano::device->destroyBuffer(vpUniformBuffer[i]);
-        Volcano::device->freeMemory(vpUniformBufferMemory[i]);
-        
-        //Volcano::device->destroyBuffer(modelUniformBuffer[i]);
-        //Volcano::device->freeMemory(modelUniformBufferMemory[i]);
-    }
-    Volcano::cleanupSwapChain();
-    Volcano::device->destroyCommandPool(Volcano::graphicsCommandPool);
-    Volcano::instance->destroySurfaceKHR(Volcano::surface);
+    if (!fences.empty() && Volcano::device.waitForFences(fences, VK_TRUE, std::numeric_limits<uint64_t>::max()) != vk::Result::eSuccess)
+        throw std::runtime_error("Failed to wait for frames");
+}
 
-#ifdef DEBUG
-    destroyDebugUtilMessengerEXT(instance, callback, nullptr);
-#endif
+void Volcano::setCamera(const glm::mat4& view, const glm::mat4& proj)
+{
+    // Uniform buffer is rewritten every frame, nothing recorded depends on it
+    mvp.view = view;
+    mvp.proj = proj;
+}
+
+void Volcano::setGpuDrawGroupTiming(bool enabled)
+{
+    // Timestamps of draw groups live in recorded draws
+    Volcano::gpuProfiler.setDrawGroupTiming(enabled);
+    Volcano::markCommandBuffersDirty();
+}
+
+void Volcano::clearScene()
+{
+    // Draws of frames in flight still read geometry and transforms of scene
+    Volcano::waitForFrames();
+
+    // Meshes give their geometry and instance slots back once last reference is gone
+    // Slots of meshes still held elsewhere stay taken, so their models are kept too
+    Volcano::meshList.clear();
+    Volcano::markCommandBuffersDirty();
 }
 
 void Volcano::draw()
 {
-    // Wait for fence to signal
-    vk::Result result = Volcano::device->waitForFences(Volcano::drawFences[currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
-    // Manually reset closed fences
-    Volcano::device->resetFences(Volcano::drawFences[currentFrame]);
-    
-    // 1. Get next available image to draw to
-    uint32_t index;
-    try 
+    VOLCANO_PROFILE_SCOPE("draw");
+
+    // Nothing to present to while minimized. Swapchain is recreated once window is restored
+    if (!Volcano::headless)
     {
-        index = Volcano::device->acquireNextImageKHR(Volcano::swapChain, std::numeric_limits<uint64_t>::max(), Volcano::imageAvailable[Volcano::currentFrame], nullptr).value;
+        int width = 0, height = 0;
+        glfwGetFramebufferSize(Volcano::window->getWindow(), &width, &height);
+        if (width == 0 || height == 0)
+            return;
     }
-    catch(vk::OutOfDateKHRError err)
+
+    // Frame boundary. Nothing of this frame is recorded yet
+    Volcano::renderDevice->update();
+    // Shaders were reloaded. Draws recorded with replaced pipelines are invalid
+    if (Volcano::pipelineGeneration != Volcano::renderDevice->getPipelineGeneration())
     {
-        Volcano::framebufferResized = true;
-        Volcano::recreateSwapChain();
-        return;
+        Volcano::pipelineGeneration = Volcano::renderDevice->getPipelineGeneration();
+        Volcano::markCommandBuffersDirty();
     }
-    catch(vk::SystemError& err)
+
+    // Wait for fence to signal. Already done if models were updated this frame
+    Volcano::beginFrame();
+    vk::Result result;
+    FrameContext& frame = Volcano::frames[currentFrame];
+    
+    // 1. Get next available image to draw to
+    uint32_t index = currentFrame;                  // Headless: offscreen target of frame, free since its fence signalled
+    if (!Volcano::headless)
     {
-        UNUSED(err);
-        throw std::runtime_error("Failed to aquire swapchain image");
+        try 
+        {
+            VOLCANO_PROFILE_SCOPE("acquireNextImageKHR");
+            index = Volcano::device.acquireNextImageKHR(Volcano::swapChain, std::numeric_limits<uint64_t>::max(), frame.imageAvailable, nullptr).value;
+        }
+        catch(vk::OutOfDateKHRError err)
+        {
+            // Nothing submitted. Frame (and its transform slot) stays current and its fence stays signalled
+            Volcano::window->getFramebufferResized() = true;
+            Volcano::recreateSwapChain();
+            return;
+        }
+        catch(vk::SystemError& err)
+        {
+            UNUSED(err);
+            throw std::runtime_error("Failed to aquire swapchain image");
+        }
     }
 
+    // Manually reset closed fences. Only once frame is sure to be submitted
+    Volcano::device.resetFences(frame.fence);
+
+    // Previous frame rendering to this image may still be in flight (more images than frames)
+    // Own fence was waited on in beginFrame and is reset already
+    if (Volcano::imagesInFlight[index] && Volcano::imagesInFlight[index] != frame.fence)
+        result = Volcano::device.waitForFences(Volcano::imagesInFlight[index], VK_TRUE, std::numeric_limits<uint64_t>::max());
+    Volcano::imagesInFlight[index] = frame.fence;
+
+    // Startup time is taken once default pipeline can draw, polled until then
+    if (!Volcano::startupReported && Volcano::renderDevice->getPipelineRegistry().isReady(Volcano::defaultPipeline))
+    {
+        Volcano::renderDevice->reportStartup();
+        Volcano::startupReported = true;
+    }
+
+    // Reuse recorded draws unless scene structure changed. Primary only targets acquired image
+    if (frame.drawsDirty)
+        Volcano::recordDraws(currentFrame);
     Volcano::recordCommands(index);
-    Volcano::updateUniformBuffers(index);
+    Volcano::updateUniformBuffers();
+
+    // Uploads recorded since last frame are submitted ahead of it
+    Volcano::renderDevice->flushUploads();
 
     // 2. Submit command buffer to graphics queue
     // Queue submit info
+    // Nothing to wait for or signal headless. Fence alone tells when target can be read
     vk::SubmitInfo submitInfo = {};
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = &Volcano::imageAvailable[Volcano::currentFrame];          // Semaphore to wait for
+    submitInfo.waitSemaphoreCount = Volcano::headless ? 0 : 1;
+    submitInfo.pWaitSemaphores = &frame.imageAvailable;                                     // Semaphore to wait for
     
     vk::PipelineStageFlags waitStages[] = {
         vk::PipelineStageFlagBits::eColorAttachmentOutput
     };
     submitInfo.pWaitDstStageMask = waitStages;
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &Volcano::commandBuffers[index];
-    submitInfo.signalSemaphoreCount = 1;                                                    // Semaphore to signal after rendering is finished
-    submitInfo.pSignalSemaphores = &Volcano::renderFinished[Volcano::currentFrame];
+    submitInfo.pCommandBuffers = &frame.commandBuffer;
+    submitInfo.signalSemaphoreCount = Volcano::headless ? 0 : 1;                            // Semaphore to signal after rendering is finished
+    submitInfo.pSignalSemaphores = &frame.renderFinished;
 
     try
     {
-        Volcano::graphicsQueue.submit(submitInfo, Volcano::drawFences[currentFrame]);
+        VOLCANO_PROFILE_SCOPE("submit");
+        Volcano::renderDevice->getGraphicsQueue().submit(submitInfo, frame.fence);
+        ++Volcano::frameNumber;
     }
     catch(vk::SystemError& e)
     {
@@ -218,17 +286,27 @@ void Volcano::draw()
     // Images is drawn to buffer till this stage
 
     // 3. Present image to screen
+    if (!Volcano::headless)
+        Volcano::presentFrame(frame, index);
+
+    currentFrame = (currentFrame + 1) % Volcano::framesInFlight;
+    Volcano::frameBegun = false;
+}
+
+void Volcano::presentFrame(FrameContext& frame, uint32_t imageIndex)
+{
     vk::PresentInfoKHR presentInfo = {};
     presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = &Volcano::renderFinished[Volcano::currentFrame];          // Semaphore to wait for
+    presentInfo.pWaitSemaphores = &frame.renderFinished;                                    // Semaphore to wait for
     presentInfo.swapchainCount = 1;
-    presentInfo.pSwapchains = &Volcano::swapChain;
-    presentInfo.pImageIndices = &index;
+    presentInfo.pSwapchains = &swapChain;                                                   // Unqualified, &Volcano::swapChain would be a member pointer
+    presentInfo.pImageIndices = &imageIndex;
 
     vk::Result presentResult;
     try 
     {
-        presentResult = Volcano::presentQueue.presentKHR(presentInfo);
+        VOLCANO_PROFILE_SCOPE("present");
+        presentResult = Volcano::renderDevice->getPresentQueue().presentKHR(presentInfo);
     }
     catch(vk::OutOfDateKHRError& err)
     {
@@ -240,174 +318,167 @@ void Volcano::draw()
         throw std::runtime_error(err.what());
     }
 
-    if(presentResult == vk::Result::eSuboptimalKHR || presentResult == vk::Result::eErrorOutOfDateKHR || framebufferResized)
+    if(presentResult == vk::Result::eSuboptimalKHR || presentResult == vk::Result::eErrorOutOfDateKHR || Volcano::window->getFramebufferResized())
     {
-        Volcano::framebufferResized = false;
+        Volcano::window->getFramebufferResized() = false;
         Volcano::recreateSwapChain();
-        return;
     }
 
-    // if(Volcano::presentQueue.presentKHR(presentInfo) != vk::Result::eSuccess)
+    // if(Volcano::renderDevice->getPresentQueue().presentKHR(presentInfo) != vk::Result::eSuccess)
     //     throw std::runtime_error("Failed to create r");
-
-    currentFrame = (currentFrame + 1) % MAX_FRAME_DRAWS;
 }
 
-void Volcano::updateModel(int modelId, const glm::mat4& newModel)
+void Volcano::beginFrame()
 {
-    if (modelId >= meshList.size()) return;
-
-    meshList[modelId]->setModel(newModel);
-}
-
-void Volcano::pickPhysicalDevice()
-{
-    auto devices = instance->enumeratePhysicalDevices();
-    if(devices.size() == 0)
-        throw std::runtime_error("Failed to find suitable GPU");
+    if (Volcano::frameBegun)
+        return;
 
-    for(const auto& device : devices)
+    // Gpu is done with frame that used this slot last
+    FrameContext& frame = Volcano::frames[currentFrame];
     {
-        if(isDeviceSuitable(device))
-        {
-            physicalDevice = device;
-            break;
-        }
+        VOLCANO_PROFILE_SCOPE("fence wait");
+        vk::Result result = Volcano::device.waitForFences(frame.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+        if (result != vk::Result::eSuccess)
+            throw std::runtime_error("Failed to wait for frame");
     }
 
-    //vk::PhysicalDeviceProperties deviceProperties = physicalDevice.getProperties();
-    //minBufferOffset = deviceProperties.limits.minUniformBufferOffsetAlignment;
+    // Timestamps of frame that last used this slot are written
+    Volcano::gpuProfiler.collect(currentFrame);
+
+    // Copy of frame that last used this slot is complete
+    if (Volcano::headless)
+        Volcano::frameReadback.complete(currentFrame);
 
-    if(!physicalDevice)
-        throw std::runtime_error("Failed to find suitable GPU");
+    // Catch up on models changed while slot was in flight
+    Model* slot = Volcano::transformBuffer.get<Model>(currentFrame);
+    auto& stale = frame.staleTransforms;
+    if (stale.first < stale.second)
+        memcpy(slot + stale.first, Volcano::instanceModels.data() + stale.first, sizeof(Model) * (stale.second - stale.first));
+    Volcano::writtenTransforms = stale;
+    stale = { 0, 0 };
+
+    // Every frame up to one that last used this frame context has finished
+    uint64_t completedFrames = Volcano::frameNumber + 1 >= Volcano::framesInFlight ? Volcano::frameNumber + 1 - Volcano::framesInFlight : 0;
+    Volcano::releaseRetiredSwapChains(completedFrames);
+
+    Volcano::frameBegun = true;
 }
 
-bool Volcano::isDeviceSuitable(const vk::PhysicalDevice& physicalDevice)
+void Volcano::updateModel(uint32_t modelId, const glm::mat4& newModel)
 {
-    vk::PhysicalDeviceFeatures deviceFeatures = physicalDevice.getFeatures();
+    if (modelId >= Volcano::instanceModels.size()) return;
 
-    auto indices = findQueueFamily(physicalDevice);
+    Volcano::beginFrame();
 
-    bool extensionSupport = checkDeviceExtensionsSupport(physicalDevice);
+    // Only model buffers need update. Recorded command buffers stay valid
+    Volcano::instanceModels[modelId].model = newModel;
+    Volcano::transformBuffer.get<Model>(currentFrame)[modelId].model = newModel;
+    Volcano::markTransformsStale(modelId, modelId + 1, true);
+}
 
-    bool swapChainAdequate = false;
-    if(extensionSupport)
+void Volcano::updateModels(uint32_t firstModel, const std::vector<glm::mat4>& newModels)
+{
+    if (firstModel >= Volcano::instanceModels.size()) return;
+
+    Volcano::beginFrame();
+
+    size_t count = std::min(newModels.size(), Volcano::instanceModels.size() - firstModel);
+    Model* slot = Volcano::transformBuffer.get<Model>(currentFrame);
+    for (size_t i = 0; i < count; ++i)
     {
-        auto swapChainSupport = SwapChainSupportDetails::queryDetails(physicalDevice, Volcano::surface);
-        swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
+        Volcano::instanceModels[firstModel + i].model = newModels[i];
+        slot[firstModel + i].model = newModels[i];
     }
 
-    return indices.isComplete() && extensionSupport && swapChainAdequate && deviceFeatures.samplerAnisotropy;
+    Volcano::markTransformsStale(firstModel, static_cast<uint32_t>(firstModel + count), true);
 }
 
-QueueFamilyIndicies Volcano::findQueueFamily(const vk::PhysicalDevice& physicalDevice)
+void Volcano::markTransformsStale(uint32_t first, uint32_t end, bool skipCurrent)
 {
-    QueueFamilyIndicies indices;
+    std::lock_guard<std::mutex> lock(Volcano::transformMutex);
 
-    auto queueFamilies = physicalDevice.getQueueFamilyProperties();
+    auto extend = [first, end](std::pair<uint32_t, uint32_t>& range) {
+        if (range.first == range.second)
+            range = { first, end };
+        else
+            range = { std::min(range.first, first), std::max(range.second, end) };
+    };
 
-    int i = 0;
-    for(const auto& queueFamily: queueFamilies)
+    // Slots catch up in beginFrame. Current slot is skipped when it was written directly
+    for (uint32_t i = 0; i < Volcano::framesInFlight; ++i)
     {
-        if (queueFamily.queueCount > 0 && queueFamily.queueFlags & vk::QueueFlagBits::eGraphics)
-            indices.graphicsFamily = i;
+        if (skipCurrent && i == currentFrame)
+            continue;
 
-        if (queueFamily.queueCount > 0 && physicalDevice.getSurfaceSupportKHR(i, surface))
-            indices.presentFamily = i;
-
-        if (indices.isComplete()) break;
-
-        ++i;
+        extend(Volcano::frames[i].staleTransforms);
     }
 
-    return indices;
+    if (skipCurrent)
+        extend(Volcano::writtenTransforms);
 }
 
-std::vector<const char*> Volcano::getRequiredExtensions()
+std::shared_ptr<Mesh> Volcano::addMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t instanceCount, PipelineId pipeline)
 {
-    uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    if (pipeline == DEFAULT_PIPELINE)
+        pipeline = Volcano::defaultPipeline;
 
-    std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    auto mesh = std::make_shared<Mesh>(*this, vertices, indices, instanceCount, pipeline);
+    Volcano::meshList.push_back(mesh);
 
-#ifdef DEBUG
-    extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
-#endif
+    // New draw has to be recorded into every command buffer
+    Volcano::markCommandBuffersDirty();
 
-    return extensions;
+    return mesh;
 }
 
-void Volcano::createLogicalDevice()
+uint32_t Volcano::allocateInstances(uint32_t instanceCount)
 {
-    auto indices = findQueueFamily(physicalDevice);
-
-    std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos;
-    std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
-    
-    float queuePriority = 1.0f;
-
-    for(uint32_t queueFamily : uniqueQueueFamilies)
+    // Slots of destroyed meshes first, otherwise appended after last slot
+    uint32_t firstInstance;
+    if (!utils::allocateRange(Volcano::freeInstanceRanges, instanceCount, firstInstance))
     {
-        auto queueCreateInfo = vk::DeviceQueueCreateInfo(
-            vk::DeviceQueueCreateFlags(),
-            queueFamily,
-            1,
-            &queuePriority
-        );
+        firstInstance = static_cast<uint32_t>(Volcano::instanceModels.size());
+        if (static_cast<size_t>(firstInstance) + instanceCount > MAX_INSTANCES)
+            throw std::runtime_error("Too many instances in scene");
 
-        queueCreateInfos.push_back(queueCreateInfo);
+        Volcano::instanceModels.resize(firstInstance + instanceCount);
     }
 
-    auto deviceFeature = vk::PhysicalDeviceFeatures();
-    deviceFeature.samplerAnisotropy = VK_TRUE;                      // enable anisotropy feature
-
-    auto createInfo = vk::DeviceCreateInfo(
-        vk::DeviceCreateFlags(),
-        static_cast<uint32_t>(queueCreateInfos.size()),
-        queueCreateInfos.data()
-    );
-    createInfo.pEnabledFeatures = &deviceFeature;
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
-
-#ifdef DEBUG
-    createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
-    createInfo.ppEnabledLayerNames = validationLayers.data();
-#endif
+    // Reused slots still hold models of their last mesh
+    uint32_t end = firstInstance + instanceCount;
+    std::fill(Volcano::instanceModels.begin() + firstInstance, Volcano::instanceModels.begin() + end, Model{ glm::mat4(1.0f) });
 
-    try
+    // Every slot gets initial models of new instances
+    // Slot of frame already begun was caught up, so it is written directly, same as in updateModel
+    if (Volcano::frameBegun)
     {
-        device = physicalDevice.createDeviceUnique(createInfo);
-    }
-    catch(vk::SystemError& e)
-    {
-        UNUSED(e);
-        throw std::runtime_error("Failed to create logical device");
+        Model* slot = Volcano::transformBuffer.get<Model>(currentFrame);
+        std::fill(slot + firstInstance, slot + end, Model{ glm::mat4(1.0f) });
     }
+    Volcano::markTransformsStale(firstInstance, end, Volcano::frameBegun);
 
-    Volcano::graphicsQueue = device->getQueue(indices.graphicsFamily.value(), 0);
-    Volcano::presentQueue = device->getQueue(indices.presentFamily.value(), 0);
+    return firstInstance;
+}
+
+void Volcano::freeInstances(uint32_t firstInstance, uint32_t instanceCount)
+{
+    // Frames in flight keep their own copy of slots, so they may be handed out again right away
+    utils::freeRange(Volcano::freeInstanceRanges, firstInstance, instanceCount);
 }
 
 void Volcano::createSurface()
 {
     // Raw surface of basic c struct style is required because glfw requirement
     VkSurfaceKHR rawSurface;
-    if(glfwCreateWindowSurface(*instance, window->getWindow(), nullptr, &rawSurface) != VK_SUCCESS)
+    if(glfwCreateWindowSurface(Volcano::renderDevice->getInstance(), window->getWindow(), nullptr, &rawSurface) != VK_SUCCESS)
         throw std::runtime_error("Failed to create window surface");
     
     Volcano::surface = rawSurface;
-}
-
-bool Volcano::checkDeviceExtensionsSupport(const vk::PhysicalDevice& physicalDevice)
-{
-    std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
 
-    for (const auto& extension : physicalDevice.enumerateDeviceExtensionProperties())
-        requiredExtensions.erase(extension.extensionName);
-
-    return requiredExtensions.empty();
+    // Device was picked before any window existed. Present family has to reach this surface too
+    uint32_t presentFamily = Volcano::renderDevice->getQueueFamilies().presentFamily.value();
+    if (!Volcano::physicalDevice.getSurfaceSupportKHR(presentFamily, Volcano::surface))
+        throw std::runtime_error("Render device can not present to window surface");
 }
 
 vk::SurfaceFormatKHR Volcano::chooseSwapSurfaceFormat(const std::vector<vk::SurfaceFormatKHR>& availableFormats)
@@ -479,7 +550,7 @@ void Volcano::createSwapChain()
         vk::ImageUsageFlagBits::eColorAttachment
     );
 
-    auto indices = findQueueFamily(physicalDevice);
+    const auto& indices = Volcano::renderDevice->getQueueFamilies();
     uint32_t queueFamilyIndicies[] = { indices.graphicsFamily.value(), indices.presentFamily.value() };
 
     if (indices.graphicsFamily != indices.presentFamily)
@@ -498,12 +569,14 @@ void Volcano::createSwapChain()
     createInfo.presentMode = presentMode;
     createInfo.clipped = VK_TRUE;
     
-    createInfo.oldSwapchain = vk::SwapchainKHR(nullptr);
+    // Retiring swapchain (null on first creation). Lets driver reuse its resources
+    // while images it already queued are still presented
+    createInfo.oldSwapchain = Volcano::swapChain;
 
     try
     {
         // create swapchain
-        Volcano::swapChain = Volcano::device->createSwapchainKHR(createInfo);
+        Volcano::swapChain = Volcano::device.createSwapchainKHR(createInfo);
     }
     catch (vk::SystemError& e)
     {
@@ -516,7 +589,7 @@ void Volcano::createSwapChain()
     Volcano::swapChainExtent = extent;
 
     // Retrive list of swapchain images
-    auto swapchainImages = Volcano::device->getSwapchainImagesKHR(Volcano::swapChain);
+    auto swapchainImages = Volcano::device.getSwapchainImagesKHR(Volcano::swapChain);
     Volcano::swapChainImages.resize(swapchainImages.size());
 
     for(size_t i = 0; i < swapchainImages.size(); ++i)
@@ -526,36 +599,27 @@ void Volcano::createSwapChain()
         Volcano::swapChainImages[i].image = swapchainImages[i];
 
         // Create image view
-        Volcano::swapChainImages[i].imageView = Volcano::createImageView(swapchainImages[i], Volcano::swapChainImageFormat, vk::ImageAspectFlagBits::eColor);
+        Volcano::swapChainImages[i].imageView = Volcano::renderDevice->createImageView(swapchainImages[i], Volcano::swapChainImageFormat, vk::ImageAspectFlagBits::eColor);
     }
 }
 
-vk::ImageView Volcano::createImageView(const vk::Image& image, const vk::Format& format, const vk::ImageAspectFlags aspectFlag)
+void Volcano::createOffscreenTargets()
 {
-    vk::ImageViewCreateInfo viewCreateInfo = {};
-    viewCreateInfo.image = image;                                   // Image to create view for
-    viewCreateInfo.viewType = vk::ImageViewType::e2D;               // Type of image
-    viewCreateInfo.format = format;                                 // Format of image data
-    viewCreateInfo.components.r = vk::ComponentSwizzle::eIdentity;  // Allows remaping of rgba components  
-    viewCreateInfo.components.g = vk::ComponentSwizzle::eIdentity;    
-    viewCreateInfo.components.b = vk::ComponentSwizzle::eIdentity;    
-    viewCreateInfo.components.a = vk::ComponentSwizzle::eIdentity;    
-    
-    // Subresources allow the view to view only part of image
-    viewCreateInfo.subresourceRange.aspectMask = aspectFlag;
-    viewCreateInfo.subresourceRange.baseMipLevel = 0;               // Start mipmap level
-    viewCreateInfo.subresourceRange.levelCount = 1;                 // No of mipmap layers
-    viewCreateInfo.subresourceRange.baseArrayLayer = 0;             // Start array level to view from
-    viewCreateInfo.subresourceRange.layerCount = 1;                 // No of array layers
+    if (Volcano::swapChainExtent.width == 0 || Volcano::swapChainExtent.height == 0)
+        throw std::runtime_error("Headless target size must not be 0");
 
-    try 
-    {
-        return Volcano::device->createImageView(viewCreateInfo);
-    }
-    catch(vk::SystemError& e)
+    // Tightly packed rgba8 is what readback and image files expect
+    Volcano::swapChainImageFormat = vk::Format::eR8G8B8A8Unorm;
+
+    // Stand in for swapchain images. One per frame in flight, so a target is free once fence of its frame signalled
+    // and can be read back while other frames render
+    Volcano::swapChainImages.resize(Volcano::framesInFlight);
+    for (auto& target : Volcano::swapChainImages)
     {
-        UNUSED(e);
-        throw std::runtime_error("Failed to create image view");
+        target.image = Volcano::renderDevice->createImage(Volcano::swapChainExtent.width, Volcano::swapChainExtent.height, Volcano::swapChainImageFormat,
+            vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,
+            vk::MemoryPropertyFlagBits::eDeviceLocal, target.memory);
+        target.imageView = Volcano::renderDevice->createImageView(target.image, Volcano::swapChainImageFormat, vk::ImageAspectFlagBits::eColor);
     }
 }
 
@@ -575,6 +639,8 @@ void Volcano::createRenderPass()
     colourAttachment.initialLayout = vk::ImageLayout::eUndefined;          // Undefine initial layout before render pass start
     // Initial layout to subpass and then subpass to final
     colourAttachment.finalLayout = vk::ImageLayout::ePresentSrcKHR;        // layout after render pass
+    if (Volcano::headless)
+        colourAttachment.finalLayout = vk::ImageLayout::eTransferSrcOptimal;   // Not presented, only copied out
 
     //Depth attachments of render pass
     vk::AttachmentDescription depthAttachment = {};
@@ -624,6 +690,12 @@ void Volcano::createRenderPass()
     subpassDependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;                                                                        // Before 1st subpass
     subpassDependencies[1].dstStageMask = vk::PipelineStageFlagBits::eBottomOfPipe;                                                 // Transtion before 
     subpassDependencies[1].dstAccessMask = vk::AccessFlagBits::eMemoryRead;                                                         // Before read and write color
+    if (Volcano::headless)
+    {
+        // Copies out of target come next instead of present
+        subpassDependencies[1].dstStageMask = vk::PipelineStageFlagBits::eTransfer;
+        subpassDependencies[1].dstAccessMask = vk::AccessFlagBits::eTransferRead;
+    }
 
     std::array<vk::AttachmentDescription, 2> renderpassAttachments = {
         colourAttachment,
@@ -641,7 +713,7 @@ void Volcano::createRenderPass()
 
     try
     {
-        Volcano::renderPass = Volcano::device->createRenderPass(renderPassInfo);
+        Volcano::renderPass = Volcano::device.createRenderPass(renderPassInfo);
     }
     catch (vk::SystemError& e)
     {
@@ -652,340 +724,62 @@ void Volcano::createRenderPass()
 
 void Volcano::createDescriptorSetLayout()
 {
-    // Model View Uniform binding description
-    vk::DescriptorSetLayoutBinding vpLayoutBinding = {};
-    vpLayoutBinding.binding = 0;                                            // binding point in shaders
-    vpLayoutBinding.descriptorType = vk::DescriptorType::eUniformBuffer;    // descriptor type
-    vpLayoutBinding.descriptorCount = 1;                                    // just 1 struct of mvp
-    vpLayoutBinding.stageFlags = vk::ShaderStageFlagBits::eVertex;          // mvp struct bound in vertex shader
-    vpLayoutBinding.pImmutableSamplers = nullptr;
-    
-    /*
-    //Model binding info
-    vk::DescriptorSetLayoutBinding modelLayoutBinding = {};
-    modelLayoutBinding.binding = 1;                                         // binding 1 defined in vert shader
-    modelLayoutBinding.descriptorType = vk::DescriptorType::eUniformBufferDynamic;
-    modelLayoutBinding.descriptorCount = 1;
-    modelLayoutBinding.stageFlags = vk::ShaderStageFlagBits::eVertex;
-    modelLayoutBinding.pImmutableSamplers = nullptr;
-    */
-    
-    std::array<vk::DescriptorSetLayoutBinding, 1> bindings = {
-        vpLayoutBinding,
-        //modelLayoutBinding
-    };
+    // Bindings are read from shaders, so layout can't drift from them
+    // Bindings no stage uses are left out, and descriptors for them are never allocated or written
+    Volcano::shaderReflection = ShaderReflection::fromSpirv(shaders::load(VERTEX_SHADER_FILE));
+    Volcano::shaderReflection.merge(ShaderReflection::fromSpirv(shaders::load(FRAGMENT_SHADER_FILE)));
 
-    // create descriptor set layout with given binding
-    vk::DescriptorSetLayoutCreateInfo layoutCreateInfo = {};
-    layoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());     // just 1 binding for now
-    layoutCreateInfo.pBindings = bindings.data();                               // pointer to array of bindings
-    
-    // create descriptor set layout
-    try
-    {
-        Volcano::descriptorSetLayout = Volcano::device->createDescriptorSetLayout(layoutCreateInfo);
-    }
-    catch(vk::SystemError& err)
-    {
-        UNUSED(err);
-        throw std::runtime_error("Failed to create descriptor set layout");
-    }
+    // Everything is in set 0 (hidden set = 0 in shaders)
+    Volcano::descriptorSetLayout = Volcano::renderDevice->getLayoutCache().getDescriptorSetLayout(Volcano::shaderReflection.getSetBindings(0));
 }
 
-void Volcano::createPushConstantRange()
+void Volcano::createPipelineLayout()
 {
-    pushConstantRange.stageFlags = vk::ShaderStageFlagBits::eVertex;
-    pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(Model);
+    // Pipeline actual layout (layout of descriptor sets)
+    // Model matrices are read from storage buffer so recorded commands don't depend on them
+    Volcano::pipelineLayout = Volcano::renderDevice->getLayoutCache().getPipelineLayout({ Volcano::descriptorSetLayout },
+        Volcano::shaderReflection.getPushConstantRanges());
 }
 
 void Volcano::createGraphicsPipeline()
 {
-    // read compiled code
-    auto vsCode = utils::readFile("shaders/vert.spv");
-    auto fsCode = utils::readFile("shaders/frag.spv");
-
-    // create shader modules for pipeline
-    auto vertShaderModule = Volcano::createShaderModule(vsCode);
-    auto fragShaderModule = Volcano::createShaderModule(fsCode);
+    PipelineDescription description;
+    description.vertexShader = VERTEX_SHADER_FILE;
+    description.fragmentShader = FRAGMENT_SHADER_FILE;
 
-    // Pipeline info for 2 types of shaders
-    vk::PipelineShaderStageCreateInfo shaderStages[] = {
-        {
-            vk::PipelineShaderStageCreateFlags(),
-            vk::ShaderStageFlagBits::eVertex,       // Vertex shader
-            *vertShaderModule,                      // reference to module
-            "main"                                  // Start at main function
-        },
-        {
-            vk::PipelineShaderStageCreateFlags(),
-            vk::ShaderStageFlagBits::eFragment,     // Fragment shader
-            *fragShaderModule,
-            "main"
-        }
-    };
+    // Vertex inputs come from vertex shader, packed in location order. Vertex has to match
+    if (Volcano::shaderReflection.getVertexStride() != sizeof(Vertex))
+        throw std::runtime_error("Vertex shader inputs do not match Vertex layout");
 
     // Binding description data for single vertex as whole
     vk::VertexInputBindingDescription bindingDescription = {};
     bindingDescription.binding = 0;                                         // can bind multiple stream of data
     bindingDescription.stride = sizeof(Vertex);
     bindingDescription.inputRate = vk::VertexInputRate::eVertex;            // How to move between data after eavh vertex
+    description.vertexBindings.push_back(bindingDescription);
+    description.vertexAttributes = Volcano::shaderReflection.getVertexAttributes();
 
-    // How data for an attribute is defined within a vertex
-    std::array<vk::VertexInputAttributeDescription, 2> attributeDescriptions;
-
-    // position
-    attributeDescriptions[0].binding = 0;                                   // Which binding the data is at
-    attributeDescriptions[0].location = 0;                                  // Location in shader
-    attributeDescriptions[0].format = vk::Format::eR32G32B32Sfloat;         // Format the data will take
-    attributeDescriptions[0].offset = offsetof(Vertex, pos);                // offset of data in struct
-
-    attributeDescriptions[1].binding = 0;
-    attributeDescriptions[1].location = 1;
-    attributeDescriptions[1].format = vk::Format::eR32G32B32A32Sfloat;
-    attributeDescriptions[1].offset = offsetof(Vertex, col);
-
-    // Vertex inputs
-    vk::PipelineVertexInputStateCreateInfo vertexInputCreateInfo = {};
-    vertexInputCreateInfo.vertexBindingDescriptionCount = 1;
-    vertexInputCreateInfo.pVertexBindingDescriptions = &bindingDescription;                 // list of vertex bindings (data spacing/stride)
-    vertexInputCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-    vertexInputCreateInfo.pVertexAttributeDescriptions = attributeDescriptions.data();      // list of vertex attribute (data format and where/location)
-
-    // Input assembly
-    vk::PipelineInputAssemblyStateCreateInfo assemblyCreateInfo = {};
-    assemblyCreateInfo.topology = vk::PrimitiveTopology::eTriangleList;     // Primitive type to assembly vertex data to
-    assemblyCreateInfo.primitiveRestartEnable = VK_FALSE;                   // Allow overriding of strip topology
-
-    // Viewport and scissor
-    vk::Viewport viewport = {};                                             // Equivalent to glViewport()
-    viewport.x = 0.0f;                                                      // x start
-    viewport.y = 0.0f;                                                      // y start
-    viewport.width = static_cast<float>(Volcano::swapChainExtent.width);    // width
-    viewport.height = static_cast<float>(Volcano::swapChainExtent.height);  // height
-    viewport.minDepth = 0.0f;                                               // framebuffer depth
-    viewport.maxDepth = 1.0f;
-
-    vk::Rect2D scissor = {};
-    scissor.offset = vk::Offset2D(0, 0);
-    scissor.extent = Volcano::swapChainExtent;
-    
-    // save viewport and scissor data to viewport state
-    vk::PipelineViewportStateCreateInfo viewportStateInfo = {};
-    viewportStateInfo.viewportCount = 1;
-    viewportStateInfo.pViewports = &viewport;
-    viewportStateInfo.scissorCount = 1;
-    viewportStateInfo.pScissors = &scissor;
-
-    // Dynamic state
-    std::vector<vk::DynamicState> dynamicStateEnable = { 
-        vk::DynamicState::eViewport,                                        // Dynamic viewport can be resized with command buffer
-        vk::DynamicState::eScissor                                          // Resize with command buffer
-    };
-
-    vk::PipelineDynamicStateCreateInfo dynamicStateCreateInfo = {};         // Set dynamic state data
-    dynamicStateCreateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStateEnable.size());
-    dynamicStateCreateInfo.pDynamicStates = dynamicStateEnable.data();
-
-    // Rasterizer
-    // Convert primitive to fragment
-    vk::PipelineRasterizationStateCreateInfo rasterizerInfo = {};
-    rasterizerInfo.depthClampEnable = VK_FALSE;                                 // Clip things beyond near/far plane
-    rasterizerInfo.rasterizerDiscardEnable = VK_FALSE;                          // Wheather to create data or skip rasterizer
-    rasterizerInfo.polygonMode = vk::PolygonMode::eFill;                        // Fill entire polygon
-    rasterizerInfo.lineWidth = 1.0f;                                            // Line thickness (need gpu extension for line width other than 1)
-    rasterizerInfo.cullMode = vk::CullModeFlagBits::eBack;                      // Do not draw useless back face
-    rasterizerInfo.frontFace = vk::FrontFace::eCounterClockwise;                // Clockwise indices are front. Don't draw useless anti clockwise back face
-    rasterizerInfo.depthBiasEnable = VK_FALSE;                                  // true to overcome shadow acne
-
-    // Multisampling
-    vk::PipelineMultisampleStateCreateInfo multisampleInfo = {};
-    multisampleInfo.sampleShadingEnable = VK_FALSE;                             // Disable multisampling
-    multisampleInfo.rasterizationSamples = vk::SampleCountFlagBits::e1;         // Single sample (other value for amount of sample)
-
-    // How to handle color blending
-    vk::PipelineColorBlendAttachmentState colorBlendAttachment;
-    colorBlendAttachment.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | 
-                    vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
-    colorBlendAttachment.blendEnable = VK_TRUE;                                 // enable blending
-    // blending equation : (srcColorBlendFactor * newColour) colorBlendOp(dstBlendFactor * oldcolour)
-    // (srcAlpha * newColour) + (1-srcAlpha * oldColour)
-    
-    // Color blending
-    colorBlendAttachment.srcColorBlendFactor = vk::BlendFactor::eSrcAlpha;
-    colorBlendAttachment.dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha;
-    colorBlendAttachment.colorBlendOp = vk::BlendOp::eAdd;
-
-    // Alpha blending
-    // (1 * newAlpha) + (0 * oldAlpha)
-    colorBlendAttachment.srcAlphaBlendFactor = vk::BlendFactor::eOne;           // Do not blend alpha values
-    colorBlendAttachment.dstAlphaBlendFactor = vk::BlendFactor::eZero;
-    colorBlendAttachment.alphaBlendOp = vk::BlendOp::eAdd;
-    
-    // Blending
-    vk::PipelineColorBlendStateCreateInfo colorBlendCreateInfo = {};
-    colorBlendCreateInfo.logicOpEnable = VK_FALSE;                              // Mathamatical > logical
-    colorBlendCreateInfo.attachmentCount = 1;
-    colorBlendCreateInfo.pAttachments = &colorBlendAttachment;
-    
-    // Setting push constant range
-    Volcano::createPushConstantRange();
-
-    // Pipeline actual layout (layout of descriptor sets)
-    vk::PipelineLayoutCreateInfo pipelineLayoutInfo = {};
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = &Volcano::descriptorSetLayout;
-    pipelineLayoutInfo.pushConstantRangeCount = 1;
-    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
-
-    try 
-    {
-        Volcano::pipelineLayout = Volcano::device->createPipelineLayout(pipelineLayoutInfo);
-    }
-    catch(vk::SystemError& e)
-    {
-        UNUSED(e);
-        throw std::runtime_error("Failed to create pipleline layout");
-    }
-
-    // Depth stencil testing
-    vk::PipelineDepthStencilStateCreateInfo depthStencilCreateInfo = {};
-    depthStencilCreateInfo.depthTestEnable = VK_TRUE;                   // enable depth checking for fragment write
-    depthStencilCreateInfo.depthWriteEnable = VK_TRUE;                  // enable depth writing
-    depthStencilCreateInfo.depthCompareOp = vk::CompareOp::eLess;       // If new value is less then override value
-    depthStencilCreateInfo.depthBoundsTestEnable = VK_FALSE;            // Depth bound test -> does depth exist between given min and max bounds
-    depthStencilCreateInfo.stencilTestEnable = VK_FALSE;
-
-    // Graphics pipeline creation
-    vk::GraphicsPipelineCreateInfo pipelineInfo = {};
-    pipelineInfo.stageCount = 2;                        // 2 stage vertex and fragment shader
-    pipelineInfo.pStages = shaderStages;
-    pipelineInfo.pVertexInputState = &vertexInputCreateInfo;
-    pipelineInfo.pInputAssemblyState = &assemblyCreateInfo;
-    pipelineInfo.pViewportState = &viewportStateInfo;
-    pipelineInfo.pDynamicState = nullptr;
-    pipelineInfo.pRasterizationState = &rasterizerInfo;
-    pipelineInfo.pMultisampleState = &multisampleInfo;
-    pipelineInfo.pColorBlendState = &colorBlendCreateInfo;
-    pipelineInfo.pDepthStencilState = &depthStencilCreateInfo;
-    pipelineInfo.layout = Volcano::pipelineLayout;
-    pipelineInfo.renderPass = Volcano::renderPass;
-    pipelineInfo.subpass = 0;
-
-    // pipeline derivaties
-    pipelineInfo.basePipelineHandle = nullptr;          // Existing pipeline to derive from
-    pipelineInfo.basePipelineIndex = -1;                // index of existing pipeline
-
-    try
-    {
-        Volcano::graphicsPipeline = Volcano::device->createGraphicsPipeline(nullptr, pipelineInfo).value;
-    }
-    catch (const std::exception&)
-    {
-        throw std::runtime_error("Failed to create graphics pipeline");
-    }
+    // Fixed function state and specialization constants keep their defaults (untextured)
+    description.layout = Volcano::pipelineLayout;
+    description.renderPass = Volcano::renderPass;
+    description.subpass = 0;
 
-    // Unique shader modules automatically destroys after pipeline creation
+    // Meshes asking for DEFAULT_PIPELINE get this one. Compiled on worker thread
+    Volcano::defaultPipeline = Volcano::renderDevice->getPipelineRegistry().request(description);
 }
 
 void Volcano::createDepthBufferImage()
 {
-    Volcano::depthFormat = Volcano::chooseSupportedFormat(
+    Volcano::depthFormat = Volcano::renderDevice->chooseSupportedFormat(
         { vk::Format::eD32SfloatS8Uint, vk::Format::eD32Sfloat, vk::Format::eD24UnormS8Uint },
         vk::ImageTiling::eOptimal, 
         vk::FormatFeatureFlagBits::eDepthStencilAttachment
     );
 
-    Volcano::depthBufferImage = createImage(swapChainExtent.width, swapChainExtent.height, depthFormat, vk::ImageTiling::eOptimal,
+    Volcano::depthBufferImage = Volcano::renderDevice->createImage(swapChainExtent.width, swapChainExtent.height, depthFormat, vk::ImageTiling::eOptimal,
         vk::ImageUsageFlagBits::eDepthStencilAttachment, vk::MemoryPropertyFlagBits::eDeviceLocal, depthBufferMemory);
     
-    depthBufferImageView = createImageView(depthBufferImage, depthFormat, vk::ImageAspectFlagBits::eDepth);
-}
-
-vk::UniqueShaderModule Volcano::createShaderModule(const std::vector<char>& code)
-{
-    try 
-    {
-        vk::ShaderModuleCreateInfo shaderCreateInfo = vk::ShaderModuleCreateInfo(
-            vk::ShaderModuleCreateFlags(),
-            code.size(),
-            reinterpret_cast<const uint32_t*>(code.data())
-        );
-        return Volcano::device->createShaderModuleUnique(shaderCreateInfo);
-    }
-    catch(vk::SystemError& err)
-    {
-        UNUSED(err);
-        throw std::runtime_error("Failed to create shader module");
-    }
-}
-
-vk::Image Volcano::createImage(uint32_t width, uint32_t height, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags useFlags, vk::MemoryPropertyFlags propFlags, vk::DeviceMemory& imageMemory)
-{
-    // Create image
-    vk::ImageCreateInfo imageCreateInfo = {};
-    imageCreateInfo.imageType = vk::ImageType::e2D;
-    imageCreateInfo.extent.width = width;
-    imageCreateInfo.extent.height = height;
-    imageCreateInfo.extent.depth = 1;
-    imageCreateInfo.mipLevels = 1;
-    imageCreateInfo.arrayLayers = 1;                    // No of levels in image array
-    imageCreateInfo.format = format;
-    imageCreateInfo.tiling = tiling;
-    imageCreateInfo.initialLayout = vk::ImageLayout::eUndefined;
-    imageCreateInfo.usage = useFlags;
-    imageCreateInfo.samples = vk::SampleCountFlagBits::e1;
-    imageCreateInfo.sharingMode = vk::SharingMode::eExclusive;      // whetter image can be shared between queues
-    
-    vk::Image image;
-
-    try 
-    {
-        image = Volcano::device->createImage(imageCreateInfo);
-    }
-    catch (vk::SystemError& e)
-    {
-        throw std::runtime_error(e.what());
-    }
-
-    // Create Memory for image
-    vk::MemoryRequirements memRequirments = Volcano::device->getImageMemoryRequirements(image);
-
-    vk::MemoryAllocateInfo memoryAllocInfo = {};
-    memoryAllocInfo.allocationSize = memRequirments.size;
-    memoryAllocInfo.memoryTypeIndex = findMemoryTypeIndex(memRequirments.memoryTypeBits, propFlags);
-
-    try
-    {
-        imageMemory = Volcano::device->allocateMemory(memoryAllocInfo);
-    }
-    catch (const vk::SystemError& e)
-    {
-        throw std::runtime_error("Failed to allocate memory: " + std::string(e.what()));
-    }
-
-    Volcano::device->bindImageMemory(image, imageMemory, 0);
-
-    return image;
-}
-
-vk::Format Volcano::chooseSupportedFormat(const std::vector<vk::Format>& formats, const vk::ImageTiling& tiling, const vk::FormatFeatureFlags& featureFlags)
-{
-    for (const vk::Format& format: formats) 
-    {
-        vk::FormatProperties properties = Volcano::physicalDevice.getFormatProperties(format);
-
-        if (tiling == vk::ImageTiling::eLinear && (properties.linearTilingFeatures & featureFlags) == featureFlags)
-        {
-            return format;
-        }
-        else if (tiling == vk::ImageTiling::eOptimal && (properties.optimalTilingFeatures & featureFlags) == featureFlags)
-        {
-            return format;
-        }
-    }
-
-    throw std::runtime_error("Failed to find matching format");
+    depthBufferImageView = Volcano::renderDevice->createImageView(depthBufferImage, depthFormat, vk::ImageAspectFlagBits::eDepth);
 }
 
 void Volcano::createFramebuffers()
@@ -1011,7 +805,7 @@ void Volcano::createFramebuffers()
 
         try
         {
-            Volcano::swapChainFramebuffers[i] = Volcano::device->createFramebuffer(framebufferCreateInfo);
+            Volcano::swapChainFramebuffers[i] = Volcano::device.createFramebuffer(framebufferCreateInfo);
         }
         catch(vk::SystemError& e)
         {
@@ -1023,16 +817,27 @@ void Volcano::createFramebuffers()
 
 void Volcano::createCommandPool()
 {
-    QueueFamilyIndicies queueFamilyIndices = Volcano::findQueueFamily(Volcano::physicalDevice);
+    const QueueFamilyIndicies& queueFamilyIndices = Volcano::renderDevice->getQueueFamilies();
+    uint32_t slotCount = Volcano::renderDevice->getRecordThreadPool().getThreadCount() + 1;
 
     vk::CommandPoolCreateInfo poolInfo = {};
-    poolInfo.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;        // Allow reseting command buffer to update push constant
+    poolInfo.flags = vk::CommandPoolCreateFlagBits::eTransient;                 // Primary is re-recorded every frame
     poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();      // Queue family type that command buffer will use
 
-    // Create graphocs queue family command pool
+    vk::CommandPoolCreateInfo secondaryPoolInfo = {};
+    secondaryPoolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+
+    // Pool for primary of each frame plus one per frame and recording thread. Pools are not thread safe
     try
     {
-        Volcano::graphicsCommandPool = Volcano::device->createCommandPool(poolInfo);
+        for (auto& frame : Volcano::frames)
+        {
+            frame.commandPool = Volcano::device.createCommandPool(poolInfo);
+
+            frame.secondaryCommandPools.resize(slotCount);
+            for (auto& pool : frame.secondaryCommandPools)
+                pool = Volcano::device.createCommandPool(secondaryPoolInfo);
+        }
     }
     catch(vk::SystemError& e)
     {
@@ -1041,28 +846,65 @@ void Volcano::createCommandPool()
     }
 }
 
+void Volcano::createIndirectBuffer()
+{
+    // Written by cpu when draws of frame are recorded
+    Volcano::indirectBuffer.init(Volcano::renderDevice->getAllocator(), Volcano::device, sizeof(vk::DrawIndexedIndirectCommand) * MAX_OBJECTS,
+        Volcano::framesInFlight, vk::BufferUsageFlagBits::eIndirectBuffer, sizeof(vk::DrawIndexedIndirectCommand));
+}
+
 void Volcano::createCommandBuffer()
 {
-    Volcano::commandBuffers.resize(Volcano::swapChainFramebuffers.size());
-    
     vk::CommandBufferAllocateInfo cbAllocInfo = {};
-    cbAllocInfo.commandPool = Volcano::graphicsCommandPool;
     cbAllocInfo.level = vk::CommandBufferLevel::ePrimary;                       // Buffer directly submit to queue. Can't be called by other buffers
-    cbAllocInfo.commandBufferCount = static_cast<uint32_t>(Volcano::commandBuffers.size());
+    cbAllocInfo.commandBufferCount = 1;
+
+    vk::CommandBufferAllocateInfo secondaryAllocInfo = {};
+    secondaryAllocInfo.level = vk::CommandBufferLevel::eSecondary;              // Executed from primary inside render pass
+    secondaryAllocInfo.commandBufferCount = 1;
 
     // allocate command buffer
-    vk::Result result = Volcano::device->allocateCommandBuffers(&cbAllocInfo, Volcano::commandBuffers.data());
-    if(result != vk::Result::eSuccess)
+    try
+    {
+        for (auto& frame : Volcano::frames)
+        {
+            cbAllocInfo.commandPool = frame.commandPool;
+            frame.commandBuffer = Volcano::device.allocateCommandBuffers(cbAllocInfo)[0];
+
+            frame.secondaryCommandBuffers.resize(frame.secondaryCommandPools.size());
+            for (size_t slot = 0; slot < frame.secondaryCommandPools.size(); ++slot)
+            {
+                secondaryAllocInfo.commandPool = frame.secondaryCommandPools[slot];
+                frame.secondaryCommandBuffers[slot] = Volcano::device.allocateCommandBuffers(secondaryAllocInfo)[0];
+            }
+        }
+    }
+    catch(vk::SystemError& e)
+    {
+        UNUSED(e);
         throw std::runtime_error("Failed to allocate command buffers");
+    }
+
+    Volcano::markCommandBuffersDirty();
+    Volcano::imagesInFlight.assign(Volcano::swapChainImages.size(), vk::Fence());
 }
 
-void Volcano::recordCommands(uint32_t currentImage)
+void Volcano::markCommandBuffersDirty()
 {
+    for (auto& frame : Volcano::frames)
+        frame.drawsDirty = true;
+}
+
+void Volcano::recordCommands(uint32_t imageIndex)
+{
+    VOLCANO_PROFILE_SCOPE("recordCommands");
+    FrameContext& frame = Volcano::frames[currentFrame];
+
+    // Primary is recorded every frame, only secondaries are cached. It holds a handful of commands but also
+    // framebuffer of acquired image, query reset of frame and optional readback, which change from frame to frame
     // Info about how to begin each command buffer
-    
     vk::CommandBufferBeginInfo bufferBeginInfo = {};
-    // No longer needed because of fences
-    //bufferBeginInfo.flags = vk::CommandBufferUsageFlagBits::eSimultaneousUse;     // Buffer submit whem already submmited and awaiting execution
+    bufferBeginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
 
     // Info about how to begin render pass (only for graphics)
     vk::RenderPassBeginInfo renderPassBeginInfo = {};
@@ -1077,183 +919,284 @@ void Volcano::recordCommands(uint32_t currentImage)
 
     renderPassBeginInfo.pClearValues = clearValues.data();                             // List of clear values (list because might add depth later)
     renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+    renderPassBeginInfo.framebuffer = Volcano::swapChainFramebuffers[imageIndex];
 
-    //for(size_t i = 0; i < Volcano::commandBuffers.size(); ++i)
-    //{
-        renderPassBeginInfo.framebuffer = Volcano::swapChainFramebuffers[currentImage];
+    vk::CommandBuffer commandBuffer = frame.commandBuffer;
 
-        try
-        {
-            Volcano::commandBuffers[currentImage].begin(bufferBeginInfo);                  // Begin recording
-        }
-        catch(const vk::SystemError& e)
-        {
-            UNUSED(e);
-            throw std::runtime_error("Failed to begin recording command buffer");
-        }
+    try
+    {
+        // Fence of frame has signaled, so primary of last use can be thrown away
+        Volcano::device.resetCommandPool(frame.commandPool, vk::CommandPoolResetFlags());
+        commandBuffer.begin(bufferBeginInfo);                                   // Begin recording
+    }
+    catch(const vk::SystemError& e)
+    {
+        UNUSED(e);
+        throw std::runtime_error("Failed to begin recording command buffer");
+    }
 
+    {
+        // Render pass contents come from secondary command buffers only
+        Volcano::gpuProfiler.beginPass(commandBuffer, currentFrame);
+        commandBuffer.beginRenderPass(renderPassBeginInfo, vk::SubpassContents::eSecondaryCommandBuffers);
+        if (frame.secondaryCount > 0)
+            commandBuffer.executeCommands(frame.secondaryCount, frame.secondaryCommandBuffers.data());
+        commandBuffer.endRenderPass();
+        Volcano::gpuProfiler.endPass(commandBuffer, currentFrame);
+
+        // Target is in transfer src layout now and render pass made its writes visible to transfers
+        if (Volcano::nextReadback)
         {
-            Volcano::commandBuffers[currentImage].beginRenderPass(renderPassBeginInfo, vk::SubpassContents::eInline);
-            
-            {
-                // bind pipeline to be used in command buffer
-                Volcano::commandBuffers[currentImage].bindPipeline(vk::PipelineBindPoint::eGraphics, Volcano::graphicsPipeline);
-               
-                for(size_t j = 0; j < meshList.size(); ++j)
-                {
-                    // Bind vertex buffer
-                    vk::Buffer vertexBuffer[] = { meshList[j]->getVertexBuffer() };             // list of buffer to bind
-                    vk::DeviceSize offsets[] = { 0 };                                           // list of offsets
-                    Volcano::commandBuffers[currentImage].bindVertexBuffers(0, 1, vertexBuffer, offsets);  // bind buffer before drawing
-                
-                    // Bind index buffer
-                    Volcano::commandBuffers[currentImage].bindIndexBuffer(meshList[j]->getIndexBuffer(), 0, vk::IndexType::eUint32);
-                
-                    // Dynamic offset amount
-                    // std::array<uint32_t, 1> dynamicOffsets = {
-                    //    static_cast<uint32_t>(modelUniformAlignment) * j
-                    // };
-                    //uint32_t dynamicOffset = static_cast<uint32_t>(modelUniformAlignment) * j;
-
-                    Volcano::commandBuffers[currentImage].pushConstants(pipelineLayout, vk::ShaderStageFlagBits::eVertex, 0 /* Offset of data*/, sizeof(Model), &meshList[j]->getModel());
-
-                    // bind descriptor sets
-                    Volcano::commandBuffers[currentImage].bindDescriptorSets(vk::PipelineBindPoint::eGraphics, Volcano::pipelineLayout, 0,
-                        Volcano::descriptorSets[currentImage], nullptr);
-
-                    // Execute pipline
-                    Volcano::commandBuffers[currentImage].drawIndexed(static_cast<uint32_t>(meshList[j]->getIndexCount()), 1, 0, 0, 0);
-                }
-            }
-            Volcano::commandBuffers[currentImage].endRenderPass();
-        }
-        
-        try
-        {
-            Volcano::commandBuffers[currentImage].end();                                   // End recording
-        }
-        catch(vk::SystemError& e)
-        {
-            UNUSED(e);
-            throw std::runtime_error("Failed to end recording command buffer");
+            Volcano::frameReadback.record(commandBuffer, currentFrame, Volcano::swapChainImages[imageIndex].image,
+                Volcano::frameNumber, std::move(Volcano::nextReadback));
+            Volcano::nextReadback = nullptr;
         }
-    //}
+    }
+    
+    try
+    {
+        commandBuffer.end();                                                    // End recording
+    }
+    catch(vk::SystemError& e)
+    {
+        UNUSED(e);
+        throw std::runtime_error("Failed to end recording command buffer");
+    }
 }
 
-void Volcano::createSynchronization()
+void Volcano::recordDraws(uint32_t frameIndex)
 {
-    Volcano::imageAvailable.resize(MAX_FRAME_DRAWS);
-    Volcano::renderFinished.resize(MAX_FRAME_DRAWS);
-    Volcano::drawFences.resize(MAX_FRAME_DRAWS);
-
-    // Semaphore creation info
-    vk::SemaphoreCreateInfo semaphoreCreateInfo = {};                           // Only deafault struct type is required
-
-    // Fence create info
-    vk::FenceCreateInfo fenceInfo = {};
-    fenceInfo.flags = vk::FenceCreateFlagBits::eSignaled;
-
-    try 
-    {
-        for (int i = 0; i < MAX_FRAME_DRAWS; ++i)
+    VOLCANO_PROFILE_SCOPE("recordDraws");
+    FrameContext& frame = Volcano::frames[frameIndex];
+
+    if (Volcano::meshList.size() > MAX_OBJECTS)
+        throw std::runtime_error("Too many objects in scene");
+
+    // Draws are grouped by pipeline, so each pipeline is bound once per chunk
+    std::vector<size_t> order(Volcano::meshList.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        return Volcano::meshList[a]->getPipeline() < Volcano::meshList[b]->getPipeline();
+    });
+
+    // Draw parameters of every mesh. Instance index selects model matrix of instance
+    // Meshes whose pipeline is still compiling (or failed) are left out. Frame is recorded again while compiles are pending
+    vk::DrawIndexedIndirectCommand* commands = Volcano::indirectBuffer.get<vk::DrawIndexedIndirectCommand>(frameIndex);
+    frame.drawPipelines.clear();
+    bool complete = true;
+    bool ready = false;
+    std::optional<PipelineId> checkedPipeline;
+    for (size_t j : order)
+    {
+        const auto& mesh = Volcano::meshList[j];
+
+        // Sorted, so readiness is looked up once per pipeline
+        if (checkedPipeline != mesh->getPipeline())
         {
-            Volcano::imageAvailable[i] = Volcano::device->createSemaphore(semaphoreCreateInfo);
-            Volcano::renderFinished[i] = Volcano::device->createSemaphore(semaphoreCreateInfo);
-            Volcano::drawFences[i] = Volcano::device->createFence(fenceInfo);
+            checkedPipeline = mesh->getPipeline();
+            ready = Volcano::renderDevice->getPipelineRegistry().isReady(*checkedPipeline);
+            // Failed pipelines are skipped for good. Recording again would not bring them back
+            complete = complete && (ready || Volcano::renderDevice->getPipelineRegistry().hasFailed(*checkedPipeline));
+        }
+        if (!ready)
+            continue;
+
+        vk::DrawIndexedIndirectCommand& command = commands[frame.drawPipelines.size()];
+        command.indexCount = static_cast<uint32_t>(mesh->getIndexCount());
+        command.instanceCount = mesh->getInstanceCount();
+        command.firstIndex = mesh->getFirstIndex();
+        command.vertexOffset = static_cast<int32_t>(mesh->getVertexOffset());
+        command.firstInstance = mesh->getFirstInstance();
+        frame.drawPipelines.push_back(mesh->getPipeline());
+    }
+    size_t drawCount = frame.drawPipelines.size();
+    Volcano::indirectBuffer.flush(frameIndex, 0, sizeof(vk::DrawIndexedIndirectCommand) * drawCount);
+
+    // Split draw list into chunks. Small lists are not worth the overhead of going wide
+    // Indirect draws cost one call per pipeline group for any draw count, so with multiDrawIndirect
+    // (most desktop gpus) everything goes in one chunk and only devices without it record in parallel
+    size_t maxChunks = Volcano::renderDevice->supportsMultiDrawIndirect() ? 1 : frame.secondaryCommandBuffers.size();
+    size_t chunkCount = std::min(maxChunks, (drawCount + MIN_DRAWS_PER_RECORD_THREAD - 1) / MIN_DRAWS_PER_RECORD_THREAD);
+    size_t chunkSize = chunkCount > 0 ? (drawCount + chunkCount - 1) / chunkCount : 0;
+
+    // Timed draw groups are numbered across chunks, so every chunk gets its first group up front
+    std::vector<uint32_t> firstGroups(chunkCount, 0);
+    std::vector<PipelineId> groupPipelines;
+    if (Volcano::gpuProfiler.isDrawGroupTiming())
+    {
+        for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+        {
+            firstGroups[chunk] = static_cast<uint32_t>(groupPipelines.size());
+            size_t last = std::min(drawCount, (chunk + 1) * chunkSize);
+            for (size_t j = chunk * chunkSize; j < last; ++j)
+            {
+                if (j == chunk * chunkSize || frame.drawPipelines[j] != frame.drawPipelines[j - 1])
+                    groupPipelines.push_back(frame.drawPipelines[j]);
+            }
         }
     }
-    catch(vk::SystemError& e)
+    Volcano::gpuProfiler.setDrawGroups(frameIndex, std::move(groupPipelines));
+
+    // Chunk 0 is recorded on calling thread, rest on workers
+    std::vector<std::future<void>> jobs;
+    for (size_t chunk = 1; chunk < chunkCount; ++chunk)
     {
-        UNUSED(e);
-        throw std::runtime_error("Failed to create semaphore/fences");
+        size_t first = chunk * chunkSize;
+        size_t last = std::min(drawCount, first + chunkSize);
+        uint32_t firstGroup = firstGroups[chunk];
+        jobs.push_back(Volcano::renderDevice->getRecordThreadPool().submit([=]() {
+            Volcano::recordSecondaryCommands(frameIndex, static_cast<uint32_t>(chunk), first, last, firstGroup);
+        }));
     }
+    if (chunkCount > 0)
+        Volcano::recordSecondaryCommands(frameIndex, 0, 0, std::min(drawCount, chunkSize), firstGroups[0]);
+
+    // Rethrows recording errors of workers
+    for (auto& job : jobs)
+        job.get();
+
+    frame.secondaryCount = static_cast<uint32_t>(chunkCount);
+    frame.drawsDirty = !complete;
 }
 
-void Volcano::createBuffer(vk::DeviceSize bufferSize, vk::BufferUsageFlags bufferUsageFlags, 
-                vk::MemoryPropertyFlags bufferProperties, vk::Buffer& buffer, vk::DeviceMemory& bufferMemory)
+void Volcano::recordSecondaryCommands(uint32_t frameIndex, uint32_t chunk, size_t firstDraw, size_t lastDraw, uint32_t firstGroup)
 {
-    vk::BufferCreateInfo bufferInfo = {};
-    bufferInfo.size = bufferSize;
-    bufferInfo.usage = bufferUsageFlags;
-    bufferInfo.sharingMode = vk::SharingMode::eExclusive;
+    VOLCANO_PROFILE_SCOPE("recordSecondaryCommands");
+    FrameContext& frame = Volcano::frames[frameIndex];
 
-    try 
+    // Every chunk has own pool so workers never share a pool
+    vk::CommandBuffer commandBuffer = frame.secondaryCommandBuffers[chunk];
+
+    // Secondary buffer runs inside render pass of primary
+    // Framebuffer is left out so same secondary can be executed for any swapchain image
+    vk::CommandBufferInheritanceInfo inheritanceInfo = {};
+    inheritanceInfo.renderPass = Volcano::renderPass;
+    inheritanceInfo.subpass = 0;
+
+    vk::CommandBufferBeginInfo bufferBeginInfo = {};
+    bufferBeginInfo.flags = vk::CommandBufferUsageFlagBits::eRenderPassContinue;
+    bufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    try
     {
-        buffer = Volcano::device->createBuffer(bufferInfo);
+        // Resetting whole pool is cheaper than resetting single buffers
+        Volcano::device.resetCommandPool(frame.secondaryCommandPools[chunk], vk::CommandPoolResetFlags());
+        commandBuffer.begin(bufferBeginInfo);
     }
-    catch(vk::SystemError& e)
+    catch(const vk::SystemError& e)
     {
         UNUSED(e);
-        throw std::runtime_error("Failed to create vertex buffer");
+        throw std::runtime_error("Failed to begin recording secondary command buffer");
     }
 
-    vk::MemoryRequirements memRequirements = {};
-    memRequirements = Volcano::device->getBufferMemoryRequirements(buffer);
+    // State is not inherited from primary, so every secondary sets its own
+    // Dynamic viewport and scissor cover whole swapchain image
+    vk::Viewport viewport = {};                                                     // Equivalent to glViewport()
+    viewport.x = 0.0f;                                                              // x start
+    viewport.y = 0.0f;                                                              // y start
+    viewport.width = static_cast<float>(Volcano::swapChainExtent.width);            // width
+    viewport.height = static_cast<float>(Volcano::swapChainExtent.height);          // height
+    viewport.minDepth = 0.0f;                                                       // framebuffer depth
+    viewport.maxDepth = 1.0f;
+    commandBuffer.setViewport(0, viewport);
 
-    vk::MemoryAllocateInfo memAllocInfo = {};
-    memAllocInfo.allocationSize = memRequirements.size;
+    vk::Rect2D scissor = {};
+    scissor.offset = vk::Offset2D(0, 0);
+    scissor.extent = Volcano::swapChainExtent;
+    commandBuffer.setScissor(0, scissor);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, Volcano::pipelineLayout, 0,
+        frame.descriptorSet, nullptr);
+
+    // Every mesh lives in geometry arena, so buffers are bound once
+    vk::Buffer vertexBuffer[] = { Volcano::renderDevice->getGeometryArena().getVertexBuffer() };       // list of buffer to bind
+    vk::DeviceSize offsets[] = { 0 };                                               // list of offsets
+    commandBuffer.bindVertexBuffers(0, 1, vertexBuffer, offsets);                   // bind buffer before drawing
+    commandBuffer.bindIndexBuffer(Volcano::renderDevice->getGeometryArena().getIndexBuffer(), 0, vk::IndexType::eUint32);
+
+    // Pipelines of chunk are all ready (and did not fail), checked in recordDraws
+    bool timeGroups = Volcano::gpuProfiler.isDrawGroupTiming();
+    uint32_t group = firstGroup;
+    for (size_t groupFirst = firstDraw; groupFirst < lastDraw; ++group)
+    {
+        // Draws using same pipeline are next to each other
+        PipelineId pipeline = frame.drawPipelines[groupFirst];
+        size_t groupLast = groupFirst + 1;
+        while (groupLast < lastDraw && frame.drawPipelines[groupLast] == pipeline)
+            ++groupLast;
+
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, Volcano::renderDevice->getPipelineRegistry().get(pipeline));
+        if (timeGroups)
+            Volcano::gpuProfiler.beginDrawGroup(commandBuffer, frameIndex, group);
+
+        if (Volcano::renderDevice->supportsMultiDrawIndirect())
+        {
+            // Whole group in as few calls as device limit allows
+            constexpr uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+            for (size_t first = groupFirst; first < groupLast; first += Volcano::renderDevice->getMaxDrawIndirectCount())
+            {
+                uint32_t count = static_cast<uint32_t>(std::min<size_t>(groupLast - first, Volcano::renderDevice->getMaxDrawIndirectCount()));
+                commandBuffer.drawIndexedIndirect(Volcano::indirectBuffer.getBuffer(), Volcano::indirectBuffer.getOffset(frameIndex) + first * stride, count, stride);
+            }
+        }
+        else
+        {
+            for (size_t j = groupFirst; j < groupLast; ++j)
+            {
+                // Execute pipline
+                // All instances of mesh in one draw. Instance index selects model matrix in model storage buffer
+                const vk::DrawIndexedIndirectCommand& command = Volcano::indirectBuffer.get<vk::DrawIndexedIndirectCommand>(frameIndex)[j];
+                commandBuffer.drawIndexed(command.indexCount, command.instanceCount, command.firstIndex, command.vertexOffset, command.firstInstance);
+            }
+        }
 
-    // Host visible bit -> cpu can interact
-    // Conherant bit -> allows placement of data straight into buffer after mapping 
-    memAllocInfo.memoryTypeIndex = findMemoryTypeIndex(memRequirements.memoryTypeBits, bufferProperties);
-    
-    try 
+        if (timeGroups)
+            Volcano::gpuProfiler.endDrawGroup(commandBuffer, frameIndex, group);
+        groupFirst = groupLast;
+    }
+
+    try
     {
-        // Allocate to device memory
-        bufferMemory = Volcano::device->allocateMemory(memAllocInfo);
+        commandBuffer.end();
     }
     catch(vk::SystemError& e)
     {
         UNUSED(e);
-        throw std::runtime_error("Failed to allocate memory");
+        throw std::runtime_error("Failed to end recording secondary command buffer");
     }
-
-    // Allocate mem to vertex buffer
-    Volcano::device->bindBufferMemory(buffer, bufferMemory, 0);
- 
 }
 
-uint32_t Volcano::findMemoryTypeIndex(uint32_t allowedTypes, vk::MemoryPropertyFlags properties)
+void Volcano::createSynchronization()
 {
-    vk::PhysicalDeviceMemoryProperties memProperties;
-    memProperties = Volcano::physicalDevice.getMemoryProperties();
+    // Semaphore creation info
+    vk::SemaphoreCreateInfo semaphoreCreateInfo = {};                           // Only deafault struct type is required
+
+    // Fence create info
+    vk::FenceCreateInfo fenceInfo = {};
+    fenceInfo.flags = vk::FenceCreateFlagBits::eSignaled;
 
-    for(uint32_t i = 0; i < memProperties.memoryTypeCount; ++i)
+    try 
     {
-        if((allowedTypes & (1 << i)) && memProperties.memoryTypes[i].propertyFlags & properties)
+        for (auto& frame : Volcano::frames)
         {
-            // Memory type is valid so return it
-            return i;
+            frame.imageAvailable = Volcano::device.createSemaphore(semaphoreCreateInfo);
+            frame.renderFinished = Volcano::device.createSemaphore(semaphoreCreateInfo);
+            frame.fence = Volcano::device.createFence(fenceInfo);
         }
     }
-
-    return 0;
-}
-
-void Volcano::copyBuffer(vk::Buffer& src, vk::Buffer& dst, vk::DeviceSize bufferSize)
-{
-    vk::CommandBuffer transferCommandBuffer = Volcano::beginCopyBuffer(Volcano::graphicsCommandPool);
-
+    catch(vk::SystemError& e)
     {
-        // Region of data to copy from into
-        vk::BufferCopy bufferCopyRegion = {};
-        bufferCopyRegion.srcOffset = 0;
-        bufferCopyRegion.dstOffset = 0;
-        bufferCopyRegion.size = bufferSize;
-
-        transferCommandBuffer.copyBuffer(src, dst, bufferCopyRegion);
+        UNUSED(e);
+        throw std::runtime_error("Failed to create semaphore/fences");
     }
- 
-    Volcano::endCopyBuffer(Volcano::graphicsCommandPool, Volcano::graphicsQueue, transferCommandBuffer);
 }
 
-void Volcano::copyImageBuffer(vk::Buffer& src, vk::Image& image, uint32_t width, uint32_t height)
+void Volcano::copyImageBuffer(vk::Buffer& src, vk::Image& image, uint32_t width, uint32_t height, vk::DeviceSize srcOffset)
 {
-    vk::CommandBuffer transferCommandBuffer = Volcano::beginCopyBuffer(Volcano::graphicsCommandPool);
+    vk::CommandBuffer transferCommandBuffer = Volcano::renderDevice->getUploadContext().getCommandBuffer();
 
     {
         vk::BufferImageCopy imageRegion = {};
-        imageRegion.bufferOffset = 0;
+        imageRegion.bufferOffset = srcOffset;
         imageRegion.bufferRowLength = 0;                // row lenght for data spacing
         imageRegion.bufferImageHeight = 0;              // row height for image data spacing
         imageRegion.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
@@ -1265,142 +1208,167 @@ void Volcano::copyImageBuffer(vk::Buffer& src, vk::Image& image, uint32_t width,
 
         transferCommandBuffer.copyBufferToImage(src, image, vk::ImageLayout::eTransferDstOptimal, imageRegion);
     }
-
-    Volcano::endCopyBuffer(Volcano::graphicsCommandPool, Volcano::graphicsQueue, transferCommandBuffer);
 }
 
-vk::CommandBuffer Volcano::beginCopyBuffer(vk::CommandPool& commandPool)
+void Volcano::recreateSwapChain() 
 {
-    // Command Buffer to hold transfer commands
-    vk::CommandBuffer transferCommandBuffer;
+    int width = 0, height = 0;
+    glfwGetFramebufferSize(window->getWindow(), &width, &height);
 
-    // command buffer details
-    vk::CommandBufferAllocateInfo allocInfo = {};
-    allocInfo.level = vk::CommandBufferLevel::ePrimary;
-    allocInfo.commandPool = commandPool;       // graphics command pool is same as transfer command pool
-    allocInfo.commandBufferCount = 1;
+    // Minimized. draw skips frames till window is restored and tries again
+    if(width == 0 || height == 0)
+    {
+        Volcano::window->getFramebufferResized() = true;
+        return;
+    }
 
-    // Allocate command buffer from pool
-    transferCommandBuffer = Volcano::device->allocateCommandBuffers(allocInfo)[0];
+    // No device wait. Old objects are destroyed once frames still rendering to them have finished
+    // Only size dependent objects are recreated. Pipeline uses dynamic viewport and scissor
+    vk::Format oldImageFormat = Volcano::swapChainImageFormat;
+    Volcano::retireSwapChain();
 
-    // Info to begin command buffer
-    vk::CommandBufferBeginInfo beginInfo = {};
-    beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+    Volcano::createSwapChain();
+    Volcano::createDepthBufferImage();
 
-    transferCommandBuffer.begin(beginInfo);
+    // Render pass (and pipeline made for it) only depend on formats, which rarely change
+    if (Volcano::swapChainImageFormat != oldImageFormat)
+    {
+        // Recorded draws of frames in flight use pipeline. Rare enough to drain the queue
+        // Layout does not depend on render pass and is kept
+        Volcano::waitForFrames();
+        vk::RenderPass oldRenderPass = Volcano::renderPass;
 
-    return transferCommandBuffer;
-}
+        // Pipeline ids held by meshes stay valid
+        Volcano::createRenderPass();
+        Volcano::renderDevice->getPipelineRegistry().rebuild(oldRenderPass, Volcano::renderPass);
+        Volcano::device.destroyRenderPass(oldRenderPass);
+    }
+    Volcano::createFramebuffers();
 
-void Volcano::endCopyBuffer(vk::CommandPool& commandPool, vk::Queue& queue, vk::CommandBuffer& transferCommandBuffer)
-{
-    transferCommandBuffer.end();
+    mvp.proj = glm::perspective(glm::radians(45.0f), (float) Volcano::swapChainExtent.width / (float) Volcano::swapChainExtent.height, 0.1f, 100.0f);
+    mvp.proj[1][1] *= -1;
 
-    // Queue submit info
-    vk::SubmitInfo submitInfo = {};
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &transferCommandBuffer;
+    // Command buffers belong to frames and survive. Recorded viewport is of old size though
+    Volcano::markCommandBuffersDirty();
+    Volcano::imagesInFlight.assign(Volcano::swapChainImages.size(), vk::Fence());
+}
 
-    // Submit transfer command to transfer queue and wait till it finish
-    // Graphics queue is same as transfer queue
-    queue.submit(submitInfo);
-    queue.waitIdle();
+void Volcano::retireSwapChain()
+{
+    // Swapchain handle stays current so it can be passed as oldSwapchain
+    RetiredSwapChain retired;
+    retired.swapChain = Volcano::swapChain;
+    retired.images = std::move(Volcano::swapChainImages);
+    retired.framebuffers = std::move(Volcano::swapChainFramebuffers);
+    retired.depthImage = Volcano::depthBufferImage;
+    retired.depthMemory = Volcano::depthBufferMemory;
+    retired.depthImageView = Volcano::depthBufferImageView;
+    retired.retireFrame = Volcano::frameNumber;
+
+    Volcano::swapChainImages.clear();
+    Volcano::swapChainFramebuffers.clear();
+    Volcano::retiredSwapChains.push_back(std::move(retired));
+}
 
-    // Free command buffer back to pool
-    Volcano::device->freeCommandBuffers(commandPool, transferCommandBuffer);
+void Volcano::releaseRetiredSwapChains(uint64_t completedFrames)
+{
+    // Retired in order, so oldest ones are released first
+    auto it = Volcano::retiredSwapChains.begin();
+    while (it != Volcano::retiredSwapChains.end() && it->retireFrame <= completedFrames)
+    {
+        Volcano::cleanupSwapChain(*it);
+        it = Volcano::retiredSwapChains.erase(it);
+    }
 }
 
-void Volcano::recreateSwapChain() 
+void Volcano::cleanupSwapChain(RetiredSwapChain& retired)
 {
-    int width = 0, height = 0;
-    glfwGetFramebufferSize(window->getWindow(), &width, &height);
+    // Destroy all objects depended by swapchain first
+    for(auto& framebuffer: retired.framebuffers)
+        Volcano::device.destroyFramebuffer(framebuffer);
 
-    while(width == 0 || height == 0)
+    Volcano::device.destroyImageView(retired.depthImageView);
+    Volcano::device.destroyImage(retired.depthImage);
+    Volcano::renderDevice->getAllocator().free(retired.depthMemory);
+
+    for(auto& image: retired.images)
     {
-        glfwGetFramebufferSize(window->getWindow(), &width, &height);
-        glfwWaitEvents();
+        Volcano::device.destroyImageView(image.imageView);
+        // Offscreen targets only. Swapchain images go with swapchain
+        if (image.memory.block)
+        {
+            Volcano::device.destroyImage(image.image);
+            Volcano::renderDevice->getAllocator().free(image.memory);
+        }
     }
 
-    Volcano::device->waitIdle();
-   
-    Volcano::cleanupSwapChain();
-
-    Volcano::createSwapChain();
-    Volcano::createRenderPass();
-    Volcano::createGraphicsPipeline();
-    Volcano::createFramebuffers();
-    //Volcano::createCommandPool();
-    Volcano::createCommandBuffer();
-    //Volcano::recordCommands();    
+    // Headless has no swapchain (and no swapchain extension to destroy one with)
+    if (retired.swapChain)
+        Volcano::device.destroySwapchainKHR(retired.swapChain);
 }
 
-void Volcano::cleanupSwapChain()
+void Volcano::createUniformBuffer() 
 {
-    // Destroy all objects depended by swapchain first
-    for(auto& framebuffer: Volcano::swapChainFramebuffers)
-        Volcano::device->destroyFramebuffer(framebuffer);
+    vk::PhysicalDeviceLimits limits = Volcano::physicalDevice.getProperties().limits;
+
+    // One view projection region for each frame in flight. Mapped once and rewritten every frame
+    Volcano::vpUniformBuffer.init(Volcano::renderDevice->getAllocator(), Volcano::device, sizeof(UBOViewProj),
+        Volcano::framesInFlight, vk::BufferUsageFlagBits::eUniformBuffer, limits.minUniformBufferOffsetAlignment);
 
-    Volcano::device->freeCommandBuffers(Volcano::graphicsCommandPool, Volcano::commandBuffers);
-    Volcano::device->destroyPipeline(Volcano::graphicsPipeline);
-    Volcano::device->destroyPipelineLayout(Volcano::pipelineLayout);
-    Volcano::device->destroyRenderPass(Volcano::renderPass);
-    for(auto& imageView: Volcano::swapChainImages)
-        Volcano::device->destroyImageView(imageView.imageView);
+    // Model matrices are written by cpu straight into mapped memory, no copies in between. Slot for each frame in flight
+    Volcano::transformBuffer.init(Volcano::renderDevice->getAllocator(), Volcano::device, sizeof(Model) * MAX_INSTANCES,
+        Volcano::framesInFlight, vk::BufferUsageFlagBits::eStorageBuffer, std::max<vk::DeviceSize>(limits.minStorageBufferOffsetAlignment, sizeof(Model)));
 
-    Volcano::device->destroySwapchainKHR(Volcano::swapChain);
+    // Instances created before buffer existed are only in cpu copy
+    for (auto& frame : Volcano::frames)
+        frame.staleTransforms = { 0, static_cast<uint32_t>(Volcano::instanceModels.size()) };
 }
 
-void Volcano::createUniformBuffer() 
+void Volcano::createReadback()
 {
-    // View Projection buffer size
-    vk::DeviceSize vpBufferSize = sizeof(UBOViewProj);
-    
-    // Model Buffer Size
-    //vk::DeviceSize modelBufferSize = modelUniformAlignment * MAX_OBJECTS;
+    // Offscreen targets are rgba8, which is what png wants too
+    Volcano::frameReadback.init(Volcano::renderDevice->getAllocator(), Volcano::device, Volcano::swapChainExtent,
+        Volcano::swapChainImageFormat, 4, Volcano::framesInFlight);
+}
 
-    // one uniform buffer for each image
-    Volcano::vpUniformBuffer.resize(Volcano::swapChainImages.size());
-    Volcano::vpUniformBufferMemory.resize(Volcano::swapChainImages.size());
-    
-    //Volcano::modelUniformBuffer.resize(Volcano::swapChainImages.size());
-    //Volcano::modelUniformBufferMemory.resize(Volcano::swapChainImages.size());
-    
-    // Create uniform buffer
-    for (size_t i = 0; i < Volcano::swapChainImages.size(); ++i)
-    {
-        createBuffer(vpBufferSize, vk::BufferUsageFlagBits::eUniformBuffer,
-            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, vpUniformBuffer[i], vpUniformBufferMemory[i]); 
-        
-        /*createBuffer(modelBufferSize, vk::BufferUsageFlagBits::eUniformBuffer,
-            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, modelUniformBuffer[i], modelUniformBufferMemory[i]);*/
-    }
+void Volcano::readbackFrame(ReadbackCallback callback)
+{
+    // Swapchain images are bgra and stay in present layout. Not worth the extra barriers for now
+    if (!Volcano::headless)
+        throw std::runtime_error("Frame readback needs headless mode");
+
+    Volcano::nextReadback = std::move(callback);
+}
+
+void Volcano::saveFrame(const std::string& filename)
+{
+    Volcano::readbackFrame([this, filename](const ReadbackImage& image) {
+        // Pixels are only valid during callback. Copy them out and encode on worker thread
+        std::vector<uint8_t> pixels(image.pixels, image.pixels + static_cast<size_t>(image.rowPitch) * image.height);
+        uint32_t width = image.width, height = image.height, rowPitch = image.rowPitch;
+
+        Volcano::renderDevice->getThreadPool().submit([filename, pixels = std::move(pixels), width, height, rowPitch]() {
+            if (!png::write(filename.c_str(), width, height, pixels.data(), rowPitch))
+                std::cerr << "Failed to write " << filename << std::endl;
+        });
+    });
 }
 
 void Volcano::createDescriptorPool()
 {
-    vk::DescriptorPoolSize vpPoolSize = {};
-    vpPoolSize.type = vk::DescriptorType::eUniformBuffer;
-    vpPoolSize.descriptorCount = static_cast<uint32_t>(vpUniformBuffer.size());
-    
-    /*
-    vk::DescriptorPoolSize modelPoolSize = {};
-    modelPoolSize.type = vk::DescriptorType::eUniformBufferDynamic;
-    modelPoolSize.descriptorCount = static_cast<uint32_t>(modelUniformBuffer.size());
-    */
-
-    std::array<vk::DescriptorPoolSize, 1> poolSizes = {
-        vpPoolSize,
-        //modelPoolSize
-    };
+    // Exactly what reflected layout needs, one set per frame in flight
+    std::vector<vk::DescriptorPoolSize> poolSizes;
+    for (const auto& binding : Volcano::shaderReflection.getSetBindings(0))
+        poolSizes.push_back(vk::DescriptorPoolSize(binding.descriptorType, binding.descriptorCount * Volcano::framesInFlight));
 
     vk::DescriptorPoolCreateInfo poolCreateInfo = {};
-    poolCreateInfo.maxSets = static_cast<uint32_t>(swapChainImages.size());
+    poolCreateInfo.maxSets = Volcano::framesInFlight;
     poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
     poolCreateInfo.pPoolSizes = poolSizes.data();
 
     try 
     {
-        Volcano::descriptorPool = Volcano::device->createDescriptorPool(poolCreateInfo);
+        Volcano::descriptorPool = Volcano::device.createDescriptorPool(poolCreateInfo);
     }
     catch(vk::SystemError& e)
     {
@@ -1411,17 +1379,19 @@ void Volcano::createDescriptorPool()
 
 void Volcano::createDescriptorSets()
 {
-    std::vector<vk::DescriptorSetLayout> setLayouts(Volcano::swapChainImages.size(), Volcano::descriptorSetLayout);
+    std::vector<vk::DescriptorSetLayout> setLayouts(Volcano::framesInFlight, Volcano::descriptorSetLayout);
 
     // alloc info
     vk::DescriptorSetAllocateInfo setAllocInfo = {};
     setAllocInfo.descriptorPool = Volcano::descriptorPool;
-    setAllocInfo.descriptorSetCount = static_cast<uint32_t>(Volcano::swapChainImages.size());
+    setAllocInfo.descriptorSetCount = Volcano::framesInFlight;
     setAllocInfo.pSetLayouts = setLayouts.data();
 
     try
     {
-        Volcano::descriptorSets = Volcano::device->allocateDescriptorSets(setAllocInfo);
+        auto descriptorSets = Volcano::device.allocateDescriptorSets(setAllocInfo);
+        for (uint32_t i = 0; i < Volcano::framesInFlight; ++i)
+            Volcano::frames[i].descriptorSet = descriptorSets[i];
     }
     catch(vk::SystemError& e)
     {
@@ -1430,89 +1400,77 @@ void Volcano::createDescriptorSets()
     }
 
     // update all descriptor set buffer binding
-    for(size_t i = 0; i < Volcano::swapChainImages.size(); ++i)
+    for(uint32_t i = 0; i < Volcano::framesInFlight; ++i)
     {
         // Buffer info and data offset info 
         vk::DescriptorBufferInfo vpBufferInfo = {};
-        vpBufferInfo.buffer = Volcano::vpUniformBuffer[i];                   // Buffer to get data from
-        vpBufferInfo.offset = 0;                                           // Start at
+        vpBufferInfo.buffer = Volcano::vpUniformBuffer.getBuffer();          // Buffer to get data from
+        vpBufferInfo.offset = Volcano::vpUniformBuffer.getOffset(i);         // Start at region of frame
         vpBufferInfo.range = sizeof(UBOViewProj);
 
         // data about connection between binding and buffer
         vk::WriteDescriptorSet vpSetWrite = {};
-        vpSetWrite.dstSet = Volcano::descriptorSets[i];                    // descriptor set to update
+        vpSetWrite.dstSet = Volcano::frames[i].descriptorSet;                    // descriptor set to update
         vpSetWrite.dstBinding = 0;                                         // layout (binding = 0)
         vpSetWrite.dstArrayElement = 0;                                    // if uniform is array then index to update
         vpSetWrite.descriptorType = vk::DescriptorType::eUniformBuffer;
         vpSetWrite.descriptorCount = 1;                                    // Amount to update
         vpSetWrite.pBufferInfo = &vpBufferInfo;
 
-        /*
         vk::DescriptorBufferInfo modelBufferInfo = {};
-        modelBufferInfo.buffer = modelUniformBuffer[i];
+        modelBufferInfo.buffer = Volcano::transformBuffer.getBuffer();     // All slots. Frame's slot is picked with transform base
         modelBufferInfo.offset = 0;
-        modelBufferInfo.range = modelUniformAlignment * MAX_OBJECTS;
-
-        vk::WriteDescriptorSet modelWriteSet = {};
-        modelWriteSet.dstSet = descriptorSets[i];
-        modelWriteSet.dstBinding = 1;
-        modelWriteSet.dstArrayElement = 0;
-        modelWriteSet.descriptorType = vk::DescriptorType::eUniformBufferDynamic;
-        modelWriteSet.descriptorCount = 1;
-        modelWriteSet.pBufferInfo = &modelBufferInfo;
-        */
-
-        std::array<vk::WriteDescriptorSet, 1> setWrites = {
-            vpSetWrite,
-            //modelWriteSet
-        };
+        modelBufferInfo.range = VK_WHOLE_SIZE;
+
+        vk::WriteDescriptorSet modelSetWrite = {};
+        modelSetWrite.dstSet = Volcano::frames[i].descriptorSet;
+        modelSetWrite.dstBinding = 1;                                      // layout (binding = 1)
+        modelSetWrite.dstArrayElement = 0;
+        modelSetWrite.descriptorType = vk::DescriptorType::eStorageBuffer;
+        modelSetWrite.descriptorCount = 1;
+        modelSetWrite.pBufferInfo = &modelBufferInfo;
+
+        // First texture. Written even if no variant samples it, as every binding has to be valid
+        vk::DescriptorImageInfo imageInfo = {};
+        imageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+        imageInfo.imageView = Volcano::textureImageView[0];
+        imageInfo.sampler = Volcano::textureSampler;
+
+        vk::WriteDescriptorSet samplerSetWrite = {};
+        samplerSetWrite.dstSet = Volcano::frames[i].descriptorSet;
+        samplerSetWrite.dstBinding = 2;                                    // layout (binding = 2)
+        samplerSetWrite.dstArrayElement = 0;
+        samplerSetWrite.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+        samplerSetWrite.descriptorCount = 1;
+        samplerSetWrite.pImageInfo = &imageInfo;
+
+        // Bindings dropped from layout by reflection are not written
+        std::vector<vk::WriteDescriptorSet> setWrites;
+        for (const auto& setWrite : { vpSetWrite, modelSetWrite, samplerSetWrite })
+        {
+            if (Volcano::shaderReflection.hasBinding(0, setWrite.dstBinding))
+                setWrites.push_back(setWrite);
+        }
 
         // update descripter set with new buffer binding info
-        Volcano::device->updateDescriptorSets(setWrites, nullptr);
+        Volcano::device.updateDescriptorSets(setWrites, nullptr);
     }
-
-    //for (auto& layout: setLayouts)
-        //Volcano::device->destroyDescriptorSetLayout(layout);
-}
-
-void Volcano::updateUniformBuffers(uint32_t imageIndex)
-{
-    // copy vp data
-    void* data = Volcano::device->mapMemory(Volcano::vpUniformBufferMemory[imageIndex], 0, sizeof(UBOViewProj));
-    memcpy(data, &mvp, sizeof(UBOViewProj));
-    Volcano::device->unmapMemory(Volcano::vpUniformBufferMemory[imageIndex]);
-
-    /*
-    * 
-    * Code for dynamic descriptors
-    * No longer needed
-    * 
-    // copy model data
-    for (size_t i = 0; i < meshList.size(); ++i)
-    {
-        // Beginning of trasfer space + offset (ie total size that can be allocated) <-- store model data here
-        Model* thisModel = (Model*)((uint64_t)modelTransferSpace + (i * modelUniformAlignment));
-        *thisModel = meshList[i]->getModel();
-    }
-
-    data = Volcano::device->mapMemory(Volcano::modelUniformBufferMemory[imageIndex], 0, modelUniformAlignment * meshList.size());
-    memcpy(data, modelTransferSpace, modelUniformAlignment * meshList.size());
-    Volcano::device->unmapMemory(Volcano::modelUniformBufferMemory[imageIndex]);
-    */
 }
 
-void Volcano::allocateDynamicBufferTransferSpace()
+void Volcano::updateUniformBuffers()
 {
-    /*
-    // if minBufferOffset = 256 -> 256 - 1 = 255 -> all 7 bits are 1 and highest bit is 0 -> complemnet it
-    // Pro tip: 2's complement of a number of power of is itself but -ve
-    // if sizeof ubomdel is still greater than 0 this means data size is greater than 256 
-    //  (1^0*)1 00000000 is valid. Last all bits should be zero
-    modelUniformAlignment = (sizeof(Model) + minBufferOffset - 1) & ~(minBufferOffset - 1);                      // Calclutaion alignemnt of model data
-
-    // Create space to hlod dynamic memory
-    modelTransferSpace = (Model*) _aligned_malloc(modelUniformAlignment * MAX_OBJECTS, modelUniformAlignment);
-    */
+    VOLCANO_PROFILE_SCOPE("updateUniformBuffers");
+    // Vertex shader reads model matrices from slot of current frame
+    mvp.transformBase = static_cast<uint32_t>(Volcano::transformBuffer.getOffset(currentFrame) / sizeof(Model));
+
+    // copy vp data through pointer mapped at creation
+    Volcano::vpUniformBuffer.write(currentFrame, &mvp, sizeof(UBOViewProj));
+
+    // Model matrices written this frame have to reach device before submit
+    auto& written = Volcano::writtenTransforms;
+    if (written.first < written.second)
+        Volcano::transformBuffer.flush(currentFrame, sizeof(Model) * written.first, sizeof(Model) * (written.second - written.first));
+    written = { 0, 0 };
 }
 
 stbi_uc* Volcano::loadTextureFile(const char* filename, int& width, int& height, vk::DeviceSize& imageSize)
@@ -1539,52 +1497,35 @@ int Volcano::createTextureImage(const char* filename)
     vk::DeviceSize imageSize;
     stbi_uc* imageData = loadTextureFile(filename, width, height, imageSize);
 
-    // Create staging buffer to hold loaded data to copy to device
-    vk::Buffer imageStagingBuffer;
-    vk::DeviceMemory imageStagingMemory;
-
-    Volcano::createBuffer(imageSize, vk::BufferUsageFlagBits::eTransferSrc, 
-        vk::MemoryPropertyFlagBits::eHostCoherent | vk::MemoryPropertyFlagBits::eHostVisible,
-        imageStagingBuffer, imageStagingMemory
-    );
-
-    // copying data to staging buffer
-    void* data = Volcano::device->mapMemory(imageStagingMemory, 0, imageSize);
-    memcpy(data, imageData, static_cast<uint32_t>(imageSize));
-    Volcano::device->unmapMemory(imageStagingMemory);
+    // copying data to staging ring to copy to device
+    StagingAllocation staging = Volcano::renderDevice->stageData(imageData, imageSize);
 
     // Free image data
     stbi_image_free(imageData);
 
     // Create image to hold texture
     vk::Image texImage;
-    vk::DeviceMemory texImageMemory;
+    MemoryAllocation texImageMemory;
 
-    texImage = Volcano::createImage(width, height, vk::Format::eR8G8B8A8Unorm, vk::ImageTiling::eOptimal,
+    texImage = Volcano::renderDevice->createImage(width, height, vk::Format::eR8G8B8A8Unorm, vk::ImageTiling::eOptimal,
         vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
         vk::MemoryPropertyFlagBits::eDeviceLocal, texImageMemory
     );
 
     // transition image state before copy
-    Volcano::transitionImageLayout(Volcano::graphicsQueue, Volcano::graphicsCommandPool,
-        texImage, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal
-    );
+    Volcano::transitionImageLayout(texImage, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
 
     // copy image data
-    Volcano::copyImageBuffer(imageStagingBuffer, texImage, width, height);
+    Volcano::copyImageBuffer(staging.buffer, texImage, width, height, staging.offset);
     
-    // transtion image to shader readable stage
-    Volcano::transitionImageLayout(Volcano::graphicsQueue, Volcano::graphicsCommandPool, texImage,
-        vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+    // transtion image to shader readable stage and hand it over to graphics queue
+    Volcano::renderDevice->getUploadContext().releaseImage(texImage, vk::ImageLayout::eShaderReadOnlyOptimal,
+        vk::PipelineStageFlagBits::eFragmentShader, vk::AccessFlagBits::eShaderRead);
 
     // save texture data and memory
     Volcano::textureImages.emplace_back(texImage);
     Volcano::textureImageMemory.emplace_back(texImageMemory);
 
-    // destory staging image and buffer
-    Volcano::device->destroyBuffer(imageStagingBuffer);
-    Volcano::device->freeMemory(imageStagingMemory);
-
     // Return index of texture
     return static_cast<int>(textureImages.size() - 1);
 }
@@ -1593,7 +1534,7 @@ int Volcano::createTexture(const char* filename)
 {
     int textureImageLoc = Volcano::createTextureImage(filename);
 
-    vk::ImageView imageView = Volcano::createImageView(Volcano::textureImages[textureImageLoc], vk::Format::eR8G8B8A8Unorm, vk::ImageAspectFlagBits::eColor);
+    vk::ImageView imageView = Volcano::renderDevice->createImageView(Volcano::textureImages[textureImageLoc], vk::Format::eR8G8B8A8Unorm, vk::ImageAspectFlagBits::eColor);
     textureImageView.push_back(imageView);
 
     // Todo: Create descriptor set later
@@ -1619,7 +1560,7 @@ void Volcano::createTextureSampler()
 
     try
     {
-        Volcano::textureSampler = Volcano::device->createSampler(samplerCreateInfo);
+        Volcano::textureSampler = Volcano::device.createSampler(samplerCreateInfo);
     }
     catch (vk::SystemError& e)
     {
@@ -1627,9 +1568,9 @@ void Volcano::createTextureSampler()
     }
 }
 
-void Volcano::transitionImageLayout(vk::Queue queue, vk::CommandPool commandPool, vk::Image image, vk::ImageLayout oldLayout, vk::ImageLayout newLayout)
+void Volcano::transitionImageLayout(vk::Image image, vk::ImageLayout oldLayout, vk::ImageLayout newLayout)
 {
-    vk::CommandBuffer commandBuffer = Volcano::beginCopyBuffer(commandPool);
+    vk::CommandBuffer commandBuffer = Volcano::renderDevice->getUploadContext().getCommandBuffer();
 
     vk::ImageMemoryBarrier memoryBarrier = {};
     memoryBarrier.oldLayout = oldLayout;
@@ -1668,67 +1609,4 @@ void Volcano::transitionImageLayout(vk::Queue queue, vk::CommandPool commandPool
         nullptr, nullptr,
         memoryBarrier
     );
-    //{
-    //    // Region of data to copy from into
-    //    vk::BufferCopy bufferCopyRegion = {};
-    //    bufferCopyRegion.srcOffset = 0;
-    //    bufferCopyRegion.dstOffset = 0;
-    //    bufferCopyRegion.size = bufferSize;
-
-    //    commandBuffer.copyBuffer(src, dst, bufferCopyRegion);
-    //}
-
-    Volcano::endCopyBuffer(commandPool, queue, commandBuffer);
-}
-
-#ifdef DEBUG
-bool Volcano::checkValidationLayerSupport()
-{
-    auto availableLayers = vk::enumerateInstanceLayerProperties();
-    
-    for(const char* layerName: validationLayers)
-    {
-        bool layerFound = false;
-        for(const auto& layerProperties : availableLayers)
-        {
-            if(strcmp(layerName, layerProperties.layerName) == 0)
-            {
-                layerFound = true;
-                break;
-            }
-        }
-
-        if (!layerFound)
-        {
-            return false;
-        }
-    }
-
-    return true;
-}
-
-VkBool32 Volcano::debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType,
-        const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData)
-{
-    std::cerr << "Validation layer: " << pCallbackData->pMessage << std::endl;
-    return VK_FALSE;
-}
-
-VkResult Volcano::createDebugUtilsMessengerEXT(vk::UniqueInstance& instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo,
-                const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pCallback)
-{
-    auto func = (PFN_vkCreateDebugUtilsMessengerEXT) vkGetInstanceProcAddr(instance.get(), "vkCreateDebugUtilsMessengerEXT");
-
-    if(func != nullptr)
-        return func(instance.get(), pCreateInfo, pAllocator, pCallback);
-    else
-        return VK_ERROR_EXTENSION_NOT_PRESENT;
-}
-
-void Volcano::destroyDebugUtilMessengerEXT(vk::UniqueInstance& instance, VkDebugUtilsMessengerEXT debugMessenger, const VkAllocationCallbacks* pAllocator)
-{
-    auto func = (PFN_vkDestroyDebugUtilsMessengerEXT) vkGetInstanceProcAddr(instance.get(), "vkDestroyDebugUtilsMessengerEXT");
-    if (func != nullptr)
-        func(instance.get(), debugMessenger, pAllocator);
 }
-#endif
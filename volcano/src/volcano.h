@@ -1,177 +1,234 @@
 #pragma once
 
+#include <future>
+#include <limits>
+#include <map>
+#include <mutex>
 #include <optional>
+#include <string>
 #include <vector>
 #include <vulkan/vulkan.hpp>
 #include <memory>
 #include <stb_image/stb_image.h>
 #include "mesh.h"
+#include "FrameContext.h"
+#include "FrameReadback.h"
+#include "GpuProfiler.h"
+#include "PerFrameBuffer.h"
+#include "PipelineRegistry.h"
+#include "RenderDevice.h"
+#include "ShaderReflection.h"
 #include "SwapChainImage.h"
 
-struct QueueFamilyIndicies;
 struct SwapChainSupportDetails;
 class Window;
 
-#define MAX_FRAME_DRAWS 2
-#define MAX_OBJECTS 2
-
+// Frames cpu may record ahead of gpu unless chosen otherwise in Volcano::init
+#define DEFAULT_FRAMES_IN_FLIGHT 2
+#define MAX_OBJECTS 1024
+// Stands for pipeline requested at init of renderer. Used by meshes unless given another
+#define DEFAULT_PIPELINE std::numeric_limits<PipelineId>::max()
+// Model matrices of all mesh instances together
+#define MAX_INSTANCES 16384
+// Draws below this count are recorded on one thread. Only used without multiDrawIndirect, see recordDraws
+#define MIN_DRAWS_PER_RECORD_THREAD 256
+
+// One render context: surface and swapchain (or offscreen targets), frames in flight, scene and camera
+// Contexts are cheap next to render device they share, so one process can hold several of them
+// Used from one thread, same as render device. Only exception is updateModel(s), see there
 class Volcano
 {
     public:
-        // Initalize vulkan instance
-        static void init(Window* window);
-        static void destroy();
-        static void draw();
-        static void updateModel(int modelId, const glm::mat4& newModel);
-        
-        static bool& getFramebufferResized() { return Volcano::framebufferResized; }
-
-        static void createBuffer(vk::DeviceSize bufferSize, vk::BufferUsageFlags bufferUsageFlags, vk::MemoryPropertyFlags bufferProperties,
-            vk::Buffer& buffer, vk::DeviceMemory& bufferMemory);
-        static void copyBuffer(vk::Buffer& src, vk::Buffer& dst, vk::DeviceSize bufferSize);
+        Volcano() = default;
+        Volcano(const Volcano&) = delete;
+        Volcano& operator=(const Volcano&) = delete;
+
+        // Device has to support presentation
+        // More frames in flight -> more throughput, fewer -> less input latency. At least 1
+        // Window of nullptr runs headless, see initHeadless
+        void init(RenderDevice& renderDevice, Window* window, uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT);
+        // No window, surface, swapchain or present (e.g. CI with lavapipe). Frames render into offscreen
+        // color target of given size, one per frame in flight, left in transfer src layout
+        void initHeadless(RenderDevice& renderDevice, uint32_t width, uint32_t height, uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT);
+        bool isHeadless() const { return Volcano::headless; }
+        // Waits only for frames of this context. Render device stays
+        void destroy();
+        void draw();
+        // Wait till transform slot of next frame is free. Called by draw and updateModel if not called before
+        void beginFrame();
+        // modelId is instance slot. Instances of a mesh start at Mesh::getFirstInstance
+        // Written straight into mapped transform slot of current frame. Not thread safe in general. Only allowed
+        // concurrent use: owning thread calls beginFrame, then worker threads update disjoint instances, and owning thread
+        // waits for all of them before it calls anything else on this context (draw, addMesh, clearScene, ...)
+        void updateModel(uint32_t modelId, const glm::mat4& newModel);
+        void updateModels(uint32_t firstModel, const std::vector<glm::mat4>& newModels);
+        // Used from next drawn frame on. Projection is replaced on resize of window
+        void setCamera(const glm::mat4& view, const glm::mat4& proj);
+
+        // Upload geometry once and draw it instanceCount times with one draw
+        std::shared_ptr<Mesh> addMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t instanceCount = 1,
+            PipelineId pipeline = DEFAULT_PIPELINE);
+        // Remove every mesh, e.g. between scenes of batch. Waits for frames of this context
+        // Geometry and instance slots are freed once no one else holds the mesh
+        void clearScene();
+        // Description of default pipeline, to be modified and passed to requestPipeline
+        PipelineDescription getDefaultPipelineDescription() { return Volcano::renderDevice->getPipelineRegistry().getDescription(Volcano::defaultPipeline); }
+        // Same description always gives same id. Compiled in background, meshes using it are drawn once ready
+        // Variants (e.g. textured) differ in specialization constants, see FragmentConstant
+        PipelineId requestPipeline(const PipelineDescription& description) { return Volcano::renderDevice->getPipelineRegistry().request(description); }
+        // Reserve contiguous model slots, set to identity. Returns first slot
+        uint32_t allocateInstances(uint32_t instanceCount);
+        // Slots of destroyed mesh. Reused by later allocations
+        void freeInstances(uint32_t firstInstance, uint32_t instanceCount);
+
+        uint32_t getFramesInFlight() const { return Volcano::framesInFlight; }
+        RenderDevice& getRenderDevice() { return *Volcano::renderDevice; }
+
+        // Copy of next drawn frame is handed to callback once it finished rendering, on thread calling draw
+        // (framesInFlight draws later, or in destroy). Queue never waits for it. Headless only
+        void readbackFrame(ReadbackCallback callback);
+        // Read back next drawn frame and encode it as png on worker thread
+        void saveFrame(const std::string& filename);
+
+        // Gpu time of render pass, rolling statistics and periodic log
+        GpuProfiler& getGpuProfiler() { return Volcano::gpuProfiler; }
+        // Time every group of draws sharing a pipeline too. Costs two timestamps per group
+        void setGpuDrawGroupTiming(bool enabled);
     private:
-        inline static bool framebufferResized = false;
+        RenderDevice* renderDevice = nullptr;
+        // Handles of render device, used everywhere
+        vk::PhysicalDevice physicalDevice;
+        vk::Device device;
+
+        bool headless = false;
         // Current frame to be drawn
-        inline static int currentFrame = 0;
-        inline static struct UBOViewProj {
+        uint32_t currentFrame = 0;
+        // Frames submitted so far. Frame n uses frame context n % framesInFlight
+        uint64_t frameNumber = 0;
+        uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+        // Command buffers, descriptor set and sync objects of every frame in flight
+        std::vector<FrameContext> frames;
+        struct UBOViewProj {
             glm::mat4 proj;
             glm::mat4 view;
+            uint32_t transformBase;             // First matrix of frame's slot in transform buffer
 
-            UBOViewProj() : proj(1.0f), view(1.0f) {}
+            UBOViewProj() : proj(1.0f), view(1.0f), transformBase(0) {}
         } mvp;
-        // UniqueInstance destruction is done automatically
-        inline static vk::UniqueInstance instance;
-        // GPU device
-        inline static vk::PhysicalDevice physicalDevice;
-        // Logical device
-        inline static vk::UniqueDevice device;
-        
-        inline static vk::Queue graphicsQueue;
-        inline static vk::Queue presentQueue;
-        inline static vk::SurfaceKHR surface;
-        
-        // List of device extensions
-        inline static const std::vector<const char*> deviceExtensions = {
-            VK_KHR_SWAPCHAIN_EXTENSION_NAME         // Swap chain extensions (macro)
-        };
-        
-        inline static vk::SwapchainKHR swapChain;
 
-        inline static std::vector<SwapChainImage> swapChainImages;
-        inline static std::vector<vk::Framebuffer> swapChainFramebuffers;
-        inline static std::vector<vk::CommandBuffer> commandBuffers;
+        vk::SurfaceKHR surface;
+
+        vk::SwapchainKHR swapChain;
+        // Swapchains replaced on resize, waiting for frames in flight to finish with them
+        std::vector<RetiredSwapChain> retiredSwapChains;
+
+        std::vector<SwapChainImage> swapChainImages;
+        std::vector<vk::Framebuffer> swapChainFramebuffers;
         
-        inline static vk::Image depthBufferImage;
-        inline static vk::DeviceMemory depthBufferMemory;
-        inline static vk::ImageView depthBufferImageView;
-
-        inline static vk::Format swapChainImageFormat;
-        inline static vk::Extent2D swapChainExtent;
-
-        inline static vk::Format depthFormat;
-
-        inline static vk::Pipeline graphicsPipeline;
-        inline static vk::PipelineLayout pipelineLayout;
-        inline static vk::RenderPass renderPass;
-        inline static vk::CommandPool graphicsCommandPool;
-
-        // Singal after image is ready to be rendered
-        inline static std::vector<vk::Semaphore> imageAvailable;
-        // Signal after rendering is finised
-        inline static std::vector<vk::Semaphore> renderFinished;
-        // Fences for cpu-gpu sync
-        inline static std::vector<vk::Fence> drawFences;
+        vk::Image depthBufferImage;
+        MemoryAllocation depthBufferMemory;
+        vk::ImageView depthBufferImageView;
+
+        vk::Format swapChainImageFormat;
+        vk::Extent2D swapChainExtent;
+
+        vk::Format depthFormat;
+
+        vk::PipelineLayout pipelineLayout;
+        vk::RenderPass renderPass;
+        // Pipeline requested at init, for render pass of this context
+        PipelineId defaultPipeline = 0;
+        bool startupReported = false;                               // Default pipeline was seen ready once
+        // Pipelines of device last recorded with. Draws are recorded again once they are replaced
+        uint64_t pipelineGeneration = 0;
+
+        // Draw commands of whole scene, one per mesh. Drawn with one indirect call when supported
+        // Region per frame in flight
+        PerFrameBuffer indirectBuffer;
+        // Host copies of offscreen targets, one region per frame in flight
+        FrameReadback frameReadback;
+        ReadbackCallback nextReadback;                              // Goes with next recorded frame
+        // Timestamp queries of every frame in flight
+        GpuProfiler gpuProfiler;
+
+        // Fence of frame that is using swapchain image
+        std::vector<vk::Fence> imagesInFlight;
         
         // Uniform
-        inline static vk::DescriptorSetLayout descriptorSetLayout;
-        inline static vk::PushConstantRange pushConstantRange;
+        vk::DescriptorSetLayout descriptorSetLayout;
+        // Interface of default shaders. Source of descriptor, pipeline layout and vertex input
+        ShaderReflection shaderReflection;
 
-        inline static vk::DescriptorPool descriptorPool;
-        inline static std::vector<vk::DescriptorSet> descriptorSets;
+        vk::DescriptorPool descriptorPool;
         
-        inline static std::vector<vk::Buffer> vpUniformBuffer;
-        inline static std::vector<vk::DeviceMemory> vpUniformBufferMemory;
+        // Region per frame in flight
+        PerFrameBuffer vpUniformBuffer;
+
+        // Latest model matrix of every instance. Source for slots that missed updates while in flight
+        std::vector<Model> instanceModels;
+        // Freed slots below instanceModels.size(), keyed by first slot
+        std::map<uint32_t, uint32_t> freeInstanceRanges;
+        // Model matrices of all instances. One slot of MAX_INSTANCES per frame in flight, persistently mapped
+        // Indexed by transform base + instance index in vertex shader
+        PerFrameBuffer transformBuffer;
+        // Instances [first, second) written into current slot. Flushed before submit
+        std::pair<uint32_t, uint32_t> writtenTransforms;
+        // Guards stale and written ranges while workers update disjoint instances between beginFrame and draw
+        std::mutex transformMutex;
+        bool frameBegun = false;                                    // Only changed by owning thread, see updateModel
 
         // Textures
-        inline static vk::Sampler textureSampler;
-        inline static std::vector<vk::Image> textureImages;
-        inline static std::vector<vk::DeviceMemory> textureImageMemory;
-        inline static std::vector<vk::ImageView> textureImageView;
-
-        // inline static std::vector<vk::Buffer> modelUniformBuffer;
-        // inline static std::vector<vk::DeviceMemory> modelUniformBufferMemory;
-
-        //inline static vk::DeviceSize minBufferOffset;
-        //inline static size_t modelUniformAlignment;
-        //inline static UBOModel* modelTransferSpace;
-
-        inline static Window* window;
-// Validation layer only exist for debug build
-#ifdef DEBUG
-        inline static std::vector<const char*> validationLayers = {
-            "VK_LAYER_KHRONOS_validation"
-        };
-        inline static VkDebugUtilsMessengerEXT callback;
-#endif
+        vk::Sampler textureSampler;
+        std::vector<vk::Image> textureImages;
+        std::vector<MemoryAllocation> textureImageMemory;
+        std::vector<vk::ImageView> textureImageView;
+
+        Window* window = nullptr;
         // Scene object
-        inline static std::vector<std::shared_ptr<Mesh>> meshList; 
+        std::vector<std::shared_ptr<Mesh>> meshList; 
     
     private:
-        static void pickPhysicalDevice();
-        static bool isDeviceSuitable(const vk::PhysicalDevice& device);
-        static QueueFamilyIndicies findQueueFamily(const vk::PhysicalDevice& device);
-        static std::vector<const char*> getRequiredExtensions();
-        static void createLogicalDevice();
-        static void createSurface();
-        static bool checkDeviceExtensionsSupport(const vk::PhysicalDevice& physicalDevice);
-        static vk::SurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<vk::SurfaceFormatKHR>& availableFormats);
-        static vk::PresentModeKHR chooseSwapPresentMode(const std::vector<vk::PresentModeKHR>& availablePresentMode);
-        static vk::Extent2D chooseSwapExtent(const vk::SurfaceCapabilitiesKHR& capabilities);
-        static void createSwapChain();
-        static vk::ImageView createImageView(const vk::Image& image, const vk::Format& format, const vk::ImageAspectFlags aspectFlag);
-        static void createRenderPass();
-        static void createDescriptorSetLayout();
-        static void createPushConstantRange();
-        static void createGraphicsPipeline();
-        static void createDepthBufferImage();
-        static void createFramebuffers();
-
-        static vk::UniqueShaderModule createShaderModule(const std::vector<char>& code);
-        static vk::Image createImage(uint32_t width, uint32_t height, vk::Format format, vk::ImageTiling tiling,
-            vk::ImageUsageFlags useFlags, vk::MemoryPropertyFlags propFlags, vk::DeviceMemory& imageMemory);
-        static vk::Format chooseSupportedFormat(const std::vector<vk::Format>& formats, const vk::ImageTiling& tiling, const vk::FormatFeatureFlags& featureFlags);
-
-        static void createCommandPool();
-        static void createCommandBuffer();
-        static void recordCommands(uint32_t currentImage);
-        static void createSynchronization();
+        void createSurface();
+        vk::SurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<vk::SurfaceFormatKHR>& availableFormats);
+        vk::PresentModeKHR chooseSwapPresentMode(const std::vector<vk::PresentModeKHR>& availablePresentMode);
+        vk::Extent2D chooseSwapExtent(const vk::SurfaceCapabilitiesKHR& capabilities);
+        void createSwapChain();
+        void createOffscreenTargets();
+        void createRenderPass();
+        void createDescriptorSetLayout();
+        void createPipelineLayout();
+        void createGraphicsPipeline();
+        void createDepthBufferImage();
+        void createFramebuffers();
+
+        void createCommandPool();
+        void createIndirectBuffer();
+        void createReadback();
+        void createCommandBuffer();
+        void markCommandBuffersDirty();
+        void recordCommands(uint32_t imageIndex);
+        void recordDraws(uint32_t frameIndex);
+        void recordSecondaryCommands(uint32_t frameIndex, uint32_t chunk, size_t firstDraw, size_t lastDraw, uint32_t firstGroup);
+        void createSynchronization();
+        void presentFrame(FrameContext& frame, uint32_t imageIndex);
+        void waitForFrames();
         
-        static uint32_t findMemoryTypeIndex(uint32_t allowedTypes, vk::MemoryPropertyFlags properties);
-        static void recreateSwapChain();
-        static void cleanupSwapChain();
-        static void createUniformBuffer();
-        static void createDescriptorPool();
-        static void createDescriptorSets();
-        static void updateUniformBuffers(uint32_t imageIndex);
-
-        static void allocateDynamicBufferTransferSpace();
+        void recreateSwapChain();
+        void retireSwapChain();
+        void releaseRetiredSwapChains(uint64_t completedFrames);
+        void cleanupSwapChain(RetiredSwapChain& retired);
+        void createUniformBuffer();
+        void createDescriptorPool();
+        void createDescriptorSets();
+        void updateUniformBuffers();
+        void markTransformsStale(uint32_t first, uint32_t end, bool skipCurrent);
         
-        static void copyImageBuffer(vk::Buffer& src, vk::Image& image, uint32_t width, uint32_t height);
-        static vk::CommandBuffer beginCopyBuffer(vk::CommandPool& commandPool);
-        static void endCopyBuffer(vk::CommandPool& commandPool, vk::Queue& queue, vk::CommandBuffer& commandBuffer);
-
-        static stbi_uc* loadTextureFile(const char* filename, int& width, int& height, vk::DeviceSize& imageSize);
-        static int createTextureImage(const char* filename);
-        static int createTexture(const char* filename);
-        static void createTextureSampler();
-
-        static void transitionImageLayout(vk::Queue queue, vk::CommandPool commandPool, vk::Image image, vk::ImageLayout oldLayout, vk::ImageLayout newLayout);
-#ifdef DEBUG
-        static bool checkValidationLayerSupport();
-        static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType,
-                const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData);
-        static VkResult createDebugUtilsMessengerEXT(vk::UniqueInstance& instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo,
-                const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pCallback);
-        static void destroyDebugUtilMessengerEXT(vk::UniqueInstance& instance, VkDebugUtilsMessengerEXT debugMessenger, const VkAllocationCallbacks* pAllocator);
-#endif
+        void copyImageBuffer(vk::Buffer& src, vk::Image& image, uint32_t width, uint32_t height, vk::DeviceSize srcOffset = 0);
+
+        stbi_uc* loadTextureFile(const char* filename, int& width, int& height, vk::DeviceSize& imageSize);
+        int createTextureImage(const char* filename);
+        int createTexture(const char* filename);
+        void createTextureSampler();
+
+        void transitionImageLayout(vk::Image image, vk::ImageLayout oldLayout, vk::ImageLayout newLayout);
 };
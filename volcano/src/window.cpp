@@ -2,7 +2,6 @@
 #include "window.h"
 
 #include <stdexcept>
-#include "volcano.h"
 
 Window::Window(const char* name, int width, int height)
     :m_Width(width), m_Height(height)
@@ -38,6 +37,11 @@ void Window::pollEvents()
     glfwPollEvents();
 }
 
+void Window::waitEvents()
+{
+    glfwWaitEvents();
+}
+
 bool Window::shouldClose() const
 {
     return glfwWindowShouldClose(m_Window);
@@ -50,5 +54,5 @@ void Window::framebufferResizeCallback(GLFWwindow* window, int width, int height
     currentWindow->m_Width = width;
     currentWindow->m_Height = height;
 
-    Volcano::getFramebufferResized() = true;
+    currentWindow->m_Resized = true;
 }
@@ -7,17 +7,23 @@ class Window
 private:
     GLFWwindow* m_Window;
     int m_Width, m_Height;
+    // Set on resize. Cleared by render context once it recreated its swapchain
+    bool m_Resized = false;
 public:
     Window(const char* name = "Volcano", int width = 800, int height = 800);
     ~Window();
 
     void pollEvents();
+    // Sleeps till next event. Used while minimized instead of spinning
+    void waitEvents();
     bool shouldClose() const;
     void swapBuffer();
 
     inline GLFWwindow* getWindow() const { return m_Window; }
     inline int getWidth() const { return m_Width; }
     inline int getHeight() const { return m_Height; }
+    inline bool isMinimized() const { return m_Width == 0 || m_Height == 0; }
+    inline bool& getFramebufferResized() { return m_Resized; }
 
     inline static void framebufferResizeCallback(GLFWwindow* window, int width, int height);
 };
@@ -0,0 +1,136 @@
+#include "FakeVulkan.h"
+
+#include <cstdint>
+#include <map>
+
+namespace
+{
+    struct State
+    {
+        fake::Limits limits;
+        uintptr_t nextHandle = 1;
+        std::map<VkDeviceMemory, std::vector<char>> memory;
+        std::map<VkBuffer, VkDeviceSize> buffers;
+        std::vector<VkMappedMemoryRange> flushedRanges;
+        std::vector<VkMappedMemoryRange> invalidatedRanges;
+    };
+
+    State& getState()
+    {
+        static State state;
+        return state;
+    }
+
+    template<typename T>
+    T createHandle()
+    {
+        return reinterpret_cast<T>(getState().nextHandle++);
+    }
+}
+
+namespace fake
+{
+    void reset(const Limits& limits)
+    {
+        getState() = State();
+        getState().limits = limits;
+    }
+
+    size_t getAllocationCount()
+    {
+        return getState().memory.size();
+    }
+
+    const std::vector<VkMappedMemoryRange>& getFlushedRanges()
+    {
+        return getState().flushedRanges;
+    }
+
+    const std::vector<VkMappedMemoryRange>& getInvalidatedRanges()
+    {
+        return getState().invalidatedRanges;
+    }
+}
+
+extern "C"
+{
+    VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties(VkPhysicalDevice, VkPhysicalDeviceMemoryProperties* properties)
+    {
+        *properties = {};
+
+        properties->memoryHeapCount = 2;
+        properties->memoryHeaps[0] = { 1024ull * 1024 * 1024, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT };
+        properties->memoryHeaps[1] = { 1024ull * 1024 * 1024, 0 };
+
+        properties->memoryTypeCount = 4;
+        properties->memoryTypes[fake::DeviceLocal] = { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0 };
+        properties->memoryTypes[fake::HostCoherent] = { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 1 };
+        properties->memoryTypes[fake::HostNonCoherent] = { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, 1 };
+        properties->memoryTypes[fake::HostCached] = { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, 1 };
+    }
+
+    VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceProperties(VkPhysicalDevice, VkPhysicalDeviceProperties* properties)
+    {
+        *properties = {};
+        properties->limits.bufferImageGranularity = getState().limits.bufferImageGranularity;
+        properties->limits.nonCoherentAtomSize = getState().limits.nonCoherentAtomSize;
+    }
+
+    VKAPI_ATTR VkResult VKAPI_CALL vkAllocateMemory(VkDevice, const VkMemoryAllocateInfo* info, const VkAllocationCallbacks*, VkDeviceMemory* memory)
+    {
+        *memory = createHandle<VkDeviceMemory>();
+        getState().memory[*memory].resize(static_cast<size_t>(info->allocationSize));
+        return VK_SUCCESS;
+    }
+
+    VKAPI_ATTR void VKAPI_CALL vkFreeMemory(VkDevice, VkDeviceMemory memory, const VkAllocationCallbacks*)
+    {
+        getState().memory.erase(memory);
+    }
+
+    VKAPI_ATTR VkResult VKAPI_CALL vkMapMemory(VkDevice, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize, VkMemoryMapFlags, void** data)
+    {
+        *data = getState().memory.at(memory).data() + offset;
+        return VK_SUCCESS;
+    }
+
+    VKAPI_ATTR void VKAPI_CALL vkUnmapMemory(VkDevice, VkDeviceMemory)
+    {
+    }
+
+    VKAPI_ATTR VkResult VKAPI_CALL vkFlushMappedMemoryRanges(VkDevice, uint32_t count, const VkMappedMemoryRange* ranges)
+    {
+        getState().flushedRanges.insert(getState().flushedRanges.end(), ranges, ranges + count);
+        return VK_SUCCESS;
+    }
+
+    VKAPI_ATTR VkResult VKAPI_CALL vkInvalidateMappedMemoryRanges(VkDevice, uint32_t count, const VkMappedMemoryRange* ranges)
+    {
+        getState().invalidatedRanges.insert(getState().invalidatedRanges.end(), ranges, ranges + count);
+        return VK_SUCCESS;
+    }
+
+    VKAPI_ATTR VkResult VKAPI_CALL vkCreateBuffer(VkDevice, const VkBufferCreateInfo* info, const VkAllocationCallbacks*, VkBuffer* buffer)
+    {
+        *buffer = createHandle<VkBuffer>();
+        getState().buffers[*buffer] = info->size;
+        return VK_SUCCESS;
+    }
+
+    VKAPI_ATTR void VKAPI_CALL vkDestroyBuffer(VkDevice, VkBuffer buffer, const VkAllocationCallbacks*)
+    {
+        getState().buffers.erase(buffer);
+    }
+
+    VKAPI_ATTR void VKAPI_CALL vkGetBufferMemoryRequirements(VkDevice, VkBuffer buffer, VkMemoryRequirements* requirements)
+    {
+        requirements->size = getState().buffers.at(buffer);
+        requirements->alignment = getState().limits.bufferAlignment;
+        requirements->memoryTypeBits = getState().limits.bufferMemoryTypeBits;
+    }
+
+    VKAPI_ATTR VkResult VKAPI_CALL vkBindBufferMemory(VkDevice, VkBuffer, VkDeviceMemory, VkDeviceSize)
+    {
+        return VK_SUCCESS;
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+// Stand-in for the Vulkan entry points used by tested code, so tests need no driver
+// Device memory is host memory. Handles passed to the fakes (device, physical device) are ignored
+namespace fake
+{
+    // Memory types in order of preference, as drivers report them
+    enum MemoryType : uint32_t
+    {
+        DeviceLocal = 0,
+        HostCoherent = 1,                   // Host visible and coherent
+        HostNonCoherent = 2,                // Host visible only
+        HostCached = 3                      // Host visible and cached, not coherent
+    };
+
+    struct Limits
+    {
+        vk::DeviceSize bufferImageGranularity = 1;
+        vk::DeviceSize nonCoherentAtomSize = 1;
+        vk::DeviceSize bufferAlignment = 16;        // Alignment reported for every buffer
+        uint32_t bufferMemoryTypeBits = ~0u;        // Memory types reported for every buffer
+    };
+
+    // Forget all memory, buffers and recorded calls
+    void reset(const Limits& limits = Limits());
+
+    // vk::DeviceMemory currently allocated
+    size_t getAllocationCount();
+    const std::vector<VkMappedMemoryRange>& getFlushedRanges();
+    const std::vector<VkMappedMemoryRange>& getInvalidatedRanges();
+}
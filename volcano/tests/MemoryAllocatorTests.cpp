@@ -0,0 +1,257 @@
+#include "test.h"
+#include "FakeVulkan.h"
+#include "MemoryAllocator.h"
+
+namespace
+{
+    constexpr vk::DeviceSize BLOCK_SIZE = 64 * 1024;
+
+    // Allocator over fake memory types, see FakeVulkan.h
+    struct TestAllocator
+    {
+        MemoryAllocator allocator;
+
+        explicit TestAllocator(const fake::Limits& limits = fake::Limits())
+        {
+            fake::reset(limits);
+            allocator.init(vk::PhysicalDevice(), vk::Device(), BLOCK_SIZE);
+        }
+        ~TestAllocator()
+        {
+            allocator.destroy();
+        }
+
+        MemoryAllocation allocate(vk::DeviceSize size, vk::DeviceSize alignment,
+            MemoryAllocator::ResourceKind kind = MemoryAllocator::ResourceKind::Linear,
+            vk::MemoryPropertyFlags properties = vk::MemoryPropertyFlagBits::eDeviceLocal)
+        {
+            vk::MemoryRequirements requirements;
+            requirements.size = size;
+            requirements.alignment = alignment;
+            requirements.memoryTypeBits = ~0u;
+            return allocator.allocate(requirements, properties, kind);
+        }
+    };
+}
+
+TEST(allocatorPacksAllocationsIntoOneBlock)
+{
+    TestAllocator test;
+
+    MemoryAllocation a = test.allocate(1000, 256);
+    MemoryAllocation b = test.allocate(1000, 256);
+    MemoryAllocation c = test.allocate(1000, 256);
+
+    CHECK(a.offset == 0 && b.offset == 1024 && c.offset == 2048);
+    CHECK(a.memory == b.memory && b.memory == c.memory);
+    CHECK(test.allocator.getBlockCount() == 1);
+    CHECK(fake::getAllocationCount() == 1);
+}
+
+TEST(allocatorTakesBestFittingRange)
+{
+    TestAllocator test;
+
+    MemoryAllocation a = test.allocate(1024, 1);
+    test.allocate(256, 1);
+    MemoryAllocation c = test.allocate(512, 1);
+    test.allocate(256, 1);
+    CHECK(c.offset == 1280);
+
+    // Free ranges are [0, 1024), [1280, 1792) and everything after 2048
+    test.allocator.free(a);
+    test.allocator.free(c);
+
+    MemoryAllocation e = test.allocate(400, 1);
+    CHECK(e.offset == 1280);
+    MemoryAllocation f = test.allocate(1000, 1);
+    CHECK(f.offset == 0);
+    MemoryAllocation g = test.allocate(112, 1);
+    CHECK(g.offset == 1680);
+    CHECK(test.allocator.getBlockCount() == 1);
+}
+
+TEST(allocatorReusesAlignmentPadding)
+{
+    TestAllocator test;
+
+    MemoryAllocation a = test.allocate(100, 1);
+    MemoryAllocation b = test.allocate(256, 256);
+    CHECK(a.offset == 0);
+    CHECK(b.offset == 256);
+
+    // [100, 256) was left free in front of b
+    MemoryAllocation c = test.allocate(156, 4);
+    CHECK(c.offset == 100);
+}
+
+TEST(allocatorMergesFreedNeighbours)
+{
+    TestAllocator test;
+
+    MemoryAllocation a = test.allocate(1024, 1);
+    MemoryAllocation b = test.allocate(1024, 1);
+    MemoryAllocation c = test.allocate(1024, 1);
+    MemoryAllocation d = test.allocate(1024, 1);
+    CHECK(d.offset == 3072);
+
+    test.allocator.free(b);
+    test.allocator.free(a);
+    test.allocator.free(c);
+
+    // Unmerged ranges would be too small and put it behind d
+    MemoryAllocation merged = test.allocate(3072, 1);
+    CHECK(merged.offset == 0);
+    CHECK(test.allocator.getBlockCount() == 1);
+}
+
+TEST(allocatorAddsAndDropsBlocks)
+{
+    TestAllocator test;
+
+    MemoryAllocation a = test.allocate(BLOCK_SIZE / 2, 1);
+    MemoryAllocation b = test.allocate(BLOCK_SIZE / 2, 1);
+    CHECK(test.allocator.getBlockCount() == 1);
+
+    MemoryAllocation c = test.allocate(BLOCK_SIZE / 2, 1);
+    CHECK(test.allocator.getBlockCount() == 2);
+    CHECK(c.memory != a.memory);
+
+    // Empty block is released while another block of its memory type remains
+    test.allocator.free(c);
+    CHECK(test.allocator.getBlockCount() == 1);
+    CHECK(fake::getAllocationCount() == 1);
+
+    // Last block stays for future allocations
+    test.allocator.free(a);
+    test.allocator.free(b);
+    CHECK(test.allocator.getBlockCount() == 1);
+    CHECK(!a.block && a.size == 0);
+}
+
+TEST(allocatorGivesLargeResourcesDedicatedBlocks)
+{
+    TestAllocator test;
+
+    MemoryAllocation large = test.allocate(BLOCK_SIZE / 2 + 1, 1);
+    CHECK(large.offset == 0);
+    CHECK(test.allocator.getBlockCount() == 1);
+
+    // Small allocation doesn't go into remaining space of dedicated block
+    MemoryAllocation small = test.allocate(16, 1);
+    CHECK(small.memory != large.memory);
+    CHECK(test.allocator.getBlockCount() == 2);
+
+    test.allocator.free(large);
+    CHECK(test.allocator.getBlockCount() == 1);
+    CHECK(fake::getAllocationCount() == 1);
+}
+
+TEST(allocatorSeparatesMemoryTypes)
+{
+    TestAllocator test;
+
+    MemoryAllocation local = test.allocate(16, 1);
+    MemoryAllocation host = test.allocate(16, 1, MemoryAllocator::ResourceKind::Linear,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+
+    CHECK(local.memory != host.memory);
+    CHECK(test.allocator.getBlockCount() == 2);
+
+    CHECK_THROWS(test.allocate(16, 1, MemoryAllocator::ResourceKind::Linear, vk::MemoryPropertyFlagBits::eLazilyAllocated));
+}
+
+TEST(allocatorSeparatesLinearAndOptimalResources)
+{
+    {
+        fake::Limits limits;
+        limits.bufferImageGranularity = 1024;
+        TestAllocator test(limits);
+
+        MemoryAllocation buffer = test.allocate(16, 1, MemoryAllocator::ResourceKind::Linear);
+        MemoryAllocation image = test.allocate(16, 1, MemoryAllocator::ResourceKind::Optimal);
+        CHECK(buffer.memory != image.memory);
+        CHECK(test.allocator.getBlockCount() == 2);
+    }
+
+    // Without granularity they can share a block
+    {
+        TestAllocator test;
+
+        MemoryAllocation buffer = test.allocate(16, 1, MemoryAllocator::ResourceKind::Linear);
+        MemoryAllocation image = test.allocate(16, 1, MemoryAllocator::ResourceKind::Optimal);
+        CHECK(buffer.memory == image.memory);
+        CHECK(image.offset == 16);
+    }
+}
+
+TEST(allocatorMapsBlockOnce)
+{
+    TestAllocator test;
+
+    vk::MemoryPropertyFlags hostVisible = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+    MemoryAllocation a = test.allocate(100, 1, MemoryAllocator::ResourceKind::Linear, hostVisible);
+    MemoryAllocation b = test.allocate(100, 1, MemoryAllocator::ResourceKind::Linear, hostVisible);
+
+    char* dataA = static_cast<char*>(test.allocator.map(a));
+    char* dataB = static_cast<char*>(test.allocator.map(b));
+    CHECK(dataB - dataA == static_cast<ptrdiff_t>(b.offset - a.offset));
+
+    test.allocator.unmap(a);
+    test.allocator.unmap(b);
+}
+
+TEST(allocatorSkipsFlushOfCoherentMemory)
+{
+    TestAllocator test;
+
+    MemoryAllocation allocation = test.allocate(100, 1, MemoryAllocator::ResourceKind::Linear,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+    CHECK(test.allocator.isCoherent(allocation));
+
+    test.allocator.flush(allocation);
+    test.allocator.invalidate(allocation);
+    CHECK(fake::getFlushedRanges().empty());
+    CHECK(fake::getInvalidatedRanges().empty());
+}
+
+TEST(allocatorWidensFlushToAtoms)
+{
+    fake::Limits limits;
+    limits.nonCoherentAtomSize = 64;
+    TestAllocator test(limits);
+
+    vk::MemoryPropertyFlags cached = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCached;
+    MemoryAllocation a = test.allocate(100, 1, MemoryAllocator::ResourceKind::Linear, cached);
+    MemoryAllocation b = test.allocate(200, 4, MemoryAllocator::ResourceKind::Linear, cached);
+    CHECK(!test.allocator.isCoherent(b));
+    CHECK(b.offset == 100);
+
+    // Bytes [110, 130) of block
+    test.allocator.flush(b, 10, 20);
+    CHECK(fake::getFlushedRanges().size() == 1);
+    CHECK(fake::getFlushedRanges()[0].memory == static_cast<VkDeviceMemory>(b.memory));
+    CHECK(fake::getFlushedRanges()[0].offset == 64);
+    CHECK(fake::getFlushedRanges()[0].size == 128);
+
+    test.allocator.invalidate(a);
+    CHECK(fake::getInvalidatedRanges().size() == 1);
+    CHECK(fake::getInvalidatedRanges()[0].offset == 0);
+    CHECK(fake::getInvalidatedRanges()[0].size == 128);
+}
+
+TEST(allocatorFlushesToEndOfBlockAsWholeSize)
+{
+    fake::Limits limits;
+    limits.nonCoherentAtomSize = 64;
+    TestAllocator test(limits);
+
+    // Dedicated block whose size is not a multiple of atom size
+    MemoryAllocation allocation = test.allocate(BLOCK_SIZE / 2 + 10, 1, MemoryAllocator::ResourceKind::Linear,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCached);
+
+    test.allocator.flush(allocation, 100);
+    CHECK(fake::getFlushedRanges().size() == 1);
+    CHECK(fake::getFlushedRanges()[0].offset == 64);
+    CHECK(fake::getFlushedRanges()[0].size == VK_WHOLE_SIZE);
+}
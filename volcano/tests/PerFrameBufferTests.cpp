@@ -0,0 +1,92 @@
+#include "test.h"
+#include "FakeVulkan.h"
+#include "PerFrameBuffer.h"
+
+#include <cstring>
+
+namespace
+{
+    constexpr vk::DeviceSize BLOCK_SIZE = 64 * 1024;
+
+    // Buffers can only go to non coherent memory with 64 byte atoms
+    fake::Limits getNonCoherentLimits()
+    {
+        fake::Limits limits;
+        limits.nonCoherentAtomSize = 64;
+        limits.bufferMemoryTypeBits = 1 << fake::HostNonCoherent;
+        return limits;
+    }
+}
+
+TEST(perFrameBufferRegionsDontShareAtoms)
+{
+    fake::reset(getNonCoherentLimits());
+    MemoryAllocator allocator;
+    allocator.init(vk::PhysicalDevice(), vk::Device(), BLOCK_SIZE);
+
+    // Buffer memory doesn't start at beginning of block
+    vk::MemoryRequirements requirements;
+    requirements.size = 10;
+    requirements.alignment = 1;
+    requirements.memoryTypeBits = 1 << fake::HostNonCoherent;
+    MemoryAllocation other = allocator.allocate(requirements, vk::MemoryPropertyFlagBits::eHostVisible, MemoryAllocator::ResourceKind::Linear);
+
+    // Alignment that is not a power of two, like size of an indirect command
+    PerFrameBuffer buffer;
+    buffer.init(allocator, vk::Device(), 100, 3, vk::BufferUsageFlagBits::eIndirectBuffer, 20);
+    CHECK(buffer.getOffset(1) == 320);
+    CHECK(buffer.getOffset(2) == 640);
+
+    uint32_t value = 0x12345678;
+    buffer.write(1, &value, sizeof(value), 4);
+    CHECK(memcmp(buffer.get<char>(1) + 4, &value, sizeof(value)) == 0);
+
+    buffer.flush(2);
+
+    // Memory of buffer starts at 64, regions at 384 and 704 of block
+    const std::vector<VkMappedMemoryRange>& ranges = fake::getFlushedRanges();
+    CHECK(ranges.size() == 2);
+    CHECK(ranges[0].offset == 384 && ranges[0].size == 64);
+    CHECK(ranges[1].offset == 704 && ranges[1].size == 128);
+
+    buffer.destroy();
+    allocator.free(other);
+    allocator.destroy();
+}
+
+TEST(perFrameBufferPrefersCoherentMemory)
+{
+    fake::reset();
+    MemoryAllocator allocator;
+    allocator.init(vk::PhysicalDevice(), vk::Device(), BLOCK_SIZE);
+
+    PerFrameBuffer buffer;
+    buffer.init(allocator, vk::Device(), 256, 2, vk::BufferUsageFlagBits::eUniformBuffer);
+    CHECK(buffer.getOffset(1) == 256);
+
+    buffer.flush(0);
+    buffer.invalidate(1);
+    CHECK(fake::getFlushedRanges().empty());
+    CHECK(fake::getInvalidatedRanges().empty());
+
+    buffer.destroy();
+    allocator.destroy();
+}
+
+TEST(perFrameBufferReadsBackFromCachedMemory)
+{
+    fake::reset();
+    MemoryAllocator allocator;
+    allocator.init(vk::PhysicalDevice(), vk::Device(), BLOCK_SIZE);
+
+    PerFrameBuffer buffer;
+    buffer.init(allocator, vk::Device(), 256, 2, vk::BufferUsageFlagBits::eTransferDst, 1, true);
+
+    // Cached memory of fake device is not coherent
+    buffer.invalidate(1);
+    CHECK(fake::getInvalidatedRanges().size() == 1);
+    CHECK(fake::getInvalidatedRanges()[0].offset == 256);
+
+    buffer.destroy();
+    allocator.destroy();
+}
@@ -0,0 +1,104 @@
+#include "test.h"
+#include "PipelineDescription.h"
+
+#include <cstdint>
+
+namespace
+{
+    PipelineDescription getDescription()
+    {
+        PipelineDescription description;
+        description.vertexShader = "shaders/vert.spv";
+        description.fragmentShader = "shaders/frag.spv";
+        description.renderPass = reinterpret_cast<VkRenderPass>(uintptr_t(1));
+        return description;
+    }
+
+    bool isSame(const PipelineDescription& a, const PipelineDescription& b)
+    {
+        return a == b && a.hash() == b.hash();
+    }
+}
+
+TEST(pipelineDescriptionConstantsAreSorted)
+{
+    PipelineDescription a = getDescription();
+    a.setFragmentConstant(FragmentConstant::AlphaCutoff, 0.5f);
+    a.setFragmentConstant(FragmentConstant::UseTexture, true);
+    a.setFragmentConstant(FragmentConstant::AlphaTest, true);
+
+    PipelineDescription b = getDescription();
+    b.setFragmentConstant(FragmentConstant::AlphaTest, true);
+    b.setFragmentConstant(FragmentConstant::UseTexture, true);
+    b.setFragmentConstant(FragmentConstant::AlphaCutoff, 0.5f);
+
+    CHECK(isSame(a, b));
+    CHECK(a.fragmentConstants.size() == 3);
+    CHECK(a.fragmentConstants[0].id == 0 && a.fragmentConstants[1].id == 1 && a.fragmentConstants[2].id == 2);
+}
+
+TEST(pipelineDescriptionConstantIsReplaced)
+{
+    PipelineDescription a = getDescription();
+    a.setFragmentConstant(FragmentConstant::UseTexture, false);
+    a.setFragmentConstant(FragmentConstant::UseTexture, true);
+
+    PipelineDescription b = getDescription();
+    b.setFragmentConstant(FragmentConstant::UseTexture, true);
+
+    CHECK(a.fragmentConstants.size() == 1);
+    CHECK(a.fragmentConstants[0].value == VK_TRUE);
+    CHECK(isSame(a, b));
+}
+
+TEST(pipelineDescriptionUnsetConstantDiffersFromZero)
+{
+    // Unset constant keeps default of shader, which need not be 0
+    PipelineDescription a = getDescription();
+    PipelineDescription b = getDescription();
+    b.setFragmentConstant(FragmentConstant::AlphaTest, false);
+
+    CHECK(a != b);
+    CHECK(a.hash() != b.hash());
+}
+
+TEST(pipelineDescriptionFloatConstantKeepsBits)
+{
+    PipelineDescription description = getDescription();
+    description.setFragmentConstant(FragmentConstant::AlphaCutoff, 0.5f);
+
+    CHECK(description.fragmentConstants[0].value == 0x3f000000);
+}
+
+TEST(pipelineDescriptionDiffersByEveryPart)
+{
+    PipelineDescription base = getDescription();
+    base.setFragmentConstant(FragmentConstant::UseTexture, true);
+    CHECK(!isSame(base, getDescription()));
+    CHECK(isSame(base, base));
+
+    PipelineDescription value = base;
+    value.setFragmentConstant(FragmentConstant::UseTexture, false);
+    CHECK(value != base && value.hash() != base.hash());
+
+    // Same constant given to other stage
+    PipelineDescription stage = getDescription();
+    stage.vertexConstants = base.fragmentConstants;
+    CHECK(stage != base && stage.hash() != base.hash());
+
+    PipelineDescription shader = base;
+    shader.fragmentShader = "shaders/other.spv";
+    CHECK(shader != base && shader.hash() != base.hash());
+
+    PipelineDescription state = base;
+    state.state.cullMode = vk::CullModeFlagBits::eNone;
+    CHECK(state != base && state.hash() != base.hash());
+
+    PipelineDescription pass = base;
+    pass.renderPass = reinterpret_cast<VkRenderPass>(uintptr_t(2));
+    CHECK(pass != base && pass.hash() != base.hash());
+
+    PipelineDescription subpass = base;
+    subpass.subpass = 1;
+    CHECK(subpass != base && subpass.hash() != base.hash());
+}
@@ -0,0 +1,201 @@
+#include "test.h"
+#include "PngWriter.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <stb_image/stb_image.h>
+
+namespace
+{
+    const char* TEST_FILE = "png-writer-test.png";
+
+    // Bitwise reference implementations, independent of tables in writer
+    uint32_t referenceCrc32(const uint8_t* data, size_t size)
+    {
+        uint32_t crc = 0xFFFFFFFFu;
+        for (size_t i = 0; i < size; ++i)
+        {
+            crc ^= data[i];
+            for (int k = 0; k < 8; ++k)
+                crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+        return ~crc;
+    }
+
+    uint32_t referenceAdler32(const std::vector<uint8_t>& data)
+    {
+        uint32_t a = 1, b = 0;
+        for (uint8_t byte : data)
+        {
+            a = (a + byte) % 65521;
+            b = (b + a) % 65521;
+        }
+        return (b << 16) | a;
+    }
+
+    uint32_t readBigEndian(const uint8_t* data)
+    {
+        return (uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) | (uint32_t(data[2]) << 8) | data[3];
+    }
+
+    struct Chunk
+    {
+        std::string type;
+        std::vector<uint8_t> data;
+        uint32_t crc;
+    };
+
+    // Splits file into chunks and checks crc of each
+    std::vector<Chunk> readChunks(const std::vector<uint8_t>& file)
+    {
+        static const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        CHECK(file.size() >= 8 && memcmp(file.data(), signature, 8) == 0);
+
+        std::vector<Chunk> chunks;
+        for (size_t offset = 8; offset + 12 <= file.size(); )
+        {
+            uint32_t length = readBigEndian(&file[offset]);
+            CHECK(offset + 12 + length <= file.size());
+            if (offset + 12 + length > file.size())
+                break;
+
+            Chunk chunk;
+            chunk.type.assign(reinterpret_cast<const char*>(&file[offset + 4]), 4);
+            chunk.data.assign(file.begin() + offset + 8, file.begin() + offset + 8 + length);
+            chunk.crc = readBigEndian(&file[offset + 8 + length]);
+            CHECK(chunk.crc == referenceCrc32(&file[offset + 4], length + 4));
+
+            chunks.push_back(chunk);
+            offset += 12 + length;
+        }
+        return chunks;
+    }
+
+    // Unpacks zlib stream of stored deflate blocks and checks its adler32
+    std::vector<uint8_t> readStoredZlib(const std::vector<uint8_t>& zlib, size_t& blockCount)
+    {
+        CHECK(zlib.size() >= 6);
+        CHECK((zlib[0] & 0x0F) == 8);                               // Deflate
+        CHECK((zlib[0] * 256 + zlib[1]) % 31 == 0);
+
+        std::vector<uint8_t> data;
+        blockCount = 0;
+        size_t offset = 2;
+        bool last = false;
+        while (!last && offset + 5 <= zlib.size())
+        {
+            last = zlib[offset] & 1;
+            CHECK((zlib[offset] >> 1) == 0);                        // Stored block
+
+            uint16_t length = static_cast<uint16_t>(zlib[offset + 1] | zlib[offset + 2] << 8);
+            uint16_t inverse = static_cast<uint16_t>(zlib[offset + 3] | zlib[offset + 4] << 8);
+            CHECK(length == static_cast<uint16_t>(~inverse));
+            offset += 5;
+
+            CHECK(offset + length <= zlib.size());
+            data.insert(data.end(), zlib.begin() + offset, zlib.begin() + std::min(offset + length, zlib.size()));
+            offset += length;
+            blockCount++;
+        }
+
+        CHECK(last);
+        CHECK(offset + 4 == zlib.size());
+        if (offset + 4 <= zlib.size())
+            CHECK(readBigEndian(&zlib[offset]) == referenceAdler32(data));
+        return data;
+    }
+
+    // Pattern that differs per pixel and channel. Bytes past row are padding
+    std::vector<uint8_t> getPixels(uint32_t width, uint32_t height, uint32_t rowPitch)
+    {
+        std::vector<uint8_t> pixels(static_cast<size_t>(rowPitch) * height, 0xCD);
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            for (uint32_t x = 0; x < width * 4; ++x)
+                pixels[static_cast<size_t>(y) * rowPitch + x] = static_cast<uint8_t>(x * 7 + y * 13);
+        }
+        return pixels;
+    }
+
+    // Writes image, checks structure of file and returns number of deflate blocks
+    size_t checkImage(uint32_t width, uint32_t height, uint32_t rowPitch)
+    {
+        std::vector<uint8_t> pixels = getPixels(width, height, rowPitch);
+        CHECK(png::write(TEST_FILE, width, height, pixels.data(), rowPitch));
+
+        std::vector<char> bytes = utils::readFile(TEST_FILE);
+        std::vector<uint8_t> file(bytes.begin(), bytes.end());
+
+        std::vector<Chunk> chunks = readChunks(file);
+        CHECK(chunks.size() == 3);
+        if (chunks.size() != 3)
+            return 0;
+
+        CHECK(chunks[0].type == "IHDR" && chunks[0].data.size() == 13);
+        CHECK(readBigEndian(&chunks[0].data[0]) == width);
+        CHECK(readBigEndian(&chunks[0].data[4]) == height);
+        CHECK(chunks[0].data[8] == 8 && chunks[0].data[9] == 6);
+
+        CHECK(chunks[1].type == "IDAT");
+        size_t blockCount;
+        std::vector<uint8_t> raw = readStoredZlib(chunks[1].data, blockCount);
+
+        // Rows without padding, each after filter type 0
+        size_t rowSize = static_cast<size_t>(width) * 4;
+        CHECK(raw.size() == (rowSize + 1) * height);
+        for (uint32_t y = 0; y < height && raw.size() == (rowSize + 1) * height; ++y)
+        {
+            CHECK(raw[y * (rowSize + 1)] == 0);
+            CHECK(memcmp(&raw[y * (rowSize + 1) + 1], &pixels[static_cast<size_t>(y) * rowPitch], rowSize) == 0);
+        }
+
+        // Crc of empty IEND is a known constant
+        CHECK(chunks[2].type == "IEND" && chunks[2].data.empty());
+        CHECK(chunks[2].crc == 0xAE426082u);
+
+        // Readable by a real decoder
+        int decodedWidth, decodedHeight, channels;
+        stbi_uc* decoded = stbi_load(TEST_FILE, &decodedWidth, &decodedHeight, &channels, STBI_rgb_alpha);
+        CHECK(decoded != nullptr);
+        if (decoded)
+        {
+            CHECK(decodedWidth == static_cast<int>(width) && decodedHeight == static_cast<int>(height));
+            for (uint32_t y = 0; y < height; ++y)
+                CHECK(memcmp(decoded + y * rowSize, &pixels[static_cast<size_t>(y) * rowPitch], rowSize) == 0);
+            stbi_image_free(decoded);
+        }
+
+        std::remove(TEST_FILE);
+        return blockCount;
+    }
+}
+
+TEST(pngWriterReferenceChecksums)
+{
+    // Check values of both algorithms, so reference implementations can be trusted
+    const char* digits = "123456789";
+    CHECK(referenceCrc32(reinterpret_cast<const uint8_t*>(digits), 9) == 0xCBF43926u);
+
+    const char* word = "Wikipedia";
+    CHECK(referenceAdler32(std::vector<uint8_t>(word, word + 9)) == 0x11E60398u);
+}
+
+TEST(pngWriterSkipsRowPadding)
+{
+    CHECK(checkImage(3, 2, 16) == 1);
+}
+
+TEST(pngWriterSplitsLargeImagesIntoBlocks)
+{
+    // 100 rows of 801 bytes need two stored blocks
+    CHECK(checkImage(200, 100, 800) == 2);
+}
+
+TEST(pngWriterReportsUnwritableFile)
+{
+    uint8_t pixel[4] = {};
+    CHECK(!png::write("missing-directory/frame.png", 1, 1, pixel, 4));
+}
@@ -0,0 +1,91 @@
+#include "test.h"
+#include "utils.h"
+
+// utils::allocateRange / freeRange, used for geometry arena and instance slots
+
+TEST(allocateRangeTakesLowestFit)
+{
+    std::map<uint32_t, uint32_t> freeRanges = { { 0, 4 }, { 10, 20 }, { 40, 100 } };
+
+    uint32_t offset;
+    CHECK(utils::allocateRange(freeRanges, 8, offset));
+    CHECK(offset == 10);
+    CHECK((freeRanges == std::map<uint32_t, uint32_t>{ { 0, 4 }, { 18, 12 }, { 40, 100 } }));
+
+    // Exact fit removes range
+    CHECK(utils::allocateRange(freeRanges, 4, offset));
+    CHECK(offset == 0);
+    CHECK((freeRanges == std::map<uint32_t, uint32_t>{ { 18, 12 }, { 40, 100 } }));
+}
+
+TEST(allocateRangeFailsWhenNothingFits)
+{
+    std::map<uint32_t, uint32_t> freeRanges = { { 0, 4 }, { 10, 4 } };
+
+    uint32_t offset = 123;
+    CHECK(!utils::allocateRange(freeRanges, 5, offset));
+    CHECK(offset == 123);
+    CHECK(freeRanges.size() == 2);
+}
+
+TEST(allocateRangeOfZeroNeedsNoSpace)
+{
+    std::map<uint32_t, uint32_t> freeRanges;
+
+    uint32_t offset = 123;
+    CHECK(utils::allocateRange(freeRanges, 0, offset));
+    CHECK(offset == 0);
+}
+
+TEST(freeRangeMergesWithNeighbours)
+{
+    std::map<uint32_t, uint32_t> freeRanges = { { 100, 100 } };
+
+    uint32_t a, b, c;
+    CHECK(utils::allocateRange(freeRanges, 10, a));
+    CHECK(utils::allocateRange(freeRanges, 10, b));
+    CHECK(utils::allocateRange(freeRanges, 10, c));
+    CHECK(a == 100 && b == 110 && c == 120);
+
+    // Merge with following range only
+    utils::freeRange(freeRanges, c, 10);
+    CHECK((freeRanges == std::map<uint32_t, uint32_t>{ { 120, 80 } }));
+
+    // No neighbour
+    utils::freeRange(freeRanges, a, 10);
+    CHECK((freeRanges == std::map<uint32_t, uint32_t>{ { 100, 10 }, { 120, 80 } }));
+
+    // Merge with both
+    utils::freeRange(freeRanges, b, 10);
+    CHECK((freeRanges == std::map<uint32_t, uint32_t>{ { 100, 100 } }));
+}
+
+TEST(freeRangeMergesWithPrecedingRange)
+{
+    std::map<uint32_t, uint32_t> freeRanges = { { 0, 10 } };
+
+    utils::freeRange(freeRanges, 10, 5);
+    CHECK((freeRanges == std::map<uint32_t, uint32_t>{ { 0, 15 } }));
+
+    // Empty range changes nothing
+    utils::freeRange(freeRanges, 30, 0);
+    CHECK(freeRanges.size() == 1);
+}
+
+TEST(freedRangesAreReused)
+{
+    std::map<uint32_t, uint32_t> freeRanges = { { 0, 64 } };
+
+    uint32_t offsets[8];
+    for (uint32_t& offset : offsets)
+        CHECK(utils::allocateRange(freeRanges, 8, offset));
+    CHECK(freeRanges.empty());
+
+    utils::freeRange(freeRanges, offsets[2], 8);
+    utils::freeRange(freeRanges, offsets[3], 8);
+
+    uint32_t offset;
+    CHECK(utils::allocateRange(freeRanges, 16, offset));
+    CHECK(offset == 16);
+    CHECK(freeRanges.empty());
+}
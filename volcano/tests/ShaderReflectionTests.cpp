@@ -0,0 +1,322 @@
+#include "test.h"
+#include "ShaderReflection.h"
+
+#include <cstring>
+#include <initializer_list>
+
+namespace
+{
+    enum : uint32_t
+    {
+        ExecutionModelVertex = 0,
+        ExecutionModelFragment = 4,
+
+        StorageUniformConstant = 0,
+        StorageInput = 1,
+        StorageUniform = 2,
+        StoragePushConstant = 9,
+        StorageStorageBuffer = 12,
+
+        DecorationBlock = 2,
+        DecorationBufferBlock = 3,
+        DecorationBuiltIn = 11,
+        DecorationLocation = 30,
+        DecorationBinding = 33,
+        DecorationDescriptorSet = 34,
+        DecorationOffset = 35,
+
+        BuiltInVertexIndex = 42
+    };
+
+    // Hand assembled SPIR-V with one entry point. Only holds what reflection looks at
+    // Types and variables go to module scope, use() references a variable from function body
+    class SpirvBuilder
+    {
+    public:
+        explicit SpirvBuilder(uint32_t executionModel) : executionModel(executionModel)
+        {
+            voidType = add(19);
+            functionType = id();
+            instruction(declarations, 33, { functionType, voidType });
+        }
+
+        uint32_t floatType() { return add(22, { 32 }); }
+        uint32_t intType(bool isSigned) { return add(21, { 32, isSigned ? 1u : 0u }); }
+        uint32_t vectorType(uint32_t component, uint32_t count) { return add(23, { component, count }); }
+        uint32_t structType(std::initializer_list<uint32_t> members) { return add(30, members); }
+        uint32_t arrayType(uint32_t element, uint32_t length)
+        {
+            uint32_t lengthId = id();
+            instruction(declarations, 43, { intType(false), lengthId, length });
+            return add(28, { element, lengthId });
+        }
+        uint32_t imageType(uint32_t dim, uint32_t sampled) { return add(25, { floatType(), dim, 0, 0, 0, sampled, 0 }); }
+        uint32_t sampledImageType() { return add(27, { imageType(1, 1) }); }
+
+        uint32_t variable(uint32_t storageClass, uint32_t type)
+        {
+            uint32_t pointer = add(32, { storageClass, type });
+            uint32_t result = id();
+            instruction(declarations, 59, { pointer, result, storageClass });
+            return result;
+        }
+
+        void decorate(uint32_t target, uint32_t decoration, std::initializer_list<uint32_t> literals = {})
+        {
+            std::vector<uint32_t> operands = { target, decoration };
+            operands.insert(operands.end(), literals);
+            instruction(annotations, 71, operands);
+        }
+        void decorateMember(uint32_t structId, uint32_t member, uint32_t decoration, uint32_t literal)
+        {
+            instruction(annotations, 72, { structId, member, decoration, literal });
+        }
+        void bind(uint32_t variableId, uint32_t set, uint32_t binding)
+        {
+            decorate(variableId, DecorationDescriptorSet, { set });
+            decorate(variableId, DecorationBinding, { binding });
+        }
+
+        // OpLoad of variable inside entry point
+        void use(uint32_t variableId) { instruction(body, 61, { voidType, id(), variableId }); }
+
+        std::vector<char> build()
+        {
+            uint32_t function = id();
+
+            std::vector<uint32_t> words = { 0x07230203, 0x00010000, 0, 0, 0 };
+            instruction(words, 17, { 1 });                                                  // OpCapability Shader
+            instruction(words, 14, { 0, 1 });                                               // OpMemoryModel Logical GLSL450
+            instruction(words, 15, { executionModel, function, 0x6e69616d, 0 });            // OpEntryPoint "main"
+            words.insert(words.end(), annotations.begin(), annotations.end());
+            words.insert(words.end(), declarations.begin(), declarations.end());
+            instruction(words, 54, { voidType, function, 0, functionType });                // OpFunction
+            instruction(words, 248, { id() });                                              // OpLabel
+            words.insert(words.end(), body.begin(), body.end());
+            instruction(words, 253, {});                                                    // OpReturn
+            instruction(words, 56, {});                                                     // OpFunctionEnd
+            words[3] = nextId;
+
+            std::vector<char> code(words.size() * 4);
+            memcpy(code.data(), words.data(), code.size());
+            return code;
+        }
+    private:
+        uint32_t executionModel;
+        uint32_t nextId = 1;
+        uint32_t voidType, functionType;
+        std::vector<uint32_t> annotations, declarations, body;
+    private:
+        uint32_t id() { return nextId++; }
+
+        // Type instruction whose result id is first operand
+        uint32_t add(uint32_t op, std::initializer_list<uint32_t> operands = {})
+        {
+            uint32_t result = id();
+            std::vector<uint32_t> all = { result };
+            all.insert(all.end(), operands);
+            instruction(declarations, op, all);
+            return result;
+        }
+
+        static void instruction(std::vector<uint32_t>& words, uint32_t op, const std::vector<uint32_t>& operands)
+        {
+            words.push_back(static_cast<uint32_t>(operands.size() + 1) << 16 | op);
+            words.insert(words.end(), operands.begin(), operands.end());
+        }
+    };
+
+    // Uniform block with one vec4, used by entry point
+    uint32_t addUniformBlock(SpirvBuilder& spirv, uint32_t set, uint32_t binding)
+    {
+        uint32_t block = spirv.structType({ spirv.vectorType(spirv.floatType(), 4) });
+        spirv.decorate(block, DecorationBlock);
+        spirv.decorateMember(block, 0, DecorationOffset, 0);
+        uint32_t variable = spirv.variable(StorageUniform, block);
+        spirv.bind(variable, set, binding);
+        spirv.use(variable);
+        return variable;
+    }
+
+    uint32_t addSampler(SpirvBuilder& spirv, uint32_t set, uint32_t binding)
+    {
+        uint32_t variable = spirv.variable(StorageUniformConstant, spirv.sampledImageType());
+        spirv.bind(variable, set, binding);
+        spirv.use(variable);
+        return variable;
+    }
+}
+
+TEST(reflectionRejectsInvalidCode)
+{
+    CHECK_THROWS(ShaderReflection::fromSpirv({}));
+    CHECK_THROWS(ShaderReflection::fromSpirv(std::vector<char>(22)));
+
+    std::vector<char> code = SpirvBuilder(ExecutionModelVertex).build();
+    CHECK(ShaderReflection::fromSpirv(code).getStages() == vk::ShaderStageFlagBits::eVertex);
+
+    std::vector<char> badMagic = code;
+    badMagic[0] = 0;
+    CHECK_THROWS(ShaderReflection::fromSpirv(badMagic));
+
+    // Word count of last instruction (OpFunctionEnd) claims more words than are left
+    std::vector<char> truncated = code;
+    truncated[code.size() - 2] = 2;
+    CHECK_THROWS(ShaderReflection::fromSpirv(truncated));
+
+    // Only header
+    std::vector<char> noEntryPoint(code.begin(), code.begin() + 20);
+    CHECK_THROWS(ShaderReflection::fromSpirv(noEntryPoint));
+}
+
+TEST(reflectionPacksVertexInputsInLocationOrder)
+{
+    SpirvBuilder spirv(ExecutionModelVertex);
+    uint32_t floatType = spirv.floatType();
+
+    // Declared out of location order
+    uint32_t uv = spirv.variable(StorageInput, spirv.vectorType(floatType, 2));
+    spirv.decorate(uv, DecorationLocation, { 2 });
+    uint32_t position = spirv.variable(StorageInput, spirv.vectorType(floatType, 3));
+    spirv.decorate(position, DecorationLocation, { 0 });
+    uint32_t colour = spirv.variable(StorageInput, spirv.vectorType(floatType, 4));
+    spirv.decorate(colour, DecorationLocation, { 1 });
+    uint32_t material = spirv.variable(StorageInput, spirv.intType(false));
+    spirv.decorate(material, DecorationLocation, { 3 });
+
+    // Builtins don't come from vertex buffer
+    uint32_t vertexIndex = spirv.variable(StorageInput, spirv.intType(true));
+    spirv.decorate(vertexIndex, DecorationBuiltIn, { BuiltInVertexIndex });
+    spirv.use(vertexIndex);
+
+    ShaderReflection reflection = ShaderReflection::fromSpirv(spirv.build());
+
+    const std::vector<vk::VertexInputAttributeDescription>& attributes = reflection.getVertexAttributes();
+    CHECK(attributes.size() == 4);
+    CHECK(attributes[0] == vk::VertexInputAttributeDescription(0, 0, vk::Format::eR32G32B32Sfloat, 0));
+    CHECK(attributes[1] == vk::VertexInputAttributeDescription(1, 0, vk::Format::eR32G32B32A32Sfloat, 12));
+    CHECK(attributes[2] == vk::VertexInputAttributeDescription(2, 0, vk::Format::eR32G32Sfloat, 28));
+    CHECK(attributes[3] == vk::VertexInputAttributeDescription(3, 0, vk::Format::eR32Uint, 36));
+    CHECK(reflection.getVertexStride() == 40);
+}
+
+TEST(reflectionIgnoresFragmentInputs)
+{
+    SpirvBuilder spirv(ExecutionModelFragment);
+    uint32_t colour = spirv.variable(StorageInput, spirv.vectorType(spirv.floatType(), 4));
+    spirv.decorate(colour, DecorationLocation, { 0 });
+    spirv.use(colour);
+
+    ShaderReflection reflection = ShaderReflection::fromSpirv(spirv.build());
+    CHECK(reflection.getStages() == vk::ShaderStageFlagBits::eFragment);
+    CHECK(reflection.getVertexAttributes().empty());
+    CHECK(reflection.getVertexStride() == 0);
+}
+
+TEST(reflectionFindsUsedBindings)
+{
+    SpirvBuilder spirv(ExecutionModelFragment);
+
+    addUniformBlock(spirv, 0, 0);
+
+    // Declared but never used
+    uint32_t unused = spirv.variable(StorageUniformConstant, spirv.sampledImageType());
+    spirv.bind(unused, 0, 1);
+
+    addSampler(spirv, 1, 0);
+
+    uint32_t storageBlock = spirv.structType({ spirv.floatType() });
+    spirv.decorate(storageBlock, DecorationBlock);
+    uint32_t storage = spirv.variable(StorageStorageBuffer, storageBlock);
+    spirv.bind(storage, 0, 3);
+    spirv.use(storage);
+
+    // Storage buffer before SPIR-V 1.3
+    uint32_t bufferBlock = spirv.structType({ spirv.floatType() });
+    spirv.decorate(bufferBlock, DecorationBufferBlock);
+    uint32_t legacyStorage = spirv.variable(StorageUniform, bufferBlock);
+    spirv.bind(legacyStorage, 0, 2);
+    spirv.use(legacyStorage);
+
+    uint32_t textures = spirv.variable(StorageUniformConstant, spirv.arrayType(spirv.sampledImageType(), 4));
+    spirv.bind(textures, 1, 1);
+    spirv.use(textures);
+
+    uint32_t storageImage = spirv.variable(StorageUniformConstant, spirv.imageType(1, 2));
+    spirv.bind(storageImage, 2, 0);
+    spirv.use(storageImage);
+
+    ShaderReflection reflection = ShaderReflection::fromSpirv(spirv.build());
+    CHECK(!reflection.hasBinding(0, 1));
+
+    // Sorted by binding number
+    std::vector<vk::DescriptorSetLayoutBinding> set0 = reflection.getSetBindings(0);
+    CHECK(set0.size() == 3);
+    CHECK(set0[0].binding == 0 && set0[0].descriptorType == vk::DescriptorType::eUniformBuffer);
+    CHECK(set0[1].binding == 2 && set0[1].descriptorType == vk::DescriptorType::eStorageBuffer);
+    CHECK(set0[2].binding == 3 && set0[2].descriptorType == vk::DescriptorType::eStorageBuffer);
+    CHECK(set0[0].stageFlags == vk::ShaderStageFlagBits::eFragment);
+    CHECK(set0[0].descriptorCount == 1);
+
+    std::vector<vk::DescriptorSetLayoutBinding> set1 = reflection.getSetBindings(1);
+    CHECK(set1.size() == 2);
+    CHECK(set1[0].descriptorType == vk::DescriptorType::eCombinedImageSampler && set1[0].descriptorCount == 1);
+    CHECK(set1[1].descriptorType == vk::DescriptorType::eCombinedImageSampler && set1[1].descriptorCount == 4);
+
+    std::vector<vk::DescriptorSetLayoutBinding> set2 = reflection.getSetBindings(2);
+    CHECK(set2.size() == 1 && set2[0].descriptorType == vk::DescriptorType::eStorageImage);
+}
+
+TEST(reflectionPushConstantRangeStartsAtFirstMember)
+{
+    SpirvBuilder spirv(ExecutionModelVertex);
+    uint32_t floatType = spirv.floatType();
+
+    uint32_t block = spirv.structType({ floatType, spirv.vectorType(floatType, 4) });
+    spirv.decorate(block, DecorationBlock);
+    spirv.decorateMember(block, 0, DecorationOffset, 16);
+    spirv.decorateMember(block, 1, DecorationOffset, 32);
+    uint32_t constants = spirv.variable(StoragePushConstant, block);
+    spirv.use(constants);
+
+    ShaderReflection reflection = ShaderReflection::fromSpirv(spirv.build());
+
+    const std::vector<vk::PushConstantRange>& ranges = reflection.getPushConstantRanges();
+    CHECK(ranges.size() == 1);
+    CHECK(ranges[0] == vk::PushConstantRange(vk::ShaderStageFlagBits::eVertex, 16, 32));
+}
+
+TEST(reflectionMergesStages)
+{
+    SpirvBuilder vertex(ExecutionModelVertex);
+    addUniformBlock(vertex, 0, 0);
+    uint32_t position = vertex.variable(StorageInput, vertex.vectorType(vertex.floatType(), 3));
+    vertex.decorate(position, DecorationLocation, { 0 });
+
+    SpirvBuilder fragment(ExecutionModelFragment);
+    addUniformBlock(fragment, 0, 0);
+    addSampler(fragment, 0, 1);
+
+    ShaderReflection reflection = ShaderReflection::fromSpirv(vertex.build());
+    reflection.merge(ShaderReflection::fromSpirv(fragment.build()));
+
+    CHECK(reflection.getStages() == (vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment));
+    CHECK(reflection.getVertexStride() == 12);
+
+    std::vector<vk::DescriptorSetLayoutBinding> bindings = reflection.getSetBindings(0);
+    CHECK(bindings.size() == 2);
+    CHECK(bindings[0].stageFlags == (vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment));
+    CHECK(bindings[1].stageFlags == vk::ShaderStageFlagBits::eFragment);
+}
+
+TEST(reflectionMergeRejectsConflictingBindings)
+{
+    SpirvBuilder vertex(ExecutionModelVertex);
+    addUniformBlock(vertex, 0, 0);
+
+    SpirvBuilder fragment(ExecutionModelFragment);
+    addSampler(fragment, 0, 0);
+
+    ShaderReflection reflection = ShaderReflection::fromSpirv(vertex.build());
+    CHECK_THROWS(reflection.merge(ShaderReflection::fromSpirv(fragment.build())));
+}
@@ -0,0 +1,122 @@
+#include "test.h"
+#include "StagingRing.h"
+
+// Ring is only given a mapped pointer, so host memory stands in for the staging buffer
+namespace
+{
+    struct TestRing
+    {
+        std::vector<char> memory;
+        StagingRing ring;
+
+        explicit TestRing(vk::DeviceSize size) : memory(static_cast<size_t>(size))
+        {
+            ring.init(vk::Buffer(), memory.data(), size);
+        }
+
+        // Offset of new allocation, or -1 if ring has no space
+        int64_t allocate(vk::DeviceSize size, vk::DeviceSize alignment = 1)
+        {
+            StagingAllocation allocation;
+            if (!ring.allocate(size, alignment, allocation))
+                return -1;
+
+            CHECK(allocation.data == memory.data() + allocation.offset);
+            return static_cast<int64_t>(allocation.offset);
+        }
+    };
+}
+
+TEST(stagingRingAlignsAllocations)
+{
+    TestRing ring(256);
+
+    CHECK(ring.allocate(10) == 0);
+    CHECK(ring.allocate(4, 16) == 16);
+    CHECK(ring.allocate(1, 4) == 20);
+    CHECK(ring.allocate(300) == -1);
+}
+
+TEST(stagingRingIsFullUntilReleased)
+{
+    TestRing ring(256);
+
+    CHECK(ring.allocate(256) == 0);
+    CHECK(ring.allocate(1) == -1);
+    ring.ring.retire(1);
+
+    // Not completed yet
+    ring.ring.release(0);
+    CHECK(ring.allocate(1) == -1);
+
+    ring.ring.release(1);
+    CHECK(ring.allocate(256) == 0);
+}
+
+TEST(stagingRingWrapsAndWastesTail)
+{
+    TestRing ring(256);
+
+    CHECK(ring.allocate(100) == 0);
+    ring.ring.retire(1);
+    CHECK(ring.allocate(100) == 100);
+    ring.ring.retire(2);
+
+    // 56 bytes are left at end and [0, 100) is still in use
+    CHECK(ring.allocate(100) == -1);
+
+    ring.ring.release(1);
+    CHECK(ring.allocate(100) == 0);
+
+    // Head caught up with tail
+    CHECK(ring.allocate(1) == -1);
+    ring.ring.retire(3);
+
+    // [100, 200) is free again. End of buffer stays wasted until region 3 is released
+    ring.ring.release(2);
+    CHECK(ring.allocate(60) == 100);
+    CHECK(ring.allocate(60) == -1);
+    CHECK(ring.allocate(40) == 160);
+    ring.ring.retire(4);
+
+    ring.ring.release(3);
+    CHECK(ring.allocate(56) == 200);
+}
+
+TEST(stagingRingStartsOverWhenEmpty)
+{
+    TestRing ring(256);
+
+    CHECK(ring.allocate(200) == 0);
+    ring.ring.retire(1);
+    ring.ring.release(1);
+
+    // Would not fit behind old head
+    CHECK(ring.allocate(200) == 0);
+}
+
+TEST(stagingRingRetireWithoutAllocationsIsNoop)
+{
+    TestRing ring(256);
+
+    CHECK(ring.allocate(128) == 0);
+    ring.ring.retire(1);
+    ring.ring.retire(2);
+    ring.ring.retire(3);
+
+    CHECK(ring.allocate(129) == -1);
+    ring.ring.release(1);
+    CHECK(ring.allocate(256) == 0);
+}
+
+TEST(stagingRingResetReclaimsEverything)
+{
+    TestRing ring(256);
+
+    CHECK(ring.allocate(100) == 0);
+    ring.ring.retire(1);
+    CHECK(ring.allocate(100) == 100);
+
+    ring.ring.reset();
+    CHECK(ring.allocate(256) == 0);
+}
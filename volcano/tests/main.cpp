@@ -0,0 +1,54 @@
+#include "test.h"
+
+#include <cstring>
+#include <iostream>
+
+namespace test
+{
+    static int failures = 0;
+
+    std::vector<Case>& getCases()
+    {
+        static std::vector<Case> cases;
+        return cases;
+    }
+
+    void fail(const char* file, int line, const std::string& message)
+    {
+        std::cerr << file << ":" << line << ": " << message << std::endl;
+        failures++;
+    }
+}
+
+// Optional argument runs only tests whose name contains it
+int main(int argc, char** argv)
+{
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+
+    int run = 0;
+    int failed = 0;
+    for (const test::Case& testCase : test::getCases())
+    {
+        if (filter && !strstr(testCase.name, filter))
+            continue;
+
+        int failuresBefore = test::failures;
+        try
+        {
+            testCase.run();
+        }
+        catch (const std::exception& e)
+        {
+            test::fail(testCase.name, 0, std::string("unexpected exception: ") + e.what());
+        }
+
+        bool passed = test::failures == failuresBefore;
+        std::cout << (passed ? "[ OK ] " : "[FAIL] ") << testCase.name << std::endl;
+        run++;
+        if (!passed)
+            failed++;
+    }
+
+    std::cout << run - failed << " of " << run << " tests passed" << std::endl;
+    return failed == 0 ? 0 : 1;
+}
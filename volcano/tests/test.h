@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Minimal test registry. Tests run in order of registration, failed checks are printed and counted
+namespace test
+{
+    struct Case
+    {
+        const char* name;
+        void (*run)();
+    };
+
+    std::vector<Case>& getCases();
+    void fail(const char* file, int line, const std::string& message);
+
+    struct Registrar
+    {
+        Registrar(const char* name, void (*run)()) { getCases().push_back({ name, run }); }
+    };
+}
+
+#define TEST(name) \
+    static void name(); \
+    static test::Registrar name##Registrar(#name, name); \
+    static void name()
+
+#define CHECK(condition) \
+    do { if (!(condition)) test::fail(__FILE__, __LINE__, #condition); } while (0)
+
+#define CHECK_THROWS(expression) \
+    do { \
+        bool thrown = false; \
+        try { expression; } catch (const std::exception&) { thrown = true; } \
+        if (!thrown) test::fail(__FILE__, __LINE__, #expression " did not throw"); \
+    } while (0)